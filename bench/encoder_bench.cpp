@@ -0,0 +1,302 @@
+#include <benchmark/benchmark.h>
+#include "bloomfilter.h"
+#include "partitionedBloomFilter.h"
+#include "predeterminedBloomFilter.h"
+#include "mphPositionIndex.h"
+#include "staticBloomFilter.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Benchmarks take (k-mer count, 1 / false positive rate, positionBits) as
+// arguments. Positions are the k-mer index truncated to positionBits.
+
+namespace {
+constexpr std::size_t KMER_LENGTH = 31;
+constexpr int SEED = 42;
+
+// Distinct synthetic k-mers plus a shuffled query order, generated from a
+// fixed seed so every run (and every machine) measures the same input.
+struct Dataset {
+    std::vector<std::string> kmers;
+    std::vector<std::size_t> queryOrder;
+};
+
+const Dataset& dataset(std::size_t count) {
+    static std::map<std::size_t, Dataset> cache;
+    auto it = cache.find(count);
+    if (it != cache.end()) return it->second;
+
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(count);
+    Dataset data;
+    std::unordered_set<std::string> seen;
+    std::string kmer(KMER_LENGTH, 'A');
+    while (data.kmers.size() < count) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+        if (seen.insert(kmer).second) data.kmers.push_back(kmer);
+    }
+    data.queryOrder.resize(count);
+    for (std::size_t i = 0; i < count; i++) data.queryOrder[i] = i;
+    std::shuffle(data.queryOrder.begin(), data.queryOrder.end(), rng);
+    return cache.emplace(count, std::move(data)).first->second;
+}
+
+uint64_t positionOf(std::size_t index, int positionBits) {
+    return index & ((1ULL << positionBits) - 1);
+}
+
+// ------------------ Encoders ------------------ //
+// Each encoder exposes build / contains / position / memoryBits so one set of
+// benchmark templates covers all of them. Batched encoders build with addBatch.
+template <typename Filter, RangeReduction Reduction = RangeReduction::Modulo, bool Batched = false>
+class BloomEncoder {
+public:
+    void build(const std::vector<std::string>& kmers, double fpr, int positionBits) {
+        filter = make(kmers.size(), fpr, positionBits);
+        if constexpr (Batched) {
+            std::vector<uint64_t> positions(kmers.size());
+            for (std::size_t i = 0; i < kmers.size(); i++) positions[i] = positionOf(i, positionBits);
+            std::vector<uint8_t> accepted(kmers.size());
+            filter->addBatch(kmers, positions, accepted, SEED);
+            return;
+        }
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            filter->add(kmers[i], positionOf(i, positionBits), SEED);
+        }
+    }
+    bool contains(const std::string& kmer) const { return filter->mightContain(kmer, SEED); }
+    uint64_t position(const std::string& kmer) const { return filter->getPosition(kmer, SEED); }
+    std::size_t memoryBits() const { return filter->getMemoryBits(); }
+
+private:
+    std::unique_ptr<Filter> filter;
+
+    static std::unique_ptr<Filter> make(std::size_t count, double fpr, int positionBits) {
+        BloomFilterOptions options;
+        options.rangeReduction = Reduction;
+        if constexpr (std::is_same_v<Filter, PredeterminedHashBloomFilter>) {
+            int numHash = static_cast<int>(std::ceil(std::log2(1.0 / fpr)));
+            return std::make_unique<Filter>(count, fpr, numHash, positionBits, options);
+        }
+        else if constexpr (std::is_same_v<Filter, PartitionedBloomFilter>) {
+            return std::make_unique<Filter>(count, fpr, positionBits, 0, options);
+        }
+        else {
+            return std::make_unique<Filter>(count, fpr, positionBits, options);
+        }
+    }
+};
+
+// StaticBloomFilter picked at runtime by makeStaticFilter; 7 hashes for
+// 1 / 100 and 10 for 1 / 1000, the optimal counts of the dynamic filters.
+template <FilterKind Kind>
+class StaticEncoder {
+public:
+    void build(const std::vector<std::string>& kmers, double fpr, int positionBits) {
+        int numHash = fpr >= 0.005 ? 7 : 10;
+        filter.emplace(makeStaticFilter(Kind, numHash, positionBits, kmers.size(), fpr));
+        std::visit([&](auto& f) {
+            for (std::size_t i = 0; i < kmers.size(); i++) {
+                f.add(kmers[i], positionOf(i, positionBits), SEED);
+            }
+            }, *filter);
+    }
+    bool contains(const std::string& kmer) const {
+        return std::visit([&](const auto& f) { return f.mightContain(kmer, SEED); }, *filter);
+    }
+    uint64_t position(const std::string& kmer) const {
+        return std::visit([&](const auto& f) { return f.getPosition(kmer, SEED); }, *filter);
+    }
+    std::size_t memoryBits() const {
+        return std::visit([](const auto& f) { return f.getMemoryBits(); }, *filter);
+    }
+
+private:
+    std::optional<AnyStaticFilter> filter;
+};
+
+// The unordered_map baseline from hashMapTest.cpp.
+class HashMapEncoder {
+public:
+    void build(const std::vector<std::string>& kmers, double, int positionBits) {
+        map.clear();
+        map.reserve(kmers.size());
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            map.emplace(kmers[i], positionOf(i, positionBits));
+        }
+    }
+    bool contains(const std::string& kmer) const { return map.find(kmer) != map.end(); }
+    uint64_t position(const std::string& kmer) const {
+        auto it = map.find(kmer);
+        return it == map.end() ? BloomFilter::NOT_FOUND : it->second;
+    }
+    // Estimate: bucket array, one node per entry (value, next pointer, cached
+    // hash) and the heap buffer of every key longer than the SSO capacity.
+    std::size_t memoryBits() const {
+        std::size_t bytes = map.bucket_count() * sizeof(void*);
+        for (const auto& [kmer, position] : map) {
+            bytes += sizeof(std::pair<const std::string, uint64_t>) + sizeof(void*) + sizeof(std::size_t);
+            if (kmer.capacity() > std::string().capacity()) bytes += kmer.capacity() + 1;
+        }
+        return bytes * 8;
+    }
+
+private:
+    std::unordered_map<std::string, uint64_t> map;
+};
+
+// pthash index; fingerprints sized to match the filters' false positive rate.
+class MphEncoder {
+public:
+    void build(const std::vector<std::string>& kmers, double fpr, int positionBits) {
+        MphConfig config;
+        config.positionBits = positionBits;
+        config.fingerprintBits = static_cast<int>(std::ceil(std::log2(1.0 / fpr)));
+        config.seed = SEED;
+        index = std::make_unique<MphPositionIndex>(config);
+
+        std::vector<uint64_t> positions(kmers.size());
+        for (std::size_t i = 0; i < kmers.size(); i++) positions[i] = positionOf(i, positionBits);
+        index->build(kmers, positions);
+    }
+    bool contains(const std::string& kmer) const { return index->mightContain(kmer); }
+    uint64_t position(const std::string& kmer) const { return index->lookup(kmer); }
+    std::size_t memoryBits() const { return index->getMemoryBits(); }
+
+private:
+    std::unique_ptr<MphPositionIndex> index;
+};
+
+using StandardEncoder = BloomEncoder<BloomFilter>;
+using PartitionedEncoder = BloomEncoder<PartitionedBloomFilter>;
+using PredeterminedEncoder = BloomEncoder<PredeterminedHashBloomFilter>;
+using PartitionedFastRangeEncoder = BloomEncoder<PartitionedBloomFilter, RangeReduction::FastRange>;
+using PartitionedPowerOfTwoEncoder = BloomEncoder<PartitionedBloomFilter, RangeReduction::PowerOfTwo>;
+using StandardBatchedEncoder = BloomEncoder<BloomFilter, RangeReduction::Modulo, true>;
+using PartitionedBatchedEncoder = BloomEncoder<PartitionedBloomFilter, RangeReduction::Modulo, true>;
+using StaticStandardEncoder = StaticEncoder<FilterKind::Standard>;
+using StaticPartitionedEncoder = StaticEncoder<FilterKind::Partitioned>;
+
+struct Arguments {
+    std::size_t count;
+    double fpr;
+    int positionBits;
+};
+
+Arguments arguments(const benchmark::State& state) {
+    return { static_cast<std::size_t>(state.range(0)), 1.0 / state.range(1), static_cast<int>(state.range(2)) };
+}
+
+template <typename Encoder>
+void reportMemory(benchmark::State& state, const Encoder& encoder, std::size_t count) {
+    state.counters["bits_per_kmer"] = static_cast<double>(encoder.memoryBits()) / count;
+}
+}
+
+// ------------------ Benchmarks ------------------ //
+// Insert throughput: builds the whole encoder each iteration.
+template <typename Encoder>
+static void BM_Insert(benchmark::State& state) {
+    auto args = arguments(state);
+    const auto& data = dataset(args.count);
+    Encoder encoder;
+    for (auto _ : state) {
+        encoder.build(data.kmers, args.fpr, args.positionBits);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * args.count);
+    reportMemory(state, encoder, args.count);
+}
+
+// Query throughput: independent membership tests in shuffled order.
+template <typename Encoder>
+static void BM_Query(benchmark::State& state) {
+    auto args = arguments(state);
+    const auto& data = dataset(args.count);
+    Encoder encoder;
+    encoder.build(data.kmers, args.fpr, args.positionBits);
+
+    std::size_t cursor = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(encoder.contains(data.kmers[data.queryOrder[cursor]]));
+        if (++cursor == args.count) cursor = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    reportMemory(state, encoder, args.count);
+}
+
+// getPosition latency: the next query depends on the previous result, so
+// lookups cannot overlap and the time per iteration is one full lookup.
+template <typename Encoder>
+static void BM_GetPosition(benchmark::State& state) {
+    auto args = arguments(state);
+    const auto& data = dataset(args.count);
+    Encoder encoder;
+    encoder.build(data.kmers, args.fpr, args.positionBits);
+
+    std::size_t cursor = 0;
+    for (auto _ : state) {
+        uint64_t position = encoder.position(data.kmers[data.queryOrder[cursor]]);
+        benchmark::DoNotOptimize(position);
+        // NOT_FOUND is all ones, any real position has a clear top bit
+        cursor += 1 + (position >> 63);
+        if (cursor >= args.count) cursor = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    reportMemory(state, encoder, args.count);
+}
+
+static void encoderArguments(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({ "kmers", "inv_fpr", "position_bits" })
+        ->ArgsProduct({ { 1 << 14, 1 << 18, 1 << 20 }, { 100, 1000 }, { 16, 24 } })
+        ->Unit(benchmark::kNanosecond);
+}
+
+// The map stores exact positions, so FPR and positionBits do not change it.
+static void mapArguments(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({ "kmers", "inv_fpr", "position_bits" })
+        ->ArgsProduct({ { 1 << 14, 1 << 18, 1 << 20 }, { 1000 }, { 24 } })
+        ->Unit(benchmark::kNanosecond);
+}
+
+BENCHMARK_TEMPLATE(BM_Insert, StandardEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, PartitionedEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, PredeterminedEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, PartitionedFastRangeEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, PartitionedPowerOfTwoEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, StandardBatchedEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, PartitionedBatchedEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, StaticStandardEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, StaticPartitionedEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, HashMapEncoder)->Apply(mapArguments)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Insert, MphEncoder)->Apply(encoderArguments)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_TEMPLATE(BM_Query, StandardEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, PartitionedEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, PredeterminedEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, PartitionedFastRangeEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, PartitionedPowerOfTwoEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, StaticStandardEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, StaticPartitionedEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_Query, HashMapEncoder)->Apply(mapArguments);
+BENCHMARK_TEMPLATE(BM_Query, MphEncoder)->Apply(encoderArguments);
+
+BENCHMARK_TEMPLATE(BM_GetPosition, StandardEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, PartitionedEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, PredeterminedEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, PartitionedFastRangeEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, PartitionedPowerOfTwoEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, StaticStandardEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, StaticPartitionedEncoder)->Apply(encoderArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, HashMapEncoder)->Apply(mapArguments);
+BENCHMARK_TEMPLATE(BM_GetPosition, MphEncoder)->Apply(encoderArguments);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,190 @@
+#include <benchmark/benchmark.h>
+#include "bloomFilterCascade.h"
+#include "kmerSampler.h"
+#include "readMapper.h"
+#include "shardedCascade.h"
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Read mapping throughput on a synthetic reference. Benchmarks take
+// (reference length, worker threads, minimizer window) as arguments, window
+// 0 indexing every k-mer; every run maps the same 150 bp reads with 1%
+// substitutions, half of them reverse complemented.
+
+namespace {
+constexpr unsigned KMER_LENGTH = 31;
+constexpr std::size_t READ_LENGTH = 150;
+constexpr std::size_t READ_COUNT = 20000;
+constexpr double ERROR_RATE = 0.01;
+
+struct Workload {
+    std::string reference;
+    std::vector<std::string> reads;
+    std::vector<uint64_t> starts;
+    BloomFilterCascade cascade;
+    SamplingConfig sampling;
+    SamplingStats samplingStats;
+
+    explicit Workload(CascadeConfig config) : cascade(config) {}
+};
+
+std::string reverseComplement(const std::string& sequence) {
+    std::string rc(sequence.rbegin(), sequence.rend());
+    for (auto& base : rc) {
+        switch (base) {
+        case 'A': base = 'T'; break;
+        case 'C': base = 'G'; break;
+        case 'G': base = 'C'; break;
+        case 'T': base = 'A'; break;
+        default: break;
+        }
+    }
+    return rc;
+}
+
+int bitsFor(uint64_t value) {
+    int bits = 1;
+    while ((value >> bits) != 0) bits++;
+    return bits;
+}
+
+SamplingConfig samplingFor(unsigned window) {
+    SamplingConfig sampling;
+    if (window > 0) {
+        sampling.scheme = SamplingScheme::Minimizer;
+        sampling.w = window;
+    }
+    return sampling;
+}
+
+// Random reference, the cascade over its (sampled) k-mers and the reads,
+// generated from a fixed seed and built once per reference length and
+// window.
+const Workload& workload(std::size_t referenceLength, unsigned window) {
+    static std::map<std::pair<std::size_t, unsigned>, std::unique_ptr<Workload>> cache;
+    auto it = cache.find({ referenceLength, window });
+    if (it != cache.end()) return *it->second;
+
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(referenceLength);
+    std::string reference(referenceLength, 'A');
+    for (auto& base : reference) base = bases[rng() & 3];
+
+    KmerSampler sampler(KMER_LENGTH, samplingFor(window));
+    std::vector<std::string> kmers;
+    std::vector<uint64_t> positions;
+    sampler.forEachSampled(reference, [&](std::size_t offset) {
+        kmers.push_back(reference.substr(offset, KMER_LENGTH));
+        positions.push_back(offset);
+        });
+
+    CascadeConfig config;
+    config.falsePositiveRate = 0.01;
+    config.positionBits = bitsFor(referenceLength);
+    // misses (read errors, the wrong strand) resolve in one round instead of
+    // falling through all of them
+    config.routed = true;
+    auto data = std::make_unique<Workload>(config);
+    data->cascade.build(kmers, positions);
+    data->sampling = sampler.getConfig();
+    data->samplingStats = sampler.getStats();
+    data->reference = std::move(reference);
+
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    for (std::size_t i = 0; i < READ_COUNT; i++) {
+        uint64_t start = rng() % (referenceLength - READ_LENGTH + 1);
+        std::string read = data->reference.substr(start, READ_LENGTH);
+        for (auto& base : read) {
+            if (coin(rng) < ERROR_RATE) base = bases[rng() & 3];
+        }
+        data->reads.push_back(i % 2 ? reverseComplement(read) : read);
+        data->starts.push_back(start);
+    }
+    return *cache.emplace(std::make_pair(referenceLength, window), std::move(data)).first->second;
+}
+
+// Every k-mer of the workload's reference in a sharded cascade with
+// L2-sized shards, routed by k-mer hash or by minimizer.
+const ShardedCascade& shardedIndex(std::size_t referenceLength, bool minimizerRouting) {
+    static std::map<std::pair<std::size_t, bool>, std::unique_ptr<ShardedCascade>> cache;
+    auto it = cache.find({ referenceLength, minimizerRouting });
+    if (it != cache.end()) return *it->second;
+
+    const auto& data = workload(referenceLength, 0);
+    std::vector<std::string> kmers;
+    std::vector<uint64_t> positions;
+    for (std::size_t i = 0; i + KMER_LENGTH <= referenceLength; i++) {
+        kmers.push_back(data.reference.substr(i, KMER_LENGTH));
+        positions.push_back(i);
+    }
+    ShardedBuildConfig config;
+    config.cascade = data.cascade.getConfig();
+    if (minimizerRouting) config.routing.mode = ShardRoutingPolicy::Mode::Minimizer;
+    auto index = std::make_unique<ShardedCascade>(ShardedCascade::build(kmers, positions, config));
+    return *cache.emplace(std::make_pair(referenceLength, minimizerRouting), std::move(index)).first->second;
+}
+}
+
+// ------------------ Benchmarks ------------------ //
+// Reads per second through ReadMapper::mapReads, plus the fraction placed at
+// their true origin and the index's sampling density and bits per base.
+static void BM_MapReads(benchmark::State& state) {
+    const auto& data = workload(static_cast<std::size_t>(state.range(0)), static_cast<unsigned>(state.range(2)));
+    MapperConfig config;
+    config.k = KMER_LENGTH;
+    config.numThreads = static_cast<unsigned>(state.range(1));
+    config.sampling = data.sampling;
+    ReadMapper mapper(data.cascade, config);
+
+    std::vector<ReadPlacement> placements;
+    for (auto _ : state) {
+        placements = mapper.mapReads(data.reads);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * data.reads.size());
+
+    std::size_t correct = 0;
+    for (std::size_t i = 0; i < placements.size(); i++) {
+        correct += placements[i].position == data.starts[i];
+    }
+    state.counters["correct"] = static_cast<double>(correct) / data.reads.size();
+    state.counters["density"] = data.samplingStats.density();
+    state.counters["bits_per_base"] = data.samplingStats.bitsPerBase(data.cascade.getMemoryBits());
+}
+
+BENCHMARK(BM_MapReads)
+    ->ArgNames({ "reference", "threads", "window" })
+    ->ArgsProduct({ { 1 << 20, 1 << 22 }, { 1, 2, 4, 8 }, { 0, 10 } })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Single-threaded mapping over a sharded index: minimizer routing keeps a
+// task's lookups inside a few cache-sized shards, hash routing spreads them
+// over all of them.
+static void BM_MapReadsSharded(benchmark::State& state) {
+    auto referenceLength = static_cast<std::size_t>(state.range(0));
+    const auto& data = workload(referenceLength, 0);
+    const auto& index = shardedIndex(referenceLength, state.range(1) != 0);
+    MapperConfig config;
+    config.k = KMER_LENGTH;
+    config.numThreads = 1;
+    ReadMapper mapper(index, config);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mapper.mapReads(data.reads));
+    }
+    state.SetItemsProcessed(state.iterations() * data.reads.size());
+    state.counters["shards"] = static_cast<double>(index.numShards());
+}
+
+BENCHMARK(BM_MapReadsSharded)
+    ->ArgNames({ "reference", "minimizer" })
+    ->ArgsProduct({ { 1 << 20, 1 << 22 }, { 0, 1 } })
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+#include "bloomfilter.h"
+
+// Cache-line blocked variant: one hash picks a 512-bit block and every
+// presence and position bit of the item lives inside that block, so a lookup
+// touches a single cache line regardless of numHashCount or chunkCount.
+//
+// Each block is split into 1 + chunkCount planes of blockPlaneWidth bits.
+// Plane 0 holds presence bits and plane c + 1 holds position chunk c, so a
+// slot is addressed by its presence bit and the position bits sit at fixed
+// offsets from it. Slots are identified by their global presence-bit index.
+class BlockedBloomFilter : public BloomFilter {
+public:
+    static constexpr std::size_t BLOCK_BITS = 512;
+    // Probe strides within a plane, picked by bits 1-4 of h2 (bit 0 is
+    // always set); see indexesFromDigest.
+    static constexpr uint32_t STRIDE_PRIMES[16] = {
+        521, 523, 541, 547, 557, 563, 569, 571,
+        577, 587, 593, 599, 601, 607, 613, 617
+    };
+
+    BlockedBloomFilter(std::size_t elementsToEncode,
+        double falsePositiveRate,
+        int positionBits = 1,
+        BloomFilterOptions options = {})
+        : BloomFilter(elementsToEncode, falsePositiveRate, positionBits,
+            withModuloReduction(withBlockedLayout(options)), SizeOnly{}),
+        numBlocks(0)
+    {
+        if (chunkCount + 1 > BLOCK_BITS) {
+            throw std::invalid_argument("[BlockedBF] Too many position chunks to fit in one block");
+        }
+        blockPlaneWidth = BLOCK_BITS / (chunkCount + 1);
+        if (blockPlaneWidth < static_cast<std::size_t>(numHashCount)) {
+            throw std::invalid_argument("[BlockedBF] Block plane narrower than the number of hash functions");
+        }
+
+        // keep the same number of presence slots as the unblocked filter
+        numBlocks = std::max<std::size_t>(1, (bitArraySize + blockPlaneWidth - 1) / blockPlaneWidth);
+        // the block count, not the slot count, is what h1 is reduced onto
+        rangeReduction = options.rangeReduction;
+        if (rangeReduction == RangeReduction::PowerOfTwo) {
+            numBlocks = std::bit_ceil(numBlocks);
+        }
+        bitArraySize = numBlocks * BLOCK_BITS;
+
+        // all planes live inside presenceBitset, one block per cache line
+        presenceBitset = PackedBitset(bitArraySize);
+
+        // probes always come from a single digest; this also keeps
+        // mightContain on the bulk path that calls computeHashIndexes
+        hashScheme = HashScheme::DoubleHashing;
+    }
+
+    // Restores a serialized filter; see FilterSerializer.
+    explicit BlockedBloomFilter(const FilterParameters& params)
+        : BloomFilter(params),
+        numBlocks(params.bitArraySize / BLOCK_BITS)
+    {
+    }
+
+    FilterParameters getParameters() const override {
+        FilterParameters params = BloomFilter::getParameters();
+        params.kind = FilterKind::Blocked;
+        return params;
+    }
+
+    uint64_t generateHash(const std::string& item, int i, int seed = 0) const override {
+        if (i < 0 || i >= numHashCount) {
+            throw std::out_of_range("[BlockedBF] Hash function index out of range");
+        }
+        std::vector<uint64_t> hashIndexes(numHashCount);
+        computeHashIndexes(item, seed, hashIndexes.data());
+        return hashIndexes[i];
+    }
+
+    std::size_t getNumBlocks() const {
+        return numBlocks;
+    }
+
+    std::size_t getBlockPlaneWidth() const {
+        return blockPlaneWidth;
+    }
+
+protected:
+    // Planar is the default and stands for "no preference"; any layout other
+    // than Planar or Blocked is a caller error rather than silently replaced.
+    static BloomFilterOptions withBlockedLayout(BloomFilterOptions options) {
+        if (options.slotLayout != SlotLayout::Planar && options.slotLayout != SlotLayout::Blocked) {
+            throw std::invalid_argument("[BlockedBF] Only the Planar or Blocked slot layout can be requested");
+        }
+        options.slotLayout = SlotLayout::Blocked;
+        return options;
+    }
+
+    // h1 selects the block; h2 yields a start offset and a stride for walking
+    // the presence plane. The stride is a prime larger than any plane width
+    // reduced modulo the width, so it is coprime with it and the numHashCount
+    // offsets of an item are always distinct.
+    void indexesFromDigest(uint64_t h1, uint64_t h2, uint64_t* out) const override {
+        uint64_t blockStart = reduceRange(h1, numBlocks) * BLOCK_BITS;
+        std::size_t offset = static_cast<std::size_t>((h2 >> 5) % blockPlaneWidth);
+        std::size_t stride = STRIDE_PRIMES[(h2 >> 1) & 15] % blockPlaneWidth;
+
+        for (int i = 0; i < numHashCount; i++) {
+            out[i] = blockStart + offset;
+            offset += stride;
+            if (offset >= blockPlaneWidth) {
+                offset -= blockPlaneWidth;
+            }
+        }
+    }
+
+private:
+    std::size_t numBlocks;
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "bloomfilter.h"
+#include "mphPositionIndex.h"
+
+// How the filter of each cascade round is sized.
+struct CascadeSizingPolicy {
+    enum class Mode {
+        // Every round is sized for the whole input.
+        Fixed,
+        // Each round is sized for the k-mers still left when it starts.
+        Adaptive
+    };
+
+    Mode mode = Mode::Adaptive;
+    // Adaptive rounds are sized for remaining / loadFactor elements; values
+    // below 1 over-provision a round so fewer k-mers spill into the next one.
+    double loadFactor = 1.0;
+    // Hash count (partitions) for rounds after the first; 0 keeps numHash.
+    int laterRoundNumHash = 0;
+    // Floor on the element count a round is sized for.
+    std::size_t minElements = 16;
+};
+
+struct CascadeConfig {
+    FilterKind kind = FilterKind::Partitioned;
+    double falsePositiveRate = 0.001;
+    // Partitioned: number of partitions (0 = optimal); Predetermined: hash count.
+    int numHash = 0;
+    int positionBits = 1;
+    int seed = 0;
+    // Upper bound on rounds, as a guard against inputs that can never settle.
+    std::size_t maxRounds = 64;
+    // Key every k-mer by min(k-mer, reverse complement) and keep a strand bit
+    // next to its position, so either strand of a read finds it. The round
+    // filters get one position bit more than positionBits.
+    bool canonical = false;
+    // Threads inserting each round (0 = hardware concurrency). Any count
+    // builds the same rounds as a single thread, so it is not serialized.
+    unsigned numThreads = 1;
+    // Build a router next to the rounds: a minimal perfect hash over the
+    // built k-mers storing each one's round and a fingerprint. Lookups then
+    // probe only the round the router names, and k-mers whose fingerprint
+    // does not match are rejected before any round is touched. Without it,
+    // a lookup stops at the first round claiming the k-mer, so the k-mers a
+    // round rejected but still claims (RoundStats::shadowed) decode to that
+    // round's wrong position; only turn it off where that is acceptable,
+    // or pair it with options.checkBits or lookupVerified.
+    bool routed = true;
+    // Router fingerprint width; an absent k-mer reaches a round filter with
+    // probability 2^-routerFingerprintBits.
+    int routerFingerprintBits = 8;
+    BloomFilterOptions options;
+    CascadeSizingPolicy sizing;
+};
+
+// In-memory cascade of position-encoding Bloom filters. Round r holds the
+// k-mers that collided in every earlier round; each k-mer keeps its original
+// position no matter which round finally accepts it.
+class BloomFilterCascade {
+public:
+    struct RoundStats {
+        std::size_t round;
+        std::size_t attempted;
+        std::size_t inserted;
+        // Rejected k-mers this round already claims (all probes present), so
+        // a lookup would stop here with a wrong position.
+        std::size_t shadowed;
+        // Element count the round's filter was sized for.
+        std::size_t sizedFor;
+        int numHash;
+        std::size_t filterSize;
+        std::size_t memoryBits;
+        double acceptanceRate;
+    };
+
+    explicit BloomFilterCascade(CascadeConfig config);
+
+    // Builds from k-mers whose position is their index in the input. A
+    // k-mer given more than once (in canonical mode, on either strand)
+    // keeps the position of its first occurrence; numKmers counts distinct
+    // k-mers.
+    void build(const std::vector<std::string>& kmers);
+    void build(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions);
+
+    // Walks the rounds in order; NOT_FOUND if no round claims the k-mer.
+    // With check bits (options.checkBits), a round whose decoded position
+    // fails its check does not stop the walk: the k-mer is passed on to the
+    // next round, as if that round did not claim it.
+    uint64_t lookup(const std::string& kmer) const;
+    // Canonical mode: position plus whether kmer is on the opposite strand
+    // from the k-mer that was built.
+    StrandedPosition lookupStranded(const std::string& kmer) const;
+    // Batched lookup: each round resolves the items earlier rounds did not.
+    void lookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const;
+    // lookupStranded for a batch; outside canonical mode every k-mer is on
+    // the forward strand.
+    void lookupStrandedBatch(std::span<const std::string> kmers, std::span<StrandedPosition> out) const;
+    bool mightContain(const std::string& kmer) const;
+    // lookup and lookupStranded checked against the reference the positions
+    // were taken from: a decoded position where the reference does not hold
+    // the k-mer is rejected. Without a router the walk then goes on to the
+    // next round, so k-mers an earlier round shadows are still found.
+    uint64_t lookupVerified(const std::string& kmer, const PackedReferenceStore& reference) const;
+    StrandedPosition lookupStrandedVerified(const std::string& kmer, const PackedReferenceStore& reference) const;
+
+    std::size_t numRounds() const { return rounds.size(); }
+    const BloomFilter& getRound(std::size_t round) const { return *rounds.at(round); }
+    const std::vector<RoundStats>& getRoundStats() const { return stats; }
+    const CascadeConfig& getConfig() const { return config; }
+    // Seed the filter of a round is built and queried with.
+    int getRoundSeed(std::size_t round) const;
+    // Memory of all rounds plus the router, if any.
+    std::size_t getMemoryBits() const;
+    // Router share of getMemoryBits (0 when not routed).
+    std::size_t getRouterBits() const;
+    bool isRouted() const { return router != nullptr; }
+    // getMemoryBits divided by the number of k-mers built.
+    double getBitsPerKmer() const;
+    // One JSON object: totals, then every round's build stats (acceptance
+    // rate included) next to its filter's dumpStats.
+    void dumpStats(std::ostream& out) const;
+
+    static std::unique_ptr<BloomFilter> makeFilter(const CascadeConfig& config, std::size_t elementsToEncode);
+
+    static constexpr uint64_t NOT_FOUND = BloomFilter::NOT_FOUND;
+    // Seed offset between rounds; larger than any hash count so the seed + i
+    // ranges of independent hashing never overlap.
+    static constexpr uint32_t ROUND_SEED_STRIDE = 1031;
+
+private:
+    friend class FilterSerializer;
+
+    CascadeConfig config;
+    std::vector<std::unique_ptr<BloomFilter>> rounds;
+    std::vector<RoundStats> stats;
+    std::size_t numKmers = 0;
+    // k-mer -> round that accepted it; only set when config.routed.
+    std::unique_ptr<MphPositionIndex> router;
+
+    CascadeConfig roundConfig(std::size_t round) const;
+    void buildRounds(const std::vector<std::string>& keys, const std::vector<uint64_t>& values);
+    void buildRouter(const std::vector<std::string>& keys, const std::vector<uint64_t>& keyRounds);
+    // Raw stored value (position, plus the strand bit in canonical mode).
+    uint64_t lookupValue(const std::string& key) const;
+    void lookupValueBatch(std::span<const std::string> keys, std::span<uint64_t> out) const;
+    void routedLookupBatch(std::span<const std::string> keys, std::span<uint64_t> out) const;
+    std::size_t roundCapacity(std::size_t totalKmers, std::size_t remaining) const;
+};
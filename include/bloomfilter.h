@@ -2,38 +2,550 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <span>
+#include <memory>
 #include <cstddef>  
+#include <cstring>
+#include <algorithm>
+#include <iosfwd>
+#include <stdexcept>
 #include "../external/MurmurHash3/murmurhash3.h"
+#include "intrinsics.h"
+#include "packedBitset.h"
+#include "packedKmer.h"
+#include "packedReferenceStore.h"
+#include "encoderStats.h"
 
 class BloomFilter;
+class FilterSerializer;
+template <typename Layout, int NumHash, int PositionBits>
+class StaticBloomFilter;
+
+// Concrete filter class, recorded when a filter is serialized.
+enum class FilterKind {
+    Standard,
+    Partitioned,
+    Predetermined,
+    Blocked
+};
+
+// How the numHashCount probe indexes of an item are derived.
+enum class HashScheme {
+    // One MurmurHash3 call per hash function, seeded with seed + i.
+    Independent,
+    // Kirsch-Mitzenmacher: one digest (h1, h2), probe i = h1 + i * h2.
+    DoubleHashing,
+    // Dillinger-Manolios: probe i = h1 + i * h2 + (i^3 - i) / 6.
+    EnhancedDoubleHashing
+};
+
+// Physical placement of a slot's presence bit and its chunkCount position bits.
+enum class SlotLayout {
+    // presenceBitset plus one separate bit array per position chunk.
+    Planar,
+    // 512-bit blocks split into 1 + chunkCount equal planes, so a slot's
+    // presence and position bits share one cache line (BlockedBloomFilter).
+    Blocked,
+    // Each slot is a (1 + chunkCount)-bit field in one packed array, so a
+    // probe reads its presence and position bits with a single load.
+    Interleaved
+};
+
+// How a 64-bit probe hash is mapped onto a range of slots.
+enum class RangeReduction {
+    // hash % range: exact, but a 64-bit division on every probe.
+    Modulo,
+    // Lemire's multiply-shift, (hash * range) >> 64: one multiplication,
+    // uses the high bits of the hash.
+    FastRange,
+    // Ranges are rounded up to powers of two and reduced with a mask; costs
+    // up to twice the memory.
+    PowerOfTwo
+};
+
+// Maps hashValue onto [0, range); with PowerOfTwo, range must be a power of
+// two. Callers pass the same reduction every time, so the switch predicts.
+inline uint64_t reduceToRange(uint64_t hashValue, uint64_t range, RangeReduction reduction) {
+    switch (reduction) {
+    case RangeReduction::FastRange:
+        return mulHigh64(hashValue, range);
+    case RangeReduction::PowerOfTwo:
+        return hashValue & (range - 1);
+    default:
+        return hashValue % range;
+    }
+}
+
+struct BloomFilterOptions {
+    HashScheme hashScheme = HashScheme::Independent;
+    SlotLayout slotLayout = SlotLayout::Planar;
+    // Reject items whose own probes share a slot but need different position
+    // bits there; otherwise the later probe wins and the item decodes wrongly.
+    bool rejectSelfCollisions = false;
+    RangeReduction rangeReduction = RangeReduction::Modulo;
+    // Check bits stored after the position bits of every item: a hash of
+    // the position, recomputed on lookup. A decode whose check bits disagree
+    // (a false positive, or a position garbled by slots shared with other
+    // items) returns AMBIGUOUS instead of a wrong position; a garbled value
+    // slips through with probability 2^-checkBits. Costs checkBits more
+    // position bits per item.
+    int checkBits = 0;
+};
+
+// Result of a canonical-mode lookup: the stored position and whether the
+// queried k-mer lies on the opposite strand from the inserted one.
+struct StrandedPosition {
+    uint64_t position;
+    bool reverse;
+};
+
+// Geometry of a built filter: enough to recreate it around existing bit
+// arrays without re-deriving sizes from an element count and FPR.
+struct FilterParameters {
+    FilterKind kind = FilterKind::Standard;
+    HashScheme hashScheme = HashScheme::Independent;
+    SlotLayout slotLayout = SlotLayout::Planar;
+    uint64_t bitArraySize = 0;
+    uint64_t numHashCount = 0;
+    uint64_t chunkCount = 0;
+    uint64_t positionBits = 0;
+    uint64_t partitionSize = 0;
+    uint64_t blockPlaneWidth = 0;
+    uint64_t slotFieldWidth = 0;
+    bool rejectSelfCollisions = false;
+    RangeReduction rangeReduction = RangeReduction::Modulo;
+    uint64_t checkBits = 0;
+};
 
 class BloomFilter {
 private:
+    friend class FilterSerializer;
+    // shares the digest functions so both hash items identically
+    template <typename Layout, int NumHash, int PositionBits>
+    friend class StaticBloomFilter;
+
     std::size_t positionBits;
+    std::size_t checkBits;
     bool isSet(uint64_t index) const;
-    std::vector<bool> encodePosition(uint64_t position) const;
+
+    // Unaligned 64-bit window starting at the byte holding bit; the slot store
+    // carries a padding word so the window never runs past the allocation.
+    uint64_t loadWindow(uint64_t bit) const {
+        uint64_t window;
+        std::memcpy(&window, reinterpret_cast<const unsigned char*>(presenceBitset.data()) + (bit >> 3),
+            sizeof(window));
+        return window;
+    }
+
+    void storeWindow(uint64_t bit, uint64_t window) {
+        std::memcpy(reinterpret_cast<unsigned char*>(presenceBitset.data()) + (bit >> 3), &window,
+            sizeof(window));
+    }
 
 protected:
-    std::vector<bool> presenceBitset;
+    PackedBitset presenceBitset;
 
-    std::vector<std::vector<bool>> positionBitsets;
+    std::vector<PackedBitset> positionBitsets;
     static uint64_t combine128to64(const uint8_t hash128[16]);
     std::size_t bitArraySize; 
     std::size_t chunkCount;
+    HashScheme hashScheme;
+    SlotLayout slotLayout;
+    RangeReduction rangeReduction;
+    // Width of one plane inside a 512-bit block; only used by SlotLayout::Blocked.
+    std::size_t blockPlaneWidth = 0;
+    // Bits per slot (presence + chunkCount); only used by SlotLayout::Interleaved.
+    std::size_t slotFieldWidth = 0;
+    // Field bits written by probe i: presence plus the chunks that carry a
+    // position bit for that probe.
+    std::vector<uint64_t> slotMasks;
+    bool rejectSelfCollisions;
+
+    // Set on filters whose bit arrays are views into a read-only mapping;
+    // backing keeps that mapping alive for as long as the filter is.
+    bool readOnly = false;
+    std::shared_ptr<const void> backing;
+
+    // Only present in KMER_ENCODING_STATS builds; mutable because lookups
+    // count too. Every KMER_STATS use below compiles away otherwise.
+    KMER_STATS(mutable FilterCounters counters;)
+
+    void countLookup([[maybe_unused]] int probesRead, [[maybe_unused]] bool hit) const {
+        KMER_STATS(
+            counters.lookups.add();
+            counters.probes.add(probesRead);
+            if (hit) counters.presenceHits.add();
+        )
+    }
+    // The "key": value fields of dumpStats, for subclasses that add their own.
+    void writeStatsFields(std::ostream& out) const;
+
+    // Recomputes chunkCount and the slot masks for the current numHashCount.
+    void sizeChunks();
+    // Does sizeChunks and allocates storage for bitArraySize slots in the
+    // selected layout.
+    void allocateSlots();
+    void computeSlotMasks();
+    void requireWritable() const;
+
+    // Restores the geometry of a serialized filter; storage is attached by
+    // FilterSerializer afterwards.
+    explicit BloomFilter(const FilterParameters& params);
+
+    // Sizes the filter like the public constructor but allocates no storage,
+    // for subclasses that lay out their own bit arrays.
+    struct SizeOnly {};
+    BloomFilter(std::size_t elementsToEncode, double falsePositiveRate, int positionBits,
+        BloomFilterOptions options, SizeOnly);
+
+    // ------------------ Slot Storage ------------------ //
+    // A probe index addresses a slot: one presence bit and one bit in each of
+    // the chunkCount position planes. Fields pack them with presence at bit 0
+    // and chunk c at bit c + 1.
+    bool presenceAt(uint64_t slot) const {
+        if (slotLayout == SlotLayout::Interleaved) {
+            return presenceBitset.test(slot * slotFieldWidth);
+        }
+        return presenceBitset.test(slot);
+    }
+
+    void setPresence(uint64_t slot) {
+        if (slotLayout == SlotLayout::Interleaved) {
+            presenceBitset.set(slot * slotFieldWidth);
+            return;
+        }
+        presenceBitset.set(slot);
+    }
+
+    uint64_t readSlot(uint64_t slot) const {
+        if (slotLayout == SlotLayout::Interleaved) {
+            uint64_t bit = slot * slotFieldWidth;
+            uint64_t fieldMask = ~0ULL >> (64 - slotFieldWidth);
+            return (loadWindow(bit) >> (bit & 7)) & fieldMask;
+        }
+
+        uint64_t field = presenceBitset.test(slot);
+        for (std::size_t c = 0; c < chunkCount; c++) {
+            bool bit = (slotLayout == SlotLayout::Blocked)
+                ? presenceBitset.test(slot + (c + 1) * blockPlaneWidth)
+                : positionBitsets[c].test(slot);
+            field |= static_cast<uint64_t>(bit) << (c + 1);
+        }
+        return field;
+    }
+
+    // Overwrites the field bits of slot selected by mask.
+    void writeSlot(uint64_t slot, uint64_t field, uint64_t mask) {
+        if (slotLayout == SlotLayout::Interleaved) {
+            uint64_t bit = slot * slotFieldWidth;
+            uint64_t shift = bit & 7;
+            uint64_t window = loadWindow(bit);
+            window = (window & ~(mask << shift)) | ((field & mask) << shift);
+            storeWindow(bit, window);
+            return;
+        }
+
+        if (mask & 1ULL) {
+            presenceBitset.assign(slot, field & 1ULL);
+        }
+        for (std::size_t c = 0; c < chunkCount; c++) {
+            if (!((mask >> (c + 1)) & 1ULL)) continue;
+            bool bit = (field >> (c + 1)) & 1ULL;
+            if (slotLayout == SlotLayout::Blocked) {
+                presenceBitset.assign(slot + (c + 1) * blockPlaneWidth, bit);
+            }
+            else {
+                positionBitsets[c].assign(slot, bit);
+            }
+        }
+    }
+
+    // writeSlot for concurrent builders: every touched word is updated
+    // atomically, so threads writing different slots that share a word keep
+    // each other's bits.
+    void writeSlotAtomic(uint64_t slot, uint64_t field, uint64_t mask);
+
+    // Prefetches every cache line readSlot(slot) will touch.
+    void prefetchSlot(uint64_t slot) const {
+        if (slotLayout == SlotLayout::Interleaved) {
+            presenceBitset.prefetch(slot * slotFieldWidth);
+            return;
+        }
+        presenceBitset.prefetch(slot);
+        if (slotLayout == SlotLayout::Planar) {
+            for (std::size_t c = 0; c < chunkCount; c++) {
+                positionBitsets[c].prefetch(slot);
+            }
+        }
+    }
+
+    // Position stored behind already computed probe indexes, NOT_FOUND if
+    // any probed slot is empty, or AMBIGUOUS if its check bits fail.
+    uint64_t decodeSlots(const uint64_t* hashIndexes) const;
+
+    // Bits stored per item: the position followed by its check bits.
+    std::size_t payloadBits() const { return positionBits + checkBits; }
+    // position with its check bits above it, as the slots store it.
+    uint64_t payloadFor(uint64_t position) const {
+        if (checkBits == 0) return position;
+        // salted, so position 0 does not get all-zero check bits
+        return position | ((mix64(position + 0x9e3779b97f4a7c15ULL) >> (64 - checkBits)) << positionBits);
+    }
+    // The position a decoded payload holds, or AMBIGUOUS if its check bits
+    // do not match it.
+    uint64_t positionFromPayload(uint64_t payload) const;
+
+    // Field probe i stores for a payload (presence bit included).
+    uint64_t slotFieldFor(uint64_t payload, int i) const;
+    // Number of occupied slots in [beginSlot, endSlot).
+    std::size_t countPresence(std::size_t beginSlot, std::size_t endSlot) const;
+
+    static void hashDigest(const std::string& item, int seed, uint64_t& h1, uint64_t& h2);
+
+    // Raw 64-bit hash for probe i, before it is mapped onto the bit array.
+    uint64_t probeHash(const std::string& item, int i, int seed) const;
+    uint64_t reduceRange(uint64_t hashValue, uint64_t range) const {
+        return reduceToRange(hashValue, range, rangeReduction);
+    }
+
+    // Options with Modulo reduction, for subclasses that size their own
+    // ranges and switch to the requested reduction afterwards.
+    static BloomFilterOptions withModuloReduction(BloomFilterOptions options) {
+        options.rangeReduction = RangeReduction::Modulo;
+        return options;
+    }
+
+    // Maps a raw probe hash onto a bit index; partitioned filters override this.
+    virtual uint64_t reduceIndex(uint64_t hashValue, int i) const;
+    // Fills out[0..numHashCount) with the probe indexes of item, hashing the
+    // item only once when a double-hashing scheme is selected.
+    virtual void computeHashIndexes(const std::string& item, int seed, uint64_t* out) const;
+    // Same for an item already hashed to 64 bits (e.g. a rolling k-mer hash);
+    // the seed is mixed in so rounds with different seeds stay independent.
+    void computeHashIndexesForHash(uint64_t itemHash, int seed, uint64_t* out) const;
+    // (h1, h2) digest of an item hash, matching what hashDigest gives strings.
+    static void hashDigest(uint64_t itemHash, int seed, uint64_t& h1, uint64_t& h2);
+    // Maps a double-hashing digest onto the numHashCount probe indexes;
+    // BlockedBloomFilter overrides this to keep every probe in one block.
+    virtual void indexesFromDigest(uint64_t h1, uint64_t h2, uint64_t* out) const;
+
+    // Index-level halves of the public operations, shared by the string and
+    // pre-hashed entry points.
+    bool insertAt(const uint64_t* hashIndexes, uint64_t position);
+    // The checks insertAt makes before writing: the position fits and no
+    // probed slot holds conflicting bits.
+    bool canInsertAt(const uint64_t* hashIndexes, uint64_t position) const;
+    // insertAt on up to BATCH_BLOCK items in turn, their probe indexes
+    // stored item after item, after prefetching every slot they probe.
+    void insertBlock(const uint64_t* hashIndexes, const uint64_t* positions, std::size_t count,
+        uint8_t* accepted);
+    bool presentAt(const uint64_t* hashIndexes) const;
+    // Stats builds: credits each slot the item is about to occupy to the
+    // first probe landing on it.
+    void countFilled(const uint64_t* hashIndexes) const;
 public:
+    // Returned by getPosition when the item is not in the filter.
+    static constexpr uint64_t NOT_FOUND = static_cast<uint64_t>(-1);
+    // Returned by getPosition when every probed slot is occupied but the
+    // decoded check bits do not match the position (see
+    // BloomFilterOptions::checkBits). Only filters with check bits return
+    // it; values >= AMBIGUOUS are never positions.
+    static constexpr uint64_t AMBIGUOUS = NOT_FOUND - 1;
+    // Number of items hashed and prefetched together by the batch queries
+    // and addBatch.
+    static constexpr std::size_t BATCH_BLOCK = 32;
+    // Items addParallel decides per pass; bounds its scratch memory.
+    static constexpr std::size_t PARALLEL_CHUNK = 1 << 18;
+
     int numHashCount;
     virtual uint64_t generateHash(const std::string& item, int i, int seed = 0) const;
-    BloomFilter(std::size_t elementsToEncode, double falsePositiveRate, int positionBits = 1);
+    BloomFilter(std::size_t elementsToEncode, double falsePositiveRate, int positionBits = 1,
+        BloomFilterOptions options = {});
+    virtual ~BloomFilter() = default;
+    virtual FilterParameters getParameters() const;
+    bool isReadOnly() const { return readOnly; }
+    HashScheme getHashScheme() const { return hashScheme; }
+    SlotLayout getSlotLayout() const { return slotLayout; }
+    RangeReduction getRangeReduction() const { return rangeReduction; }
     void addPresence(const std::string& item, int seed = 0);
     bool mightContain(const std::string& item, int seed = 0) const;
     void addPosition(const std::string& item, uint64_t position, int seed = 0);
     uint64_t getPosition(const std::string& item, int seed = 0) const;
+    // Batched queries: every item of a block is hashed and its slots
+    // prefetched before any of them is resolved, hiding DRAM latency behind
+    // the hashing of the rest of the block. out must be as long as items.
+    void mightContainBatch(std::span<const std::string> items, std::span<uint8_t> out, int seed = 0) const;
+    void getPositionBatch(std::span<const std::string> items, std::span<uint64_t> out, int seed = 0) const;
     std::pair<std::vector<uint64_t>, std::vector<int>> returnPartialCollisionIndex(
         const std::vector<uint64_t>& indexes) const;
     virtual std::size_t getSize() const;
-    const std::vector<bool>& getBitArray() const;
+    // Bits held by the presence and position arrays together.
+    std::size_t getMemoryBits() const;
+    std::size_t getPositionBits() const { return positionBits; }
+    std::size_t getCheckBits() const { return checkBits; }
+    const PackedBitset& getBitArray() const;
+
+    // ------------------ Statistics ------------------ //
+    // Counter values (see encoderStats.h); all zero unless built with
+    // KMER_ENCODING_STATS.
+    FilterStats getStats() const;
+    void resetStats();
+    // One JSON object: geometry, memory and, in stats builds, the counters.
+    virtual void dumpStats(std::ostream& out) const;
+
     static std::size_t calculateBitArraySize(std::size_t elementsToEncode, double falsePositiveRate);
     static int calculateOptimalHashNum(std::size_t elementsToEncode, std::size_t bitArraySize);
     static uint64_t binarySeqToDecimal(const std::vector<int>& bits);
     bool add(const std::string& item, uint64_t position, int seed = 0);
+
+    // ------------------ Batched Construction ------------------ //
+    // Same result as calling add(items[j], positions[j], seed) for each j in
+    // order, with accepted[j] set to what the j-th call returned, so rejected
+    // items can be passed on to another filter. Items are hashed a block at
+    // a time into one reused buffer and the block's slots are prefetched
+    // before any of them is checked.
+    void addBatch(std::span<const std::string> items, std::span<const uint64_t> positions,
+        std::span<uint8_t> accepted, int seed = 0);
+    void addBatchHashed(std::span<const uint64_t> itemHashes, std::span<const uint64_t> positions,
+        std::span<uint8_t> accepted, int seed = 0);
+
+    // ------------------ Parallel Construction ------------------ //
+    // Same result as calling add(items[s], positions[s], seed) for each s in
+    // selection, in that order, with accepted[j] set to what the j-th call
+    // returned; numThreads threads (0 = hardware concurrency) do the hashing,
+    // conflict checks and writes. The filter contents and accepted flags do
+    // not depend on the thread count.
+    void addParallel(std::span<const std::string> items, std::span<const uint64_t> positions,
+        std::span<const std::size_t> selection, std::span<uint8_t> accepted, int seed = 0,
+        unsigned numThreads = 0);
+
+    // Pre-hashed entry points for streaming ingest: the item is identified by
+    // a 64-bit hash (see RollingKmerHasher) instead of its string, so no
+    // string is built or hashed per k-mer. Items added this way must also be
+    // queried this way.
+    bool addHashed(uint64_t itemHash, uint64_t position, int seed = 0);
+    void addPresenceHashed(uint64_t itemHash, int seed = 0);
+    bool mightContainHashed(uint64_t itemHash, int seed = 0) const;
+    uint64_t getPositionHashed(uint64_t itemHash, int seed = 0) const;
+    void mightContainBatchHashed(std::span<const uint64_t> itemHashes, std::span<uint8_t> out, int seed = 0) const;
+    void getPositionBatchHashed(std::span<const uint64_t> itemHashes, std::span<uint64_t> out, int seed = 0) const;
+
+    // Canonical mode: the item is keyed by its canonical form and the stored
+    // value is (position << 1) | reversed, so one entry serves both strands.
+    // The filter needs one position bit more than the positions themselves.
+    bool addCanonicalHashed(uint64_t canonicalHash, bool reversed, uint64_t position, int seed = 0);
+    StrandedPosition getCanonicalPositionHashed(uint64_t canonicalHash, bool reversed, int seed = 0) const;
+
+    // ------------------ Packed K-mer Keys ------------------ //
+    // 2-bit packed k-mers with k fixed at compile time, hashed as one or two
+    // machine words (PackedKmer::hash) through the pre-hashed entry points.
+    // A k-mer added packed must be queried packed, not as a string. The batch
+    // forms deduce K from a span; from a vector, name K: getPositionBatch<31>.
+    template <unsigned K>
+    bool add(const PackedKmer<K>& kmer, uint64_t position, int seed = 0) {
+        return addHashed(kmer.hash(), position, seed);
+    }
+
+    template <unsigned K>
+    void addPresence(const PackedKmer<K>& kmer, int seed = 0) {
+        addPresenceHashed(kmer.hash(), seed);
+    }
+
+    template <unsigned K>
+    bool mightContain(const PackedKmer<K>& kmer, int seed = 0) const {
+        return mightContainHashed(kmer.hash(), seed);
+    }
+
+    template <unsigned K>
+    uint64_t getPosition(const PackedKmer<K>& kmer, int seed = 0) const {
+        return getPositionHashed(kmer.hash(), seed);
+    }
+
+    template <unsigned K>
+    bool addCanonical(const PackedKmer<K>& kmer, uint64_t position, int seed = 0) {
+        bool reversed;
+        PackedKmer<K> canonical = kmer.canonical(reversed);
+        return addCanonicalHashed(canonical.hash(), reversed, position, seed);
+    }
+
+    template <unsigned K>
+    StrandedPosition getCanonicalPosition(const PackedKmer<K>& kmer, int seed = 0) const {
+        bool reversed;
+        PackedKmer<K> canonical = kmer.canonical(reversed);
+        return getCanonicalPositionHashed(canonical.hash(), reversed, seed);
+    }
+
+    template <unsigned K>
+    void getCanonicalPositionBatch(std::span<const PackedKmer<K>> kmers, std::span<StrandedPosition> out,
+        int seed = 0) const {
+        if (out.size() != kmers.size()) {
+            throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
+        }
+        PackedKmer<K> canonical[BATCH_BLOCK];
+        uint8_t reversed[BATCH_BLOCK];
+        uint64_t hashes[BATCH_BLOCK];
+        uint64_t stored[BATCH_BLOCK];
+        for (std::size_t begin = 0; begin < kmers.size(); begin += BATCH_BLOCK) {
+            std::size_t count = std::min(BATCH_BLOCK, kmers.size() - begin);
+            std::copy_n(kmers.begin() + begin, count, canonical);
+            canonicalize(std::span<PackedKmer<K>>(canonical, count), std::span<uint8_t>(reversed, count));
+            for (std::size_t j = 0; j < count; j++) hashes[j] = canonical[j].hash();
+            getPositionBatchHashed(std::span<const uint64_t>(hashes, count), std::span<uint64_t>(stored, count), seed);
+            for (std::size_t j = 0; j < count; j++) {
+                out[begin + j] = stored[j] >= AMBIGUOUS
+                    ? StrandedPosition{ stored[j], false }
+                    : StrandedPosition{ stored[j] >> 1, static_cast<bool>(stored[j] & 1) != static_cast<bool>(reversed[j]) };
+            }
+        }
+    }
+
+    // ------------------ Verified Lookups ------------------ //
+    // getPosition followed by a check that reference holds the k-mer at the
+    // decoded position: false positives and positions garbled by colliding
+    // slots come back as NOT_FOUND instead of a wrong coordinate. reference
+    // must be the sequence the positions were taken from.
+    uint64_t getVerifiedPosition(const std::string& kmer, const PackedReferenceStore& reference,
+        int seed = 0) const;
+
+    template <unsigned K>
+    uint64_t getVerifiedPosition(const PackedKmer<K>& kmer, const PackedReferenceStore& reference,
+        int seed = 0) const {
+        uint64_t position = getPosition(kmer, seed);
+        return reference.matches(position, kmer) ? position : NOT_FOUND;
+    }
+
+    // Canonical mode: the strand bit says which strand of the reference the
+    // k-mer is read from, and that strand is the one compared.
+    template <unsigned K>
+    StrandedPosition getVerifiedCanonicalPosition(const PackedKmer<K>& kmer, const PackedReferenceStore& reference,
+        int seed = 0) const {
+        StrandedPosition hit = getCanonicalPosition(kmer, seed);
+        return reference.matches(hit.position, kmer, hit.reverse) ? hit : StrandedPosition{ NOT_FOUND, false };
+    }
+
+    template <unsigned K>
+    void mightContainBatch(std::span<const PackedKmer<K>> kmers, std::span<uint8_t> out, int seed = 0) const {
+        if (out.size() != kmers.size()) {
+            throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
+        }
+        uint64_t hashes[BATCH_BLOCK];
+        for (std::size_t begin = 0; begin < kmers.size(); begin += BATCH_BLOCK) {
+            std::size_t count = std::min(BATCH_BLOCK, kmers.size() - begin);
+            for (std::size_t j = 0; j < count; j++) hashes[j] = kmers[begin + j].hash();
+            mightContainBatchHashed(std::span<const uint64_t>(hashes, count), out.subspan(begin, count), seed);
+        }
+    }
+
+    template <unsigned K>
+    void getPositionBatch(std::span<const PackedKmer<K>> kmers, std::span<uint64_t> out, int seed = 0) const {
+        if (out.size() != kmers.size()) {
+            throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
+        }
+        uint64_t hashes[BATCH_BLOCK];
+        for (std::size_t begin = 0; begin < kmers.size(); begin += BATCH_BLOCK) {
+            std::size_t count = std::min(BATCH_BLOCK, kmers.size() - begin);
+            for (std::size_t j = 0; j < count; j++) hashes[j] = kmers[begin + j].hash();
+            getPositionBatchHashed(std::span<const uint64_t>(hashes, count), out.subspan(begin, count), seed);
+        }
+    }
 };
\ No newline at end of file
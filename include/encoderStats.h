@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hot-path counters, compiled in only when KMER_ENCODING_STATS is defined
+// (cmake -DKMER_ENCODING_STATS=ON). Without it KMER_STATS(...) expands to
+// nothing and filters carry no counters, so the default build pays nothing;
+// dumpStats then reports geometry and memory alone.
+#ifdef KMER_ENCODING_STATS
+#define KMER_STATS(...) __VA_ARGS__
+inline constexpr bool STATS_ENABLED = true;
+#else
+#define KMER_STATS(...)
+inline constexpr bool STATS_ENABLED = false;
+#endif
+
+// Relaxed atomic counter that copies by value, so filters holding counters
+// stay copyable. Const queries on many threads update it concurrently.
+class StatCounter {
+public:
+    StatCounter() = default;
+    StatCounter(const StatCounter& other) : value(other.load()) {}
+    StatCounter& operator=(const StatCounter& other) {
+        value.store(other.load(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    uint64_t load() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{ 0 };
+};
+
+// Counter values of one filter since it was built or last reset.
+struct FilterStats {
+    // getPosition / mightContain calls, batched and pre-hashed items included
+    uint64_t lookups = 0;
+    // slots read by lookups and insertion checks (early exits stop counting)
+    uint64_t probes = 0;
+    // lookups whose every probed presence bit was set
+    uint64_t presenceHits = 0;
+    // insertion attempts and the ones that were written
+    uint64_t adds = 0;
+    uint64_t accepted = 0;
+    // rejected because the position does not fit in positionBits
+    uint64_t rejectedPositionRange = 0;
+    // rejected because two of the item's own probes need different bits
+    uint64_t rejectedSelfCollision = 0;
+    // presence hits whose check bits did not match the decoded position
+    uint64_t checkFailures = 0;
+    // rejected at probe i: its occupied slot holds conflicting position bits
+    std::vector<uint64_t> conflictsByProbe;
+    // empty slots probe i has occupied; per-partition fill for partitioned filters
+    std::vector<uint64_t> filledByProbe;
+};
+
+struct FilterCounters {
+    StatCounter lookups;
+    StatCounter probes;
+    StatCounter presenceHits;
+    StatCounter adds;
+    StatCounter accepted;
+    StatCounter rejectedPositionRange;
+    StatCounter rejectedSelfCollision;
+    StatCounter checkFailures;
+    std::vector<StatCounter> conflictsByProbe;
+    std::vector<StatCounter> filledByProbe;
+
+    explicit FilterCounters(std::size_t numHash = 0)
+        : conflictsByProbe(numHash), filledByProbe(numHash) {}
+
+    FilterStats snapshot() const {
+        FilterStats stats;
+        stats.lookups = lookups.load();
+        stats.probes = probes.load();
+        stats.presenceHits = presenceHits.load();
+        stats.adds = adds.load();
+        stats.accepted = accepted.load();
+        stats.rejectedPositionRange = rejectedPositionRange.load();
+        stats.rejectedSelfCollision = rejectedSelfCollision.load();
+        stats.checkFailures = checkFailures.load();
+        for (const auto& counter : conflictsByProbe) stats.conflictsByProbe.push_back(counter.load());
+        for (const auto& counter : filledByProbe) stats.filledByProbe.push_back(counter.load());
+        return stats;
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "kmerSampler.h"
+#include "rollingHash.h"
+
+struct FastaRecord {
+    std::string name;
+    // Bases in the record, N and other non-ACGT symbols included.
+    uint64_t length = 0;
+    // Coordinate of the record's first base in the concatenation of all
+    // records, which is what encoders store as a k-mer's position.
+    uint64_t start = 0;
+};
+
+// One k-mer of the input: its rolling hash, 2-bit packed bases and location.
+struct KmerOccurrence {
+    uint64_t hash;
+    uint128 packed;
+    // Hash of min(k-mer, reverse complement), and whether that is the
+    // reverse complement; the key for canonical (strand-agnostic) encoding.
+    uint64_t canonicalHash;
+    bool reverse;
+    std::size_t record;
+    // 0-based offset of the k-mer's first base within its record.
+    uint64_t offset;
+    // FastaRecord::start + offset.
+    uint64_t coordinate;
+};
+
+// Streaming FASTA reader. The file is read through a fixed buffer and every
+// k-mer is produced from a RollingKmerHasher, so no string is built per
+// k-mer and memory use does not grow with the genome. K-mers containing a
+// non-ACGT base are skipped.
+class FastaReader {
+public:
+    static constexpr std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    explicit FastaReader(const std::string& path, std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    // Streams the whole file once, calling onKmer(const KmerOccurrence&) for
+    // every k-mer; returns the number of k-mers produced. The file is
+    // rewound first, so the reader can be scanned again with another k.
+    template <typename Callback>
+    uint64_t forEachKmer(unsigned k, Callback&& onKmer);
+    // forEachKmer restricted to the k-mers sampler picks, in file order;
+    // returns the number sampled. The sampler's stats accumulate over the
+    // scan, for its density and bits per base.
+    template <typename Callback>
+    uint64_t forEachSampledKmer(KmerSampler& sampler, Callback&& onKmer);
+
+    // Records seen by the last scan, in file order.
+    const std::vector<FastaRecord>& getRecords() const { return records; }
+    // Total number of bases over all records of the last scan.
+    uint64_t getTotalLength() const;
+
+private:
+    std::string path;
+    std::ifstream in;
+    std::vector<char> buffer;
+    std::size_t bufferPos = 0;
+    std::size_t bufferEnd = 0;
+    std::vector<FastaRecord> records;
+
+    void rewind();
+    // Refills the buffer; false at end of file.
+    bool refill();
+    // Next character of the file, or -1 at end of file.
+    int next() {
+        if (bufferPos == bufferEnd && !refill()) return -1;
+        return static_cast<unsigned char>(buffer[bufferPos++]);
+    }
+    // Reads the rest of a header line into a new record.
+    void startRecord();
+};
+
+template <typename Callback>
+uint64_t FastaReader::forEachKmer(unsigned k, Callback&& onKmer) {
+    rewind();
+    RollingKmerHasher hasher(k);
+    uint64_t produced = 0;
+    uint64_t coordinate = 0;
+    bool lineStart = true;
+
+    for (int c = next(); c != -1; c = next()) {
+        if (c == '\n' || c == '\r') {
+            lineStart = true;
+            continue;
+        }
+        if (lineStart && c == '>') {
+            if (!records.empty()) records.back().length = coordinate - records.back().start;
+            startRecord();
+            records.back().start = coordinate;
+            hasher.reset();
+            continue;
+        }
+        lineStart = false;
+        if (c == ' ' || c == '\t') continue;
+
+        // sequence before the first header belongs to an unnamed record
+        if (records.empty()) records.push_back({ "", 0, coordinate });
+        uint64_t offset = coordinate - records.back().start;
+        coordinate++;
+
+        uint8_t code = encodeBase(static_cast<char>(c));
+        if (code == INVALID_BASE) {
+            hasher.reset();
+            continue;
+        }
+        if (hasher.push(code)) {
+            uint64_t kmerOffset = offset + 1 - k;
+            onKmer(KmerOccurrence{ hasher.getHash(), hasher.getPacked(), hasher.getCanonicalHash(),
+                hasher.isReverseCanonical(), records.size() - 1, kmerOffset, records.back().start + kmerOffset });
+            produced++;
+        }
+    }
+    if (!records.empty()) records.back().length = coordinate - records.back().start;
+    return produced;
+}
+
+template <typename Callback>
+uint64_t FastaReader::forEachSampledKmer(KmerSampler& sampler, Callback&& onKmer) {
+    // the last maxDelay() + 1 k-mers of the run, by run index
+    std::vector<KmerOccurrence> recent(sampler.maxDelay() + 1);
+    std::size_t runLength = 0;
+    uint64_t nextCoordinate = 0;
+    uint64_t produced = 0;
+    auto emit = [&](std::size_t sampled) {
+        if (sampled == KmerSampler::NONE) return;
+        onKmer(recent[sampled % recent.size()]);
+        produced++;
+    };
+
+    forEachKmer(sampler.getK(), [&](const KmerOccurrence& kmer) {
+        // a gap in coordinates is an N or a record boundary
+        if (runLength > 0 && kmer.coordinate != nextCoordinate) {
+            emit(sampler.endRun());
+            runLength = 0;
+        }
+        recent[runLength % recent.size()] = kmer;
+        runLength++;
+        nextCoordinate = kmer.coordinate + 1;
+        emit(sampler.push(kmer.hash, kmer.canonicalHash, kmer.packed));
+        });
+    if (runLength > 0) emit(sampler.endRun());
+    return produced;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct FastqRecord {
+    // Header up to the first whitespace, without the '@'.
+    std::string name;
+    std::string sequence;
+    std::string quality;
+};
+
+// Streaming FASTQ reader for four-line records. Records are read into
+// caller-owned storage, so a reused batch keeps its string capacity and
+// reading allocates nothing once it has warmed up.
+class FastqReader {
+public:
+    static constexpr std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    explicit FastqReader(const std::string& path, std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+
+    // Reads the next record; false at end of file. Throws on a malformed
+    // record.
+    bool next(FastqRecord& record);
+    // Fills batch with up to maxRecords records, reusing its elements;
+    // returns how many were read (batch is resized to that).
+    std::size_t readBatch(std::vector<FastqRecord>& batch, std::size_t maxRecords);
+
+    // Records read so far.
+    std::size_t getRecordCount() const { return recordCount; }
+
+private:
+    std::string path;
+    std::vector<char> buffer;
+    std::ifstream in;
+    std::string line;
+    std::size_t recordCount = 0;
+
+    bool readLine(std::string& out);
+    // Throws a malformed-record error naming the record being read; the
+    // message is only built here, off the per-record path.
+    [[noreturn]] void fail(const char* what) const;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "bloomfilter.h"
+#include "bloomFilterCascade.h"
+#include "shardedCascade.h"
+
+// A filter restored from disk together with the seed it was saved with.
+struct StoredFilter {
+    std::unique_ptr<BloomFilter> filter;
+    int seed = 0;
+};
+
+// Versioned binary format for filters and cascades (little endian).
+//
+//   filter file : FilterHeader (128 bytes), then 1 + planes bit arrays, each
+//                 an ArrayHeader (64 bytes) followed by its cache-line padded
+//                 words
+//   cascade file: CascadeHeader, one RoundRecord per round, then one filter
+//                 section per round laid out as a filter file, then for
+//                 routed cascades the router's byte length and bytes
+//   sharded file: ShardedHeader (64 bytes, routing policy included), the
+//                 bucket -> shard table as one
+//                 uint32 per bucket, then one section per shard laid out as
+//                 a cascade file
+//
+// Every section starts on a 64-byte boundary, so a memory-mapped file can be
+// queried in place with the same alignment PackedBitset gives in memory.
+//
+// Readers accept only FORMAT_VERSION and reject set reserved bytes; the
+// version is bumped whenever a field is added or changes meaning.
+//
+// load* copies the arrays into owned memory; map* memory-maps the file and
+// returns read-only filters whose bit arrays point straight into the
+// mapping, which stays open for as long as any of them is alive.
+class FilterSerializer {
+    class Writer;
+    class Reader;
+
+public:
+    static constexpr uint32_t FORMAT_VERSION = 3;
+    static constexpr std::size_t SECTION_ALIGNMENT = 64;
+
+    static void saveFilter(const BloomFilter& filter, const std::string& path, int seed = 0);
+    static StoredFilter loadFilter(const std::string& path);
+    static StoredFilter mapFilter(const std::string& path);
+
+    static void saveCascade(const BloomFilterCascade& cascade, const std::string& path);
+    static BloomFilterCascade loadCascade(const std::string& path);
+    static BloomFilterCascade mapCascade(const std::string& path);
+
+    // Writes a sharded file one shard at a time, so a builder holds only the
+    // shard it is writing. The shard count comes from bucketShards and every
+    // shard has to be appended, in order, before close().
+    class ShardWriter {
+    public:
+        ShardWriter(const std::string& path, const std::vector<uint32_t>& bucketShards, uint64_t numKmers,
+            const ShardRoutingPolicy& routing = {});
+        ~ShardWriter();
+        void append(const BloomFilterCascade& shard);
+        void close();
+
+    private:
+        std::unique_ptr<Writer> writer;
+        std::size_t numShards;
+        std::size_t written = 0;
+    };
+
+    static void saveShardedCascade(const ShardedCascade& index, const std::string& path);
+    static ShardedCascade loadShardedCascade(const std::string& path);
+    static ShardedCascade mapShardedCascade(const std::string& path);
+
+private:
+    static void writeFilterSection(Writer& writer, const BloomFilter& filter, int seed);
+    static StoredFilter readFilterSection(Reader& reader, const std::shared_ptr<const void>& mapping);
+    static void writeCascadeSection(Writer& writer, const BloomFilterCascade& cascade);
+    static BloomFilterCascade readCascade(Reader& reader, const std::shared_ptr<const void>& mapping);
+    static ShardedCascade readShardedCascade(Reader& reader, const std::shared_ptr<const void>& mapping);
+};
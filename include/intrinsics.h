@@ -0,0 +1,103 @@
+#pragma once
+#include <compare>
+#include <cstdint>
+#include <type_traits>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <xmmintrin.h>
+#endif
+
+// Compiler-specific word operations behind one interface. GCC and Clang get
+// their builtins and unsigned __int128; cl.exe has neither, so it gets the
+// matching intrinsics and a two-word uint128. Defining
+// KMER_ENCODING_NO_INT128 selects the two-word type on any compiler, which
+// is how the fallback is tested off Windows.
+
+#if defined(_MSC_VER) || defined(KMER_ENCODING_NO_INT128)
+// Unsigned 128-bit integer as two 64-bit words, with the operators the
+// k-mer code uses: bitwise logic, shifts by [0, 128), +, - and ordering.
+struct uint128 {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    constexpr uint128() = default;
+    constexpr uint128(uint64_t value) : low(value) {}
+
+    // Truncates to the low word, like a cast from unsigned __int128.
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    explicit constexpr operator T() const { return static_cast<T>(low); }
+    explicit constexpr operator bool() const { return (low | high) != 0; }
+
+    friend constexpr uint128 operator~(uint128 a) { return words(~a.high, ~a.low); }
+    friend constexpr uint128 operator&(uint128 a, uint128 b) { return words(a.high & b.high, a.low & b.low); }
+    friend constexpr uint128 operator|(uint128 a, uint128 b) { return words(a.high | b.high, a.low | b.low); }
+    friend constexpr uint128 operator^(uint128 a, uint128 b) { return words(a.high ^ b.high, a.low ^ b.low); }
+
+    friend constexpr uint128 operator<<(uint128 a, unsigned shift) {
+        if (shift == 0) return a;
+        if (shift >= 64) return words(a.low << (shift - 64), 0);
+        return words((a.high << shift) | (a.low >> (64 - shift)), a.low << shift);
+    }
+    friend constexpr uint128 operator>>(uint128 a, unsigned shift) {
+        if (shift == 0) return a;
+        if (shift >= 64) return words(0, a.high >> (shift - 64));
+        return words(a.high >> shift, (a.low >> shift) | (a.high << (64 - shift)));
+    }
+
+    friend constexpr uint128 operator+(uint128 a, uint128 b) {
+        uint64_t low = a.low + b.low;
+        return words(a.high + b.high + (low < a.low), low);
+    }
+    friend constexpr uint128 operator-(uint128 a, uint128 b) {
+        return words(a.high - b.high - (a.low < b.low), a.low - b.low);
+    }
+
+    constexpr uint128& operator&=(uint128 b) { return *this = *this & b; }
+    constexpr uint128& operator|=(uint128 b) { return *this = *this | b; }
+    constexpr uint128& operator^=(uint128 b) { return *this = *this ^ b; }
+    constexpr uint128& operator<<=(unsigned shift) { return *this = *this << shift; }
+    constexpr uint128& operator>>=(unsigned shift) { return *this = *this >> shift; }
+
+    friend constexpr bool operator==(uint128 a, uint128 b) { return a.low == b.low && a.high == b.high; }
+    friend constexpr std::strong_ordering operator<=>(uint128 a, uint128 b) {
+        return a.high != b.high ? a.high <=> b.high : a.low <=> b.low;
+    }
+
+private:
+    static constexpr uint128 words(uint64_t high, uint64_t low) {
+        uint128 value;
+        value.high = high;
+        value.low = low;
+        return value;
+    }
+};
+#else
+using uint128 = unsigned __int128;
+#endif
+
+// High word of the 128-bit product a * b.
+inline uint64_t mulHigh64(uint64_t a, uint64_t b) {
+#if defined(_MSC_VER)
+    return __umulh(a, b);
+#else
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#endif
+}
+
+// Reverses the byte order of a word.
+inline uint64_t byteSwap64(uint64_t x) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(x);
+#else
+    return __builtin_bswap64(x);
+#endif
+}
+
+// Hints the cache line holding address into L1 ahead of a read.
+inline void prefetchRead(const void* address) {
+#if defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    __builtin_prefetch(address, 0, 3);
+#endif
+}
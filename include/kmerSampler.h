@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "rollingHash.h"
+
+// Which k-mers of a sequence are indexed. Sampling trades seeds per read for
+// index size: only the sampled k-mers are inserted, and a read is queried
+// with the k-mers the same scheme picks from it, so the two sides agree on
+// every k-mer they share.
+enum class SamplingScheme {
+    // Every k-mer.
+    All,
+    // (w,k)-minimizers: the k-mer with the smallest hash in every window of
+    // w consecutive k-mers. Density about 2 / (w + 1).
+    Minimizer,
+    // K-mers whose smallest s-mer (by hash) starts at offset t. Density
+    // about 1 / (k - s + 1).
+    OpenSyncmer,
+    // K-mers whose smallest s-mer is their first or last one. Density about
+    // 2 / (k - s + 1).
+    ClosedSyncmer
+};
+
+struct SamplingConfig {
+    SamplingScheme scheme = SamplingScheme::All;
+    // Minimizer window, in k-mers.
+    unsigned w = 10;
+    // Syncmer s-mer length (1 <= s < k, s <= 32).
+    unsigned s = 11;
+    // Open syncmer offset of the smallest s-mer (t <= k - s).
+    unsigned t = 0;
+    // Order k-mers and s-mers by their canonical form, so both strands of a
+    // sequence sample the same k-mers (for open syncmers only when t is
+    // (k - s) / 2). Use it with canonical indexes.
+    bool canonical = false;
+};
+
+struct SamplingStats {
+    // K-mers seen, k-mers sampled, and ACGT bases covered by the k-mers seen.
+    uint64_t kmers = 0;
+    uint64_t sampled = 0;
+    uint64_t bases = 0;
+
+    // Fraction of the k-mers that were sampled.
+    double density() const { return kmers == 0 ? 0.0 : static_cast<double>(sampled) / kmers; }
+    // Index size per base of the sampled sequence.
+    double bitsPerBase(std::size_t memoryBits) const {
+        return bases == 0 ? 0.0 : static_cast<double>(memoryBits) / bases;
+    }
+};
+
+// Streaming k-mer sampler. It is fed the k-mers of a run (consecutive
+// overlapping k-mers, i.e. a stretch of sequence without N) one at a time,
+// identified by their index in the run, and answers with the index of the
+// k-mer it samples, if any. A minimizer is only known once its window is
+// complete, so the answer can lag the k-mer just pushed by up to maxDelay()
+// k-mers; syncmers and All answer for the k-mer just pushed.
+class KmerSampler {
+public:
+    static constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+
+    explicit KmerSampler(unsigned k, SamplingConfig config = {});
+
+    // Next k-mer of the current run: its forward and canonical ntHash and
+    // its 2-bit packed bases (RollingKmerHasher). Returns the run index of
+    // the k-mer sampled now, or NONE.
+    std::size_t push(uint64_t hash, uint64_t canonicalHash, uint128 packed);
+    // Ends the run (an N, the end of a record or read). A run too short to
+    // fill one minimizer window still yields its smallest k-mer, which is
+    // returned here; otherwise NONE.
+    std::size_t endRun();
+
+    // Run indexes a caller must keep to resolve a push() answer.
+    std::size_t maxDelay() const;
+    unsigned getK() const { return k; }
+    const SamplingConfig& getConfig() const { return config; }
+    const SamplingStats& getStats() const { return stats; }
+    void resetStats() { stats = {}; }
+
+    // Calls onOffset(offset) with the offset of every sampled k-mer of
+    // sequence, in increasing order. Runs are split at non-ACGT bases.
+    template <typename Callback>
+    void forEachSampled(std::string_view sequence, Callback&& onOffset);
+
+private:
+    // Sliding window minimum: a ring of (value, index) with increasing
+    // values, so the front is the leftmost minimum of the window.
+    class MinWindow {
+    public:
+        void init(std::size_t capacity) { entries.assign(capacity, {}); clear(); }
+        void clear() { head = 0; count = 0; }
+        void push(uint64_t value, std::size_t index);
+        void evictBefore(std::size_t index);
+        std::size_t frontIndex() const { return entries[head].index; }
+
+    private:
+        struct Entry {
+            uint64_t value;
+            std::size_t index;
+        };
+        std::vector<Entry> entries;
+        std::size_t head = 0;
+        std::size_t count = 0;
+    };
+
+    unsigned k;
+    SamplingConfig config;
+    SamplingStats stats;
+    MinWindow window;
+    // K-mers pushed in the current run, and the last minimizer returned.
+    std::size_t runLength = 0;
+    std::size_t lastSampled = NONE;
+
+    std::size_t pushMinimizer(uint64_t hash);
+    std::size_t pushSyncmer(uint128 packed);
+    uint64_t smerHash(uint128 packed, unsigned offset) const;
+};
+
+template <typename Callback>
+void KmerSampler::forEachSampled(std::string_view sequence, Callback&& onOffset) {
+    RollingKmerHasher hasher(k);
+    // the run's first k-mer starts here; run indexes count from it
+    std::size_t runStart = 0;
+    for (std::size_t j = 0; j < sequence.size(); j++) {
+        uint8_t code = encodeBase(sequence[j]);
+        if (code == INVALID_BASE) {
+            std::size_t sampled = endRun();
+            if (sampled != NONE) onOffset(runStart + sampled);
+            hasher.reset();
+            runStart = j + 1;
+            continue;
+        }
+        if (!hasher.push(code)) continue;
+        std::size_t sampled = push(hasher.getHash(), hasher.getCanonicalHash(), hasher.getPacked());
+        if (sampled != NONE) onOffset(runStart + sampled);
+    }
+    std::size_t sampled = endRun();
+    if (sampled != NONE) onOffset(runStart + sampled);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <variant>
+#include <vector>
+#include "pthash.hpp"
+
+struct MphConfig {
+    // partitioned_phf (PTHash-HEM) instead of a single_phf over all keys.
+    bool partitioned = false;
+    // Keys per partition when partitioned (0 = 100000).
+    uint64_t avgPartitionSize = 0;
+    uint64_t numThreads = 1;
+    // Build with pthash's external-memory builder, spilling to tmpDir and
+    // staying within ramBytes (0 = pthash default).
+    bool externalMemory = false;
+    std::string tmpDir = pthash::constants::default_tmp_dirname;
+    uint64_t ramBytes = 0;
+    // Width of the stored position; 0 = just wide enough for the largest one.
+    int positionBits = 0;
+    // Fingerprint bits kept per k-mer; absent k-mers get through with
+    // probability 2^-fingerprintBits. With 0 every query returns a position.
+    int fingerprintBits = 0;
+    double lambda = 4.5;
+    double alpha = 0.98;
+    uint64_t seed = 0;
+};
+
+// Exact k-mer -> position index: a minimal perfect hash function over the
+// k-mer set maps each k-mer to a slot of a bit-packed value array holding its
+// position and optional fingerprint. Exposes the same lookup interface as
+// BloomFilterCascade so the two can be compared directly.
+class MphPositionIndex {
+public:
+    using SingleFunction = pthash::single_phf<pthash::xxhash128, pthash::skew_bucketer,
+        pthash::dictionary_dictionary, true, pthash::pthash_search_type::xor_displacement>;
+    using PartitionedFunction = pthash::partitioned_phf<pthash::xxhash128, pthash::skew_bucketer,
+        pthash::dictionary_dictionary, true, pthash::pthash_search_type::xor_displacement>;
+
+    explicit MphPositionIndex(MphConfig config = {});
+
+    // Builds from k-mers whose position is their index in the input. K-mers
+    // must be distinct.
+    void build(const std::vector<std::string>& kmers);
+    void build(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions);
+
+    // Position of kmer; NOT_FOUND if its fingerprint does not match. Without
+    // fingerprints, absent k-mers return the position of an arbitrary k-mer.
+    uint64_t lookup(const std::string& kmer) const;
+    void lookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const;
+    bool mightContain(const std::string& kmer) const;
+
+    std::size_t size() const { return numKmers; }
+    const MphConfig& getConfig() const { return config; }
+    int getPositionBits() const { return positionBits; }
+    // Bits of the perfect hash function alone.
+    std::size_t getFunctionBits() const;
+    // Function plus packed positions and fingerprints.
+    std::size_t getMemoryBits() const;
+    double getBitsPerKmer() const;
+
+    // Writes the built function and entries with pthash's essentials
+    // layout; load replaces whatever the index held.
+    void save(std::ostream& out) const;
+    void load(std::istream& in);
+
+    static constexpr uint64_t NOT_FOUND = UINT64_MAX;
+    static constexpr std::size_t BATCH_BLOCK = 32;
+
+private:
+    MphConfig config;
+    std::variant<SingleFunction, PartitionedFunction> function;
+    // (fingerprint << positionBits) | position, one entry per slot, so a
+    // lookup touches one packed entry after the function.
+    bits::compact_vector values;
+    std::size_t numKmers = 0;
+    int positionBits = 0;
+    uint64_t seed = 0;
+
+    pthash::hash128 hashKmer(const std::string& kmer) const;
+    uint64_t slotFor(const pthash::hash128& hash) const;
+    uint64_t fingerprintOf(const pthash::hash128& hash) const;
+    uint64_t resolve(const pthash::hash128& hash, uint64_t slot) const;
+};
@@ -0,0 +1,212 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include "intrinsics.h"
+
+// Allocator handing out cache-line aligned storage so that word w of a bitset
+// always lives in cache line w / 8.
+template <typename T, std::size_t Alignment = 64>
+struct CacheAlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = CacheAlignedAllocator<U, Alignment>;
+    };
+
+    CacheAlignedAllocator() noexcept = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+// Word-packed bitset backed by 64-bit words. Storage is rounded up to whole
+// cache lines and bits past size() are kept at zero so popcounts stay exact.
+// A bitset either owns its words or is a read-only view over external memory
+// (for example a memory-mapped file); views must not be written or resized.
+class PackedBitset {
+public:
+    static constexpr std::size_t WORD_BITS = 64;
+    static constexpr std::size_t CACHE_LINE_BYTES = 64;
+    static constexpr std::size_t WORDS_PER_LINE = CACHE_LINE_BYTES / sizeof(uint64_t);
+
+    PackedBitset() = default;
+
+    explicit PackedBitset(std::size_t numBits, bool value = false) {
+        resize(numBits, value);
+    }
+
+    PackedBitset(const PackedBitset& other)
+        : words(other.words), bitCount(other.bitCount), external(other.external) {
+        bits = external ? other.bits : words.data();
+    }
+
+    PackedBitset& operator=(const PackedBitset& other) {
+        if (this != &other) {
+            words = other.words;
+            bitCount = other.bitCount;
+            external = other.external;
+            bits = external ? other.bits : words.data();
+        }
+        return *this;
+    }
+
+    // a moved vector keeps its buffer, so bits stays valid
+    PackedBitset(PackedBitset&&) noexcept = default;
+    PackedBitset& operator=(PackedBitset&&) noexcept = default;
+
+    // Non-owning view over storageWordsFor(numBits) words at data. The memory
+    // must stay alive and cache-line padded for as long as the view is used.
+    static PackedBitset view(const uint64_t* data, std::size_t numBits) {
+        PackedBitset viewed;
+        viewed.bits = const_cast<uint64_t*>(data);
+        viewed.bitCount = numBits;
+        viewed.external = true;
+        return viewed;
+    }
+
+    // Words backing numBits bits once rounded up to whole cache lines.
+    static std::size_t storageWordsFor(std::size_t numBits) {
+        return (wordsFor(numBits) + WORDS_PER_LINE - 1) / WORDS_PER_LINE * WORDS_PER_LINE;
+    }
+
+    bool isView() const { return external; }
+
+    void resize(std::size_t numBits, bool value = false) {
+        if (external) {
+            throw std::logic_error("[PackedBitset] Cannot resize a view");
+        }
+        std::size_t oldBits = bitCount;
+        words.resize(storageWordsFor(numBits), 0ULL);
+        bits = words.data();
+        bitCount = numBits;
+
+        // bits past the old size are zero, so only growth needs filling
+        if (value && oldBits < numBits) {
+            std::size_t firstWord = oldBits / WORD_BITS;
+            bits[firstWord] |= ~0ULL << (oldBits % WORD_BITS);
+            std::fill(bits + firstWord + 1, bits + numWords(), ~0ULL);
+        }
+        clearTail();
+    }
+
+    std::size_t size() const { return bitCount; }
+    std::size_t numWords() const { return wordsFor(bitCount); }
+    std::size_t sizeInBytes() const { return storageWordsFor(bitCount) * sizeof(uint64_t); }
+
+    bool test(std::size_t index) const {
+        return (bits[index / WORD_BITS] >> (index % WORD_BITS)) & 1ULL;
+    }
+
+    bool operator[](std::size_t index) const { return test(index); }
+
+    void set(std::size_t index) {
+        bits[index / WORD_BITS] |= 1ULL << (index % WORD_BITS);
+    }
+
+    void reset(std::size_t index) {
+        bits[index / WORD_BITS] &= ~(1ULL << (index % WORD_BITS));
+    }
+
+    void assign(std::size_t index, bool value) {
+        uint64_t mask = 1ULL << (index % WORD_BITS);
+        uint64_t& w = bits[index / WORD_BITS];
+        w = (w & ~mask) | (value ? mask : 0ULL);
+    }
+
+    // Zero every bit without releasing storage.
+    void clear() {
+        std::fill(bits, bits + storageWordsFor(bitCount), 0ULL);
+    }
+
+    // Number of set bits in the whole bitset.
+    std::size_t count() const {
+        std::size_t total = 0;
+        for (std::size_t w = 0; w < numWords(); w++) {
+            total += std::popcount(bits[w]);
+        }
+        return total;
+    }
+
+    // Number of set bits in [begin, end).
+    std::size_t count(std::size_t begin, std::size_t end) const {
+        if (begin > end || end > bitCount) {
+            throw std::out_of_range("[PackedBitset] Invalid range for count");
+        }
+        if (begin == end) return 0;
+
+        std::size_t firstWord = begin / WORD_BITS;
+        std::size_t lastWord = (end - 1) / WORD_BITS;
+        uint64_t headMask = ~0ULL << (begin % WORD_BITS);
+        uint64_t tailMask = ~0ULL >> (WORD_BITS - 1 - ((end - 1) % WORD_BITS));
+
+        if (firstWord == lastWord) {
+            return std::popcount(bits[firstWord] & headMask & tailMask);
+        }
+        std::size_t total = std::popcount(bits[firstWord] & headMask);
+        for (std::size_t w = firstWord + 1; w < lastWord; w++) {
+            total += std::popcount(bits[w]);
+        }
+        total += std::popcount(bits[lastWord] & tailMask);
+        return total;
+    }
+
+    // Bulk OR of an equally sized bitset into this one.
+    PackedBitset& operator|=(const PackedBitset& other) {
+        if (other.bitCount != bitCount) {
+            throw std::invalid_argument("[PackedBitset] Size mismatch in bulk OR");
+        }
+        for (std::size_t w = 0; w < numWords(); w++) {
+            bits[w] |= other.bits[w];
+        }
+        return *this;
+    }
+
+    // Hint the cache line holding bit index into L1 ahead of a read.
+    void prefetch(std::size_t index) const {
+        prefetchRead(bits + index / WORD_BITS);
+    }
+
+    // Raw word access.
+    uint64_t word(std::size_t w) const { return bits[w]; }
+    uint64_t* data() { return bits; }
+    const uint64_t* data() const { return bits; }
+
+private:
+    static std::size_t wordsFor(std::size_t numBits) {
+        return (numBits + WORD_BITS - 1) / WORD_BITS;
+    }
+
+    void clearTail() {
+        std::size_t used = numWords();
+        if (bitCount % WORD_BITS != 0) {
+            bits[used - 1] &= ~0ULL >> (WORD_BITS - bitCount % WORD_BITS);
+        }
+        for (std::size_t w = used; w < words.size(); w++) {
+            bits[w] = 0ULL;
+        }
+    }
+
+    std::vector<uint64_t, CacheAlignedAllocator<uint64_t>> words;
+    // words.data() for owning bitsets, the external memory for views
+    uint64_t* bits = nullptr;
+    std::size_t bitCount = 0;
+    bool external = false;
+};
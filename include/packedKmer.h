@@ -0,0 +1,163 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "intrinsics.h"
+#include "rollingHash.h"
+
+// splitmix64 finalizer: a bijective mix that spreads every input bit over
+// the whole word.
+inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// A k-mer as 2-bit codes (A=0, C=1, G=2, T=3) in one machine word, first base
+// in the most significant used bits. K is fixed at compile time, so the word
+// type, mask and hash are specialized: 8 bytes for k <= 32, 16 for k <= 64,
+// instead of a heap string per k-mer.
+template <unsigned K>
+struct PackedKmer {
+    static_assert(K >= 1 && K <= 64, "PackedKmer supports 1 <= k <= 64");
+
+    using Word = std::conditional_t<(K <= 32), uint64_t, uint128>;
+    static constexpr unsigned k = K;
+    static constexpr Word MASK = (2 * K == 8 * sizeof(Word))
+        ? ~Word(0)
+        : ((Word(1) << (2 * K)) - 1);
+
+    Word bits = 0;
+
+    PackedKmer() = default;
+    explicit PackedKmer(Word bits) : bits(bits & MASK) {}
+
+    // Throws if kmer is not exactly K bases of ACGT (either case).
+    static PackedKmer fromString(std::string_view kmer) {
+        if (kmer.size() != K) {
+            throw std::invalid_argument("[PackedKmer] Expected a k-mer of length " + std::to_string(K));
+        }
+        Word packed = 0;
+        for (char base : kmer) {
+            uint8_t code = encodeBase(base);
+            if (code == INVALID_BASE) {
+                throw std::invalid_argument("[PackedKmer] K-mer contains a non-ACGT base");
+            }
+            packed = (packed << 2) | code;
+        }
+        return PackedKmer(packed);
+    }
+
+    // From a RollingKmerHasher window (or KmerOccurrence::packed) of width K.
+    static PackedKmer fromPacked(uint128 window) {
+        return PackedKmer(static_cast<Word>(window));
+    }
+
+    std::string toString() const {
+        static constexpr char BASES[4] = { 'A', 'C', 'G', 'T' };
+        std::string kmer(K, 'A');
+        Word packed = bits;
+        for (unsigned j = K; j-- > 0;) {
+            kmer[j] = BASES[static_cast<unsigned>(packed & 3)];
+            packed >>= 2;
+        }
+        return kmer;
+    }
+
+    // 64-bit hash of the packed word; K is mixed in so that k-mers of
+    // different lengths with equal bits (e.g. AAA and AAAA) differ.
+    uint64_t hash() const {
+        constexpr uint64_t SALT = 0x9e3779b97f4a7c15ULL * K;
+        if constexpr (K <= 32) {
+            return mix64(bits + SALT);
+        }
+        else {
+            uint64_t low = static_cast<uint64_t>(bits);
+            uint64_t high = static_cast<uint64_t>(bits >> 64);
+            return mix64(low ^ mix64(high + SALT));
+        }
+    }
+
+    // Reverse complement without a per-base loop: complementing a 2-bit code
+    // is ~code (A<->T, C<->G), and the bases are reversed by a byte swap
+    // followed by swapping nibbles and then 2-bit pairs inside every byte.
+    PackedKmer reverseComplement() const {
+        if constexpr (K <= 32) {
+            return PackedKmer(reverseCodes(~bits) >> (64 - 2 * K));
+        }
+        else {
+            Word complement = ~bits;
+            Word reversed = (static_cast<Word>(reverseCodes(static_cast<uint64_t>(complement))) << 64)
+                | reverseCodes(static_cast<uint64_t>(complement >> 64));
+            return PackedKmer(reversed >> (128 - 2 * K));
+        }
+    }
+
+    // min(kmer, reverseComplement(kmer)); reversed is set when the reverse
+    // complement was chosen. Palindromes keep their own orientation.
+    PackedKmer canonical(bool& reversed) const {
+        PackedKmer rc = reverseComplement();
+        reversed = rc.bits < bits;
+        return reversed ? rc : *this;
+    }
+
+    friend bool operator==(const PackedKmer& a, const PackedKmer& b) { return a.bits == b.bits; }
+    friend bool operator<(const PackedKmer& a, const PackedKmer& b) { return a.bits < b.bits; }
+
+private:
+    // Reverses the order of the 32 2-bit codes of a word.
+    static uint64_t reverseCodes(uint64_t x) {
+        x = byteSwap64(x);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        return x;
+    }
+};
+
+// Canonicalizes kmers in place and records which ones were reverse
+// complemented. The loop body is branch-free word arithmetic, so for k <= 32
+// the compiler vectorizes it across k-mers.
+template <unsigned K>
+void canonicalize(std::span<PackedKmer<K>> kmers, std::span<uint8_t> reversed) {
+    if (reversed.size() != kmers.size()) {
+        throw std::invalid_argument("[PackedKmer] Strand output size must match the number of k-mers");
+    }
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        auto forward = kmers[j].bits;
+        auto rc = kmers[j].reverseComplement().bits;
+        bool useReverse = rc < forward;
+        kmers[j].bits = useReverse ? rc : forward;
+        reversed[j] = useReverse;
+    }
+}
+
+// String form of PackedKmer::canonical for k-mers of any length: the
+// lexicographically smaller of kmer and its reverse complement, which is the
+// same order as comparing packed codes. Bases are upper-cased; non-ACGT
+// bases are complemented to themselves.
+inline std::string canonicalKmer(std::string_view kmer, bool& reversed) {
+    std::string forward(kmer.size(), 'N');
+    std::string rc(kmer.size(), 'N');
+    for (std::size_t j = 0; j < kmer.size(); j++) {
+        char base = kmer[j];
+        char complement = base;
+        switch (base) {
+        case 'A': case 'a': base = 'A'; complement = 'T'; break;
+        case 'C': case 'c': base = 'C'; complement = 'G'; break;
+        case 'G': case 'g': base = 'G'; complement = 'C'; break;
+        case 'T': case 't': base = 'T'; complement = 'A'; break;
+        default: break;
+        }
+        forward[j] = base;
+        rc[kmer.size() - 1 - j] = complement;
+    }
+    reversed = rc < forward;
+    return reversed ? rc : forward;
+}
+
+static_assert(sizeof(PackedKmer<31>) == 8);
+static_assert(sizeof(PackedKmer<37>) == 16);
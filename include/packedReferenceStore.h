@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "packedKmer.h"
+
+// 2-bit packed copy of the reference sequence an index stores positions
+// into, so a decoded position can be checked by fetching the k bases there
+// and comparing them with the query. Bases are kept 32 to a word, first base
+// in the most significant bits (the PackedKmer layout), so a k-mer of up to
+// 32 bases is compared as one shifted word against the query's PackedKmer
+// bits. Non-ACGT bases are stored as A and remembered as runs; a window
+// overlapping one never matches. Memory is 2 bits per base plus the runs.
+class PackedReferenceStore {
+public:
+    PackedReferenceStore() = default;
+    explicit PackedReferenceStore(std::string_view sequence) { append(sequence); }
+
+    // Every record of a FASTA file, concatenated, so positions are the
+    // coordinates FastaReader gives its k-mers.
+    static PackedReferenceStore fromFasta(const std::string& path);
+
+    void append(std::string_view sequence);
+
+    uint64_t size() const { return length; }
+    // [position, position + k) lies inside the sequence and holds only ACGT.
+    bool isValid(uint64_t position, std::size_t k) const;
+    // Bases [position, position + count), count <= 32, packed as
+    // PackedKmer<count>::bits. The range must lie inside the sequence.
+    uint64_t extract(uint64_t position, unsigned count) const;
+    std::string toString(uint64_t position, std::size_t count) const;
+
+    // The reference holds kmer (its reverse complement if reverse) at
+    // position. False for positions out of range, NOT_FOUND included.
+    bool matches(uint64_t position, std::string_view kmer, bool reverse = false) const;
+    template <unsigned K>
+    bool matches(uint64_t position, const PackedKmer<K>& kmer, bool reverse = false) const;
+
+    std::size_t getMemoryBits() const;
+
+private:
+    static constexpr unsigned BASES_PER_WORD = 32;
+
+    // Full words plus the partly filled one holding the last bases (an
+    // empty word when the length is a multiple of 32).
+    std::vector<uint64_t> words{ 0 };
+    uint64_t length = 0;
+    // Sorted, disjoint [begin, end) runs of non-ACGT bases.
+    std::vector<std::pair<uint64_t, uint64_t>> gaps;
+
+    void appendCode(uint8_t code);
+    void appendGap(uint64_t count);
+};
+
+template <unsigned K>
+bool PackedReferenceStore::matches(uint64_t position, const PackedKmer<K>& kmer, bool reverse) const {
+    if (!isValid(position, K)) return false;
+    auto bits = reverse ? kmer.reverseComplement().bits : kmer.bits;
+    if constexpr (K <= BASES_PER_WORD) {
+        return extract(position, K) == bits;
+    }
+    else {
+        constexpr unsigned LOW = K - BASES_PER_WORD;
+        constexpr uint64_t LOW_MASK = LOW == BASES_PER_WORD ? ~uint64_t{ 0 } : (uint64_t{ 1 } << (2 * LOW)) - 1;
+        return extract(position, BASES_PER_WORD) == static_cast<uint64_t>(bits >> (2 * LOW))
+            && extract(position + BASES_PER_WORD, LOW) == (static_cast<uint64_t>(bits) & LOW_MASK);
+    }
+}
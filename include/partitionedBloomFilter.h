@@ -1,25 +1,64 @@
 #pragma once
+#include <bit>
 #include <iostream>
+#include <vector>
 #include "bloomfilter.h"
 
 class PartitionedBloomFilter : public BloomFilter {
 protected:
     std::size_t partitionSize;
+    // First slot and slot count of every partition, so reduceIndex needs no
+    // branch for the last, larger partition.
+    std::vector<uint64_t> partitionStarts;
+    std::vector<uint64_t> partitionRanges;
+
+    void computePartitionBounds() {
+        partitionStarts.resize(numHashCount);
+        partitionRanges.resize(numHashCount);
+        for (int i = 0; i < numHashCount; i++) {
+            std::size_t start = static_cast<std::size_t>(i) * partitionSize;
+            std::size_t end = (i == numHashCount - 1)
+                ? getSize()
+                : (start + partitionSize);
+            partitionStarts[i] = start;
+            partitionRanges[i] = end - start;
+        }
+    }
 
 public:
     PartitionedBloomFilter(std::size_t elementsToEncode,
         double falsePositiveRate,
         int positionBits = 1,
-        int numPartitions = 0)
-        : BloomFilter(elementsToEncode, falsePositiveRate, positionBits),
+        int numPartitions = 0,
+        BloomFilterOptions options = {})
+        : BloomFilter(elementsToEncode, falsePositiveRate, positionBits, withModuloReduction(options)),
         partitionSize(0)
     {
-        if (numPartitions > 0) {
+        // partitions, not the whole array, are rounded for PowerOfTwo
+        rangeReduction = options.rangeReduction;
+        if (numPartitions > 0 && numPartitions != numHashCount) {
             numHashCount = numPartitions;
+            // chunk count depends on the number of hash functions
+            allocateSlots();
         }
         computePartitions();
     }
 
+    // Restores a serialized filter; see FilterSerializer.
+    explicit PartitionedBloomFilter(const FilterParameters& params)
+        : BloomFilter(params),
+        partitionSize(params.partitionSize)
+    {
+        computePartitionBounds();
+    }
+
+    FilterParameters getParameters() const override {
+        FilterParameters params = BloomFilter::getParameters();
+        params.kind = FilterKind::Partitioned;
+        params.partitionSize = partitionSize;
+        return params;
+    }
+
     virtual void computePartitions() {
         if (numHashCount == 0) {
             throw std::invalid_argument("[PartitionedBF] Number of hash functions cannot be zero");
@@ -28,39 +67,35 @@ public:
             throw std::invalid_argument("[PartitionedBF] Not enough bits for the requested partitions.");
         }
 
-        partitionSize = getSize() / numHashCount;
+        if (rangeReduction == RangeReduction::PowerOfTwo) {
+            // equal power-of-two partitions, so every probe is masked
+            std::size_t wanted = (getSize() + numHashCount - 1) / numHashCount;
+            partitionSize = std::bit_ceil(wanted);
+            if (partitionSize * numHashCount != bitArraySize) {
+                bitArraySize = partitionSize * numHashCount;
+                allocateSlots();
+            }
+        }
+        else {
+            partitionSize = getSize() / numHashCount;
+        }
         if (partitionSize == 0) {
             throw std::invalid_argument("[PartitionedBF] Partition size ended up zero. "
                 "Increase total size or reduce number of partitions.");
         }
+        computePartitionBounds();
     }
 
     uint64_t generateHash(const std::string& item, int i, int seed = 0) const override {
         if (i < 0 || i >= numHashCount) {
             throw std::out_of_range("[PartitionedBF] Hash function index out of range");
         }
+        return reduceIndex(probeHash(item, i, seed), i);
+    }
 
-        uint8_t hash128[16];
-        uint32_t modifiedSeed = seed + i;
-        MurmurHash3_x64_128(item.c_str(), static_cast<int>(item.size()), modifiedSeed, hash128);
-        uint64_t hashValue = combine128to64(hash128);
-
-        std::size_t start = static_cast<std::size_t>(i) * partitionSize;
-        std::size_t end = (i == numHashCount - 1)
-            ? getSize()
-            : (start + partitionSize);
-
-        if (start >= end) {
-            std::cerr << "[PartitionedBloomFilter] start >= end; invalid partition!\n";
-            return 0;
-        }
-
-        std::size_t range = end - start;
-        std::size_t offset = hashValue % range;
-
-        uint64_t partitionedIndex = start + offset;
-        //std::cout << "Partitioned index: " << partitionedIndex << std::endl;
-        return partitionedIndex;
+    // Probe i always lands in partition i, whichever hash scheme produced it.
+    uint64_t reduceIndex(uint64_t hashValue, int i) const override {
+        return partitionStarts[i] + reduceRange(hashValue, partitionRanges[i]);
     }
 
     struct PartitionStats {
@@ -74,15 +109,10 @@ public:
         stats.reserve(numHashCount);
 
         for (int i = 0; i < numHashCount; i++) {
-            std::size_t start = static_cast<std::size_t>(i) * partitionSize;
-            std::size_t end = (i == numHashCount - 1)
-                ? getSize()
-                : (start + partitionSize);
+            std::size_t start = partitionStarts[i];
+            std::size_t end = start + partitionRanges[i];
 
-            std::size_t setBits = 0;
-            for (std::size_t j = start; j < end; j++) {
-                if (presenceBitset[j]) setBits++;
-            }
+            std::size_t setBits = countPresence(start, end);
 
             stats.push_back({
                 static_cast<std::size_t>(i),
@@ -98,11 +128,7 @@ public:
         sizes.reserve(numHashCount);
 
         for (int i = 0; i < numHashCount; i++) {
-            std::size_t start = static_cast<std::size_t>(i) * partitionSize;
-            std::size_t end = (i == numHashCount - 1)
-                ? getSize()
-                : (start + partitionSize);
-            sizes.push_back(end - start);
+            sizes.push_back(partitionRanges[i]);
         }
         return sizes;
     }
@@ -111,4 +137,17 @@ public:
     int getPartitionIndex(std::size_t bitIndex) const {
         return static_cast<int>(bitIndex / partitionSize);
     }
+
+    // Adds the exact fill of every partition, which scans the filter; in
+    // stats builds filledByProbe tracks the same counts as items go in.
+    void dumpStats(std::ostream& out) const override {
+        out << '{';
+        writeStatsFields(out);
+        out << ",\"partitions\":[";
+        for (const auto& partition : getPartitionStats()) {
+            out << (partition.index ? "," : "") << "{\"index\":" << partition.index
+                << ",\"size\":" << partition.size << ",\"fillRatio\":" << partition.fillRatio << '}';
+        }
+        out << "]}";
+    }
 };
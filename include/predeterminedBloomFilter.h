@@ -21,8 +21,9 @@ public:
     PredeterminedHashBloomFilter(std::size_t elementsToEncode,
         double falsePositiveRate,
         int numHash,
-        int positionBits = 1)
-        : PartitionedBloomFilter(elementsToEncode, falsePositiveRate, positionBits),
+        int positionBits = 1,
+        BloomFilterOptions options = {})
+        : PartitionedBloomFilter(elementsToEncode, falsePositiveRate, positionBits, 0, options),
         predefinedHashCount(numHash)
     {
         if (numHash <= 0) {
@@ -34,19 +35,25 @@ public:
             throw std::invalid_argument("Calculated bit array size cannot be zero");
         }
 
-        presenceBitset.resize(bitArraySize, false);
-
         numHashCount = numHash;
-
-        chunkCount = (positionBits + numHashCount - 1) / numHashCount;
-        positionBitsets.resize(chunkCount);
-        for (size_t b = 0; b < chunkCount; b++) {
-            positionBitsets[b].resize(bitArraySize, false);
-        }
+        allocateSlots();
 
         computePartitions();
     }
 
+    // Restores a serialized filter; see FilterSerializer.
+    explicit PredeterminedHashBloomFilter(const FilterParameters& params)
+        : PartitionedBloomFilter(params),
+        predefinedHashCount(static_cast<int>(params.numHashCount))
+    {
+    }
+
+    FilterParameters getParameters() const override {
+        FilterParameters params = PartitionedBloomFilter::getParameters();
+        params.kind = FilterKind::Predetermined;
+        return params;
+    }
+
     uint64_t generateHash(const std::string& item, int i, int seed = 0) const override {
         return PartitionedBloomFilter::generateHash(item, i, seed);
     }
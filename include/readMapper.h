@@ -0,0 +1,127 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "bloomfilter.h"
+#include "bloomFilterCascade.h"
+#include "fastqReader.h"
+#include "kmerSampler.h"
+#include "shardedCascade.h"
+#include "workStealingPool.h"
+
+struct MapperConfig {
+    // Length of the k-mers the index was built from.
+    unsigned k = 31;
+    // Look up every kmerStride-th k-mer of a read; the last one is always
+    // included. Only used when sampling is All.
+    unsigned kmerStride = 1;
+    // Look up only the k-mers this scheme samples from the read; must match
+    // the sampling the index was built with.
+    SamplingConfig sampling;
+    // Reads whose best placement has fewer votes stay unmapped.
+    unsigned minVotes = 2;
+    // Also look up the reverse complement of each read. Canonical cascades
+    // report the strand of every hit, so they never need the second pass.
+    bool bothStrands = true;
+    // Worker threads (0 = hardware concurrency).
+    unsigned numThreads = 0;
+    // Reads per task; a task's k-mers are looked up as one batch.
+    std::size_t readsPerTask = 64;
+    // Reference the index positions point into. When set, every hit is
+    // checked against it and hits where it does not hold the k-mer are
+    // dropped before voting. Must outlive the mapper.
+    const PackedReferenceStore* reference = nullptr;
+    // Records parsed per round when streaming a FASTQ file.
+    std::size_t readsPerChunk = 1 << 16;
+};
+
+struct ReadPlacement {
+    static constexpr uint64_t UNMAPPED = static_cast<uint64_t>(-1);
+
+    // Reference coordinate of the read's first base on the placed strand,
+    // i.e. the winning (position - offset) diagonal; UNMAPPED if none.
+    uint64_t position = UNMAPPED;
+    // The read matches the reverse complement of the reference there.
+    bool reverse = false;
+    // K-mers agreeing on the placement, and k-mers looked up per strand.
+    uint32_t votes = 0;
+    uint32_t kmers = 0;
+    // (votes - runner-up votes) / kmers: 1 when every k-mer agrees, near 0
+    // when another placement is about as well supported.
+    double confidence = 0.0;
+
+    bool mapped() const { return position != UNMAPPED; }
+};
+
+// Seed-and-vote read placement on top of a k-mer -> position index. Each
+// read's k-mers are looked up (batched per task, so the index prefetches
+// across reads) and every hit votes for the diagonal position - offset; the
+// diagonal with the most votes is the placement. Reads are mapped by a
+// work-stealing pool. Filter false positives scatter over random diagonals,
+// so they rarely outvote the true one.
+class ReadMapper {
+public:
+    using ReadCallback = std::function<void(const FastqRecord&, const ReadPlacement&)>;
+
+    // Any filter class, queried with the seed it was built with.
+    ReadMapper(const BloomFilter& filter, MapperConfig config = {}, int seed = 0);
+    ReadMapper(const BloomFilterCascade& cascade, MapperConfig config = {});
+    // A task's k-mers are grouped by shard before lookup; with minimizer
+    // routing a read's k-mers share a few shards.
+    ReadMapper(const ShardedCascade& index, MapperConfig config = {});
+
+    std::vector<ReadPlacement> mapReads(std::span<const std::string> reads);
+    // Streams a FASTQ file a chunk at a time and calls onRead for every
+    // record, in file order, from the calling thread. Returns the number of
+    // reads.
+    uint64_t mapFastq(const std::string& path, const ReadCallback& onRead);
+
+    const MapperConfig& getConfig() const { return config; }
+
+private:
+    // One probed k-mer: the read it came from, its offset, and whether it
+    // was taken from the read's reverse complement.
+    struct Probe {
+        uint32_t read;
+        uint32_t offset;
+        bool reverse;
+    };
+
+    // Per-worker buffers, reused from task to task.
+    struct Scratch {
+        std::vector<std::string> kmers;
+        std::vector<Probe> probes;
+        std::vector<uint64_t> positions;
+        std::vector<StrandedPosition> stranded;
+        std::vector<uint32_t> invalidBefore;
+        std::vector<uint64_t> diagonals;
+        std::string reverseRead;
+        // Unset when sampling is All.
+        std::optional<KmerSampler> sampler;
+    };
+
+    const BloomFilter* filter = nullptr;
+    int seed = 0;
+    const BloomFilterCascade* cascade = nullptr;
+    const ShardedCascade* sharded = nullptr;
+    MapperConfig config;
+    WorkStealingPool pool;
+    std::vector<Scratch> scratch;
+
+    // Validates the config and sets up the per-worker scratch.
+    void init();
+    // The index reports the strand of each hit itself.
+    bool canonicalIndex() const;
+    void mapAll(const std::string* const* reads, std::size_t count, ReadPlacement* out);
+    void mapTask(const std::string* const* reads, std::size_t count, ReadPlacement* out, Scratch& buffers) const;
+    // Appends the valid k-mers of sequence (read number read) to buffers.
+    void collectKmers(const std::string& sequence, uint32_t read, bool reverse, Scratch& buffers) const;
+    void appendKmer(const std::string& sequence, std::size_t offset, uint32_t read, bool reverse,
+        Scratch& buffers) const;
+    void lookup(Scratch& buffers) const;
+    ReadPlacement vote(Scratch& buffers, std::size_t begin, std::size_t end, std::size_t readLength) const;
+};
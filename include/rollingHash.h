@@ -0,0 +1,125 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include "intrinsics.h"
+
+// 2-bit base codes: A=0, C=1, G=2, T=3 (either case); anything else maps to
+// INVALID_BASE and breaks the current k-mer.
+inline constexpr uint8_t INVALID_BASE = 4;
+
+struct BaseCodeTable {
+    uint8_t codes[256];
+
+    constexpr BaseCodeTable() : codes() {
+        for (auto& code : codes) code = INVALID_BASE;
+        codes['A'] = codes['a'] = 0;
+        codes['C'] = codes['c'] = 1;
+        codes['G'] = codes['g'] = 2;
+        codes['T'] = codes['t'] = 3;
+    }
+};
+
+inline constexpr BaseCodeTable BASE_CODES{};
+
+inline uint8_t encodeBase(char base) {
+    return BASE_CODES.codes[static_cast<unsigned char>(base)];
+}
+
+// Rolling k-mer window for k <= 64: keeps the 2-bit packed bases of the last k
+// bases and their ntHash (Mohamadi et al. 2016), for both strands, updating
+// all of them in O(1) per base. The hash of a full window equals hashOf() on
+// the same k-mer string, so k-mers streamed from a FASTA file and k-mers
+// given as strings agree.
+class RollingKmerHasher {
+public:
+    static constexpr unsigned MAX_K = 64;
+
+    explicit RollingKmerHasher(unsigned k)
+        : k(k)
+    {
+        if (k == 0 || k > MAX_K) {
+            throw std::invalid_argument("[RollingHash] k must be in [1, 64]");
+        }
+        windowMask = (k == MAX_K) ? ~static_cast<uint128>(0)
+            : ((static_cast<uint128>(1) << (2 * k)) - 1);
+    }
+
+    // Shifts in one base code (0..3); true once the window holds k bases.
+    bool push(uint8_t code) {
+        uint8_t complement = 3 - code;
+        if (filled == k) {
+            uint8_t outgoing = static_cast<uint8_t>(window >> (2 * (k - 1))) & 3;
+            hash = std::rotl(hash, 1) ^ std::rotl(SEEDS[outgoing], k) ^ SEEDS[code];
+            reverseHash = std::rotr(reverseHash, 1) ^ std::rotr(SEEDS[3 - outgoing], 1)
+                ^ std::rotl(SEEDS[complement], k - 1);
+        }
+        else {
+            hash = std::rotl(hash, 1) ^ SEEDS[code];
+            reverseHash ^= std::rotl(SEEDS[complement], filled);
+            filled++;
+        }
+        window = ((window << 2) | code) & windowMask;
+        // the reverse complement gains the complement of each new base at its front
+        reverseWindow = (reverseWindow >> 2) | (static_cast<uint128>(complement) << (2 * (k - 1)));
+        return filled == k;
+    }
+
+    // Drops the window, e.g. after an N or at a record boundary.
+    void reset() {
+        filled = 0;
+        hash = 0;
+        reverseHash = 0;
+        window = 0;
+        reverseWindow = 0;
+    }
+
+    bool full() const { return filled == k; }
+    unsigned getK() const { return k; }
+    uint64_t getHash() const { return hash; }
+    // First base in the two most significant used bits.
+    uint128 getPacked() const { return window; }
+
+    // Hash and packed bases of the reverse complement of the window; the
+    // hash equals hashOf() on the reverse complement string.
+    uint64_t getReverseHash() const { return reverseHash; }
+    uint128 getReversePacked() const { return reverseWindow; }
+    // Canonical k-mer: the smaller of the window and its reverse complement
+    // as packed integers, matching PackedKmer::canonical.
+    bool isReverseCanonical() const { return reverseWindow < window; }
+    uint64_t getCanonicalHash() const { return isReverseCanonical() ? reverseHash : hash; }
+    uint128 getCanonicalPacked() const {
+        return isReverseCanonical() ? reverseWindow : window;
+    }
+
+    // ntHash of a k-mer given as a string; 0 if it holds a non-ACGT base.
+    static uint64_t hashOf(std::string_view kmer) {
+        uint64_t h = 0;
+        unsigned k = static_cast<unsigned>(kmer.size());
+        for (std::size_t j = 0; j < kmer.size(); j++) {
+            uint8_t code = encodeBase(kmer[j]);
+            if (code == INVALID_BASE) return 0;
+            h ^= std::rotl(SEEDS[code], static_cast<int>(k - 1 - j));
+        }
+        return h;
+    }
+
+private:
+    // ntHash per-base seeds for A, C, G, T.
+    static constexpr uint64_t SEEDS[4] = {
+        0x3c8bfbb395c60474ULL,
+        0x3193c18562a02b4cULL,
+        0x20323ed082572324ULL,
+        0x295549f54be24456ULL
+    };
+
+    unsigned k;
+    unsigned filled = 0;
+    uint64_t hash = 0;
+    uint64_t reverseHash = 0;
+    uint128 window = 0;
+    uint128 reverseWindow = 0;
+    uint128 windowMask;
+};
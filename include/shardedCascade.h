@@ -0,0 +1,173 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bloomFilterCascade.h"
+
+// How k-mers are assigned to buckets.
+struct ShardRoutingPolicy {
+    enum class Mode {
+        // Hash of the whole k-mer: buckets are even, but the k-mers of one
+        // read scatter over all of them.
+        Hash,
+        // Hash of the k-mer's minimizer, its smallest m-mer by hash.
+        // Overlapping k-mers mostly share their minimizer, so the k-mers of
+        // a read fall into a few shards and a batched lookup stays inside
+        // small, cache-resident filters.
+        Minimizer
+    };
+
+    Mode mode = Mode::Hash;
+    // Minimizer length m (1 <= m <= 32); k-mers shorter than m or holding a
+    // non-ACGT base are routed by Hash.
+    unsigned minimizerLength = 15;
+};
+
+struct ShardedBuildConfig {
+    CascadeConfig cascade;
+    ShardRoutingPolicy routing;
+    // Target size of one shard's filters. The default keeps a shard inside
+    // a typical L2 cache.
+    std::size_t shardBytes = std::size_t{ 1 } << 20;
+    // Buckets, one shard each (0 = enough for shards of about shardBytes).
+    std::size_t numBuckets = 0;
+    // Shards built at once (0 = hardware concurrency); each shard is built
+    // by one thread, so the result does not depend on the count.
+    unsigned numThreads = 0;
+};
+
+// A cascade index split by k-mer: every k-mer belongs to one of numBuckets
+// buckets (ShardRoutingPolicy), consecutive buckets form a shard, and each
+// shard is an independent BloomFilterCascade over its k-mers. A lookup
+// routes the k-mer (its canonical form in canonical mode) once and asks
+// only its shard.
+class ShardedCascade {
+public:
+    // In-memory build: buckets the k-mers, then builds the shards in
+    // parallel.
+    static ShardedCascade build(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions,
+        const ShardedBuildConfig& config);
+
+    uint64_t lookup(const std::string& kmer) const;
+    StrandedPosition lookupStranded(const std::string& kmer) const;
+    // Groups the k-mers by shard and resolves each group with one batched
+    // shard lookup.
+    void lookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const;
+    void lookupStrandedBatch(std::span<const std::string> kmers, std::span<StrandedPosition> out) const;
+    bool mightContain(const std::string& kmer) const;
+
+    std::size_t numShards() const { return shards.size(); }
+    std::size_t numBuckets() const { return bucketShards.size(); }
+    const BloomFilterCascade& getShard(std::size_t shard) const { return shards.at(shard); }
+    std::size_t shardOf(std::string_view kmer) const;
+    const CascadeConfig& getConfig() const { return config; }
+    const ShardRoutingPolicy& getRouting() const { return routing; }
+    std::size_t numKmers() const { return kmerCount; }
+    std::size_t getMemoryBits() const;
+    double getBitsPerKmer() const;
+    // JSON object with the totals and every shard's cascade dumpStats.
+    void dumpStats(std::ostream& out) const;
+
+    // Bucket of a k-mer among numBuckets; independent of every filter and
+    // router hash, so sharding does not skew probes inside a shard. In
+    // canonical mode both strands of a k-mer share a bucket.
+    static std::size_t bucketOf(std::string_view kmer, bool canonical, std::size_t numBuckets,
+        const ShardRoutingPolicy& routing = {});
+    // Estimated bytes of the filters of a cascade over count k-mers.
+    static std::size_t estimateFilterBytes(const CascadeConfig& config, std::size_t count);
+
+    static constexpr uint64_t NOT_FOUND = BloomFilterCascade::NOT_FOUND;
+
+private:
+    friend class FilterSerializer;
+
+    ShardedCascade(CascadeConfig config, ShardRoutingPolicy routing) : config(config), routing(routing) {}
+
+    CascadeConfig config;
+    ShardRoutingPolicy routing;
+    // bucket -> shard; shards cover consecutive bucket ranges
+    std::vector<uint32_t> bucketShards;
+    std::vector<BloomFilterCascade> shards;
+    std::size_t kmerCount = 0;
+
+    // Groups the k-mers by shard (counting sort) and resolves each group
+    // with lookup(shard, kmers, out).
+    template <typename Out, typename Lookup>
+    void lookupByShard(std::span<const std::string> kmers, std::span<Out> out, Lookup&& lookup) const;
+};
+
+struct ExternalBuildConfig {
+    CascadeConfig cascade;
+    ShardRoutingPolicy routing;
+    // Hash buckets the input is spilled into. Shards are whole runs of
+    // buckets, so more buckets let shards track the memory budget closely.
+    std::size_t numBuckets = 256;
+    // Directory for the bucket files; they are removed as shards are built.
+    std::string tmpDir = pthash::constants::default_tmp_dirname;
+    // Budget for building one shard: its k-mers, positions and filters, as
+    // estimated from the bucket sizes. Spill buffers take an eighth of it.
+    uint64_t ramBytes = uint64_t{ 1 } << 30;
+};
+
+// Builds a ShardedCascade from input that does not fit in memory. K-mers
+// are streamed in once and appended to on-disk bucket files; finish() then
+// groups consecutive buckets into shards that fit ramBytes, builds each
+// shard's cascade from its buckets alone, and appends it to the output file
+// before starting the next, so only one shard is ever in memory.
+class ExternalCascadeBuilder {
+public:
+    struct ShardStats {
+        std::size_t shard;
+        std::size_t firstBucket;
+        std::size_t numBuckets;
+        std::size_t numKmers;
+        // The build estimate the grouping used, and what the shard holds.
+        std::size_t estimatedBytes;
+        std::size_t numRounds;
+        std::size_t memoryBits;
+    };
+
+    ExternalCascadeBuilder(ExternalBuildConfig config, std::string outputPath);
+    // Removes any bucket files left behind.
+    ~ExternalCascadeBuilder();
+    ExternalCascadeBuilder(const ExternalCascadeBuilder&) = delete;
+    ExternalCascadeBuilder& operator=(const ExternalCascadeBuilder&) = delete;
+
+    void add(std::string_view kmer, uint64_t position);
+    // Streams a file with one k-mer per line; empty lines are skipped and
+    // every other line gets the next position, counting from nextPosition.
+    // Returns the position after the last k-mer read.
+    uint64_t addLines(const std::string& path, uint64_t nextPosition = 0);
+
+    // Builds every shard and writes the index to the output path. Throws
+    // if a single bucket is estimated to exceed ramBytes.
+    void finish();
+
+    std::size_t numKmers() const { return kmerCount; }
+    const std::vector<ShardStats>& getShardStats() const { return stats; }
+
+    // Estimated peak bytes of building a cascade over count k-mers holding
+    // keyBytes bytes of k-mer text in total.
+    static std::size_t estimateBuildBytes(const CascadeConfig& config, std::size_t count, std::size_t keyBytes);
+
+private:
+    ExternalBuildConfig config;
+    std::string outputPath;
+    std::string spillPrefix;
+    std::vector<std::string> buffers;
+    std::vector<std::size_t> bucketCounts;
+    std::vector<std::size_t> bucketKeyBytes;
+    std::size_t bufferLimit;
+    std::size_t kmerCount = 0;
+    bool finished = false;
+    std::vector<ShardStats> stats;
+
+    std::string bucketPath(std::size_t bucket) const;
+    void flush(std::size_t bucket);
+    void readBucket(std::size_t bucket, std::vector<std::string>& kmers, std::vector<uint64_t>& positions) const;
+    void removeSpillFiles() const;
+};
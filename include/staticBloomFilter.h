@@ -0,0 +1,357 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include "bloomfilter.h"
+#include "blockedBloomFilter.h"
+#include "packedBitset.h"
+#include "packedKmer.h"
+
+// ------------------ Layout Policies ------------------ //
+// Probes spread over the whole slot array, like BloomFilter.
+struct PlainLayout {
+    static constexpr FilterKind KIND = FilterKind::Standard;
+};
+
+// Probe i lands in partition i, like PartitionedBloomFilter.
+struct PartitionedLayout {
+    static constexpr FilterKind KIND = FilterKind::Partitioned;
+};
+
+// Every probe of an item lands in one 512-bit block, like BlockedBloomFilter.
+struct BlockedLayout {
+    static constexpr FilterKind KIND = FilterKind::Blocked;
+};
+
+// Position-encoding Bloom filter whose layout, hash count and position width
+// are template parameters: probe indexes live in a stack array, the per-probe
+// and per-chunk loops have constant trip counts and unroll, and nothing is
+// virtual. Probes always use double hashing.
+//
+// For the same geometry it holds the same bits and gives the same answers as
+// the runtime filter of its layout: BloomFilter or PartitionedBloomFilter
+// with { DoubleHashing, Interleaved } options (and, for Plain, an optimal
+// hash count equal to NumHash), or BlockedBloomFilter.
+template <typename Layout, int NumHash, int PositionBits>
+class StaticBloomFilter {
+    static constexpr bool PLAIN = std::is_same_v<Layout, PlainLayout>;
+    static constexpr bool PARTITIONED = std::is_same_v<Layout, PartitionedLayout>;
+    static constexpr bool BLOCKED = std::is_same_v<Layout, BlockedLayout>;
+    static_assert(PLAIN || PARTITIONED || BLOCKED, "Unknown layout policy");
+    static_assert(NumHash >= 1 && NumHash <= 64, "NumHash must be in [1, 64]");
+    static_assert(PositionBits >= 1 && PositionBits <= 63, "PositionBits must be in [1, 63]");
+
+public:
+    using LayoutPolicy = Layout;
+    static constexpr int NUM_HASH = NumHash;
+    static constexpr int POSITION_BITS = PositionBits;
+    static constexpr std::size_t CHUNK_COUNT = (PositionBits + NumHash - 1) / NumHash;
+    // Bits per slot: presence at bit 0, chunk c at bit c + 1.
+    static constexpr std::size_t FIELD_WIDTH = CHUNK_COUNT + 1;
+    static constexpr std::size_t BLOCK_BITS = BlockedBloomFilter::BLOCK_BITS;
+    static constexpr std::size_t PLANE_WIDTH = BLOCK_BITS / FIELD_WIDTH;
+    static constexpr uint64_t NOT_FOUND = BloomFilter::NOT_FOUND;
+    static constexpr std::size_t BATCH_BLOCK = BloomFilter::BATCH_BLOCK;
+
+    static_assert(FIELD_WIDTH <= 57, "A slot field must fit one unaligned 64-bit load");
+    static_assert(!BLOCKED || PLANE_WIDTH >= static_cast<std::size_t>(NumHash),
+        "Block plane narrower than the number of hash functions");
+
+    StaticBloomFilter(std::size_t elementsToEncode, double falsePositiveRate,
+        RangeReduction reduction = RangeReduction::Modulo, bool rejectSelfCollisions = false)
+        : reduction(reduction),
+        rejectSelfCollisions(rejectSelfCollisions)
+    {
+        if (elementsToEncode == 0 || !(falsePositiveRate > 0.0 && falsePositiveRate < 1.0)) {
+            throw std::invalid_argument("[StaticBF] Need a positive element count and an FPR in (0, 1)");
+        }
+        std::size_t bits = BloomFilter::calculateBitArraySize(elementsToEncode, falsePositiveRate);
+        bool powerOfTwo = reduction == RangeReduction::PowerOfTwo;
+
+        if constexpr (PLAIN) {
+            numSlots = powerOfTwo ? std::bit_ceil(bits) : bits;
+        }
+        else if constexpr (PARTITIONED) {
+            if (bits < static_cast<std::size_t>(NumHash)) {
+                throw std::invalid_argument("[StaticBF] Not enough bits for the requested partitions");
+            }
+            std::size_t partitionSize = powerOfTwo
+                ? std::bit_ceil((bits + NumHash - 1) / NumHash)
+                : bits / NumHash;
+            numSlots = powerOfTwo ? partitionSize * NumHash : bits;
+            for (int i = 0; i < NumHash; i++) {
+                partitionStarts[i] = static_cast<uint64_t>(i) * partitionSize;
+                partitionRanges[i] = (i == NumHash - 1) ? numSlots - partitionStarts[i] : partitionSize;
+            }
+        }
+        else {
+            numBlocks = std::max<std::size_t>(1, (bits + PLANE_WIDTH - 1) / PLANE_WIDTH);
+            if (powerOfTwo) numBlocks = std::bit_ceil(numBlocks);
+            numSlots = numBlocks * BLOCK_BITS;
+        }
+
+        // interleaved fields carry a spare word for the unaligned window at the last slot
+        slots = BLOCKED
+            ? PackedBitset(numSlots)
+            : PackedBitset(numSlots * FIELD_WIDTH + PackedBitset::WORD_BITS);
+    }
+
+    bool add(const std::string& item, uint64_t position, int seed = 0) {
+        return insertAt(indexesFor(item, seed), position);
+    }
+
+    bool addHashed(uint64_t itemHash, uint64_t position, int seed = 0) {
+        return insertAt(indexesForHash(itemHash, seed), position);
+    }
+
+    bool mightContain(const std::string& item, int seed = 0) const {
+        return presentAt(indexesFor(item, seed));
+    }
+
+    bool mightContainHashed(uint64_t itemHash, int seed = 0) const {
+        return presentAt(indexesForHash(itemHash, seed));
+    }
+
+    uint64_t getPosition(const std::string& item, int seed = 0) const {
+        return decode(indexesFor(item, seed));
+    }
+
+    uint64_t getPositionHashed(uint64_t itemHash, int seed = 0) const {
+        return decode(indexesForHash(itemHash, seed));
+    }
+
+    template <unsigned K>
+    bool add(const PackedKmer<K>& kmer, uint64_t position, int seed = 0) {
+        return addHashed(kmer.hash(), position, seed);
+    }
+
+    template <unsigned K>
+    uint64_t getPosition(const PackedKmer<K>& kmer, int seed = 0) const {
+        return getPositionHashed(kmer.hash(), seed);
+    }
+
+    // Hashes and prefetches a block of items before decoding any of them,
+    // as BloomFilter::getPositionBatch does.
+    void getPositionBatch(std::span<const std::string> items, std::span<uint64_t> out, int seed = 0) const {
+        if (out.size() != items.size()) {
+            throw std::invalid_argument("[StaticBF] Batch output size must match the number of items");
+        }
+        Indexes block[BATCH_BLOCK];
+        for (std::size_t begin = 0; begin < items.size(); begin += BATCH_BLOCK) {
+            std::size_t count = std::min(BATCH_BLOCK, items.size() - begin);
+            for (std::size_t j = 0; j < count; j++) {
+                block[j] = indexesFor(items[begin + j], seed);
+                for (uint64_t slot : block[j]) prefetchSlot(slot);
+            }
+            for (std::size_t j = 0; j < count; j++) {
+                out[begin + j] = decode(block[j]);
+            }
+        }
+    }
+
+    std::size_t getSize() const { return numSlots; }
+    std::size_t getMemoryBits() const { return slots.size(); }
+    RangeReduction getRangeReduction() const { return reduction; }
+    const PackedBitset& getBitArray() const { return slots; }
+
+private:
+    using Indexes = std::array<uint64_t, NumHash>;
+
+    // Field bits probe i owns: presence plus its chunks that carry a position bit.
+    static constexpr std::array<uint64_t, NumHash> SLOT_MASKS = [] {
+        std::array<uint64_t, NumHash> masks{};
+        for (int i = 0; i < NumHash; i++) {
+            masks[i] = 1ULL;
+            for (std::size_t c = 0; c < CHUNK_COUNT; c++) {
+                if (c * NumHash + i < static_cast<std::size_t>(PositionBits)) masks[i] |= 1ULL << (c + 1);
+            }
+        }
+        return masks;
+    }();
+    static constexpr uint64_t FIELD_MASK = ~0ULL >> (64 - FIELD_WIDTH);
+
+    PackedBitset slots;
+    std::size_t numSlots = 0;
+    std::size_t numBlocks = 0;
+    std::array<uint64_t, NumHash> partitionStarts{};
+    std::array<uint64_t, NumHash> partitionRanges{};
+    RangeReduction reduction;
+    bool rejectSelfCollisions;
+
+    // ------------------ Hashing ------------------ //
+    Indexes indexesFor(const std::string& item, int seed) const {
+        uint64_t h1, h2;
+        BloomFilter::hashDigest(item, seed, h1, h2);
+        return indexesFromDigest(h1, h2);
+    }
+
+    Indexes indexesForHash(uint64_t itemHash, int seed) const {
+        uint64_t h1, h2;
+        BloomFilter::hashDigest(itemHash, seed, h1, h2);
+        return indexesFromDigest(h1, h2);
+    }
+
+    Indexes indexesFromDigest(uint64_t h1, uint64_t h2) const {
+        Indexes indexes;
+        if constexpr (BLOCKED) {
+            uint64_t blockStart = reduceToRange(h1, numBlocks, reduction) * BLOCK_BITS;
+            std::size_t offset = static_cast<std::size_t>((h2 >> 5) % PLANE_WIDTH);
+            std::size_t stride = BlockedBloomFilter::STRIDE_PRIMES[(h2 >> 1) & 15] % PLANE_WIDTH;
+            for (int i = 0; i < NumHash; i++) {
+                indexes[i] = blockStart + offset;
+                offset += stride;
+                if (offset >= PLANE_WIDTH) offset -= PLANE_WIDTH;
+            }
+        }
+        else {
+            for (int i = 0; i < NumHash; i++) {
+                uint64_t probe = h1 + static_cast<uint64_t>(i) * h2;
+                if constexpr (PARTITIONED) {
+                    indexes[i] = partitionStarts[i] + reduceToRange(probe, partitionRanges[i], reduction);
+                }
+                else {
+                    indexes[i] = reduceToRange(probe, numSlots, reduction);
+                }
+            }
+        }
+        return indexes;
+    }
+
+    // ------------------ Slot Storage ------------------ //
+    uint64_t readSlot(uint64_t slot) const {
+        if constexpr (BLOCKED) {
+            uint64_t field = slots.test(slot);
+            for (std::size_t c = 0; c < CHUNK_COUNT; c++) {
+                field |= static_cast<uint64_t>(slots.test(slot + (c + 1) * PLANE_WIDTH)) << (c + 1);
+            }
+            return field;
+        }
+        else {
+            uint64_t bit = slot * FIELD_WIDTH;
+            uint64_t window;
+            std::memcpy(&window, reinterpret_cast<const unsigned char*>(slots.data()) + (bit >> 3), sizeof(window));
+            return (window >> (bit & 7)) & FIELD_MASK;
+        }
+    }
+
+    void writeSlot(uint64_t slot, uint64_t field, uint64_t mask) {
+        if constexpr (BLOCKED) {
+            if (mask & 1ULL) slots.assign(slot, field & 1ULL);
+            for (std::size_t c = 0; c < CHUNK_COUNT; c++) {
+                if ((mask >> (c + 1)) & 1ULL) {
+                    slots.assign(slot + (c + 1) * PLANE_WIDTH, (field >> (c + 1)) & 1ULL);
+                }
+            }
+        }
+        else {
+            uint64_t bit = slot * FIELD_WIDTH;
+            unsigned char* byte = reinterpret_cast<unsigned char*>(slots.data()) + (bit >> 3);
+            uint64_t window;
+            std::memcpy(&window, byte, sizeof(window));
+            uint64_t shift = bit & 7;
+            window = (window & ~(mask << shift)) | ((field & mask) << shift);
+            std::memcpy(byte, &window, sizeof(window));
+        }
+    }
+
+    void prefetchSlot(uint64_t slot) const {
+        slots.prefetch(BLOCKED ? slot : slot * FIELD_WIDTH);
+    }
+
+    // Probe i stores position bits i, i + NumHash, i + 2 * NumHash, ...
+    static uint64_t fieldFor(uint64_t position, int i) {
+        uint64_t field = 1ULL;
+        for (std::size_t c = 0; c < CHUNK_COUNT; c++) {
+            std::size_t bitIndex = c * NumHash + i;
+            if (bitIndex >= static_cast<std::size_t>(PositionBits)) break;
+            field |= ((position >> bitIndex) & 1ULL) << (c + 1);
+        }
+        return field;
+    }
+
+    // ------------------ Operations ------------------ //
+    bool insertAt(const Indexes& indexes, uint64_t position) {
+        if (position >= (1ULL << PositionBits)) {
+            return false;
+        }
+        uint64_t fields[NumHash];
+        for (int i = 0; i < NumHash; i++) {
+            fields[i] = fieldFor(position, i);
+            uint64_t existing = readSlot(indexes[i]);
+            if ((existing & 1ULL) && ((existing ^ fields[i]) & SLOT_MASKS[i])) {
+                return false;
+            }
+        }
+        if (rejectSelfCollisions) {
+            for (int i = 0; i < NumHash; i++) {
+                for (int j = i + 1; j < NumHash; j++) {
+                    if (indexes[i] == indexes[j] && ((fields[i] ^ fields[j]) & SLOT_MASKS[i] & SLOT_MASKS[j])) {
+                        return false;
+                    }
+                }
+            }
+        }
+        // probe order, so the later probe wins an intra-element collision
+        for (int i = 0; i < NumHash; i++) {
+            writeSlot(indexes[i], fields[i], SLOT_MASKS[i]);
+        }
+        return true;
+    }
+
+    bool presentAt(const Indexes& indexes) const {
+        for (uint64_t slot : indexes) {
+            bool present = BLOCKED ? slots.test(slot) : slots.test(slot * FIELD_WIDTH);
+            if (!present) return false;
+        }
+        return true;
+    }
+
+    uint64_t decode(const Indexes& indexes) const {
+        uint64_t position = 0;
+        for (int i = 0; i < NumHash; i++) {
+            uint64_t field = readSlot(indexes[i]);
+            if (!(field & 1ULL)) {
+                return NOT_FOUND;
+            }
+            for (std::size_t c = 0; c < CHUNK_COUNT; c++) {
+                std::size_t bitIndex = c * NumHash + i;
+                if (bitIndex >= static_cast<std::size_t>(PositionBits)) break;
+                position |= ((field >> (c + 1)) & 1ULL) << bitIndex;
+            }
+        }
+        return position;
+    }
+};
+
+// ------------------ Runtime Selection ------------------ //
+// The instantiations makeStaticFilter can return: every layout with 7 or 10
+// hashes (about 1% and 0.1% FPR) and 16, 24 or 32 position bits. Callers
+// std::visit the variant once per batch or per phase, not per k-mer.
+using AnyStaticFilter = std::variant<
+    StaticBloomFilter<PlainLayout, 7, 16>, StaticBloomFilter<PlainLayout, 7, 24>,
+    StaticBloomFilter<PlainLayout, 7, 32>, StaticBloomFilter<PlainLayout, 10, 16>,
+    StaticBloomFilter<PlainLayout, 10, 24>, StaticBloomFilter<PlainLayout, 10, 32>,
+    StaticBloomFilter<PartitionedLayout, 7, 16>, StaticBloomFilter<PartitionedLayout, 7, 24>,
+    StaticBloomFilter<PartitionedLayout, 7, 32>, StaticBloomFilter<PartitionedLayout, 10, 16>,
+    StaticBloomFilter<PartitionedLayout, 10, 24>, StaticBloomFilter<PartitionedLayout, 10, 32>,
+    StaticBloomFilter<BlockedLayout, 7, 16>, StaticBloomFilter<BlockedLayout, 7, 24>,
+    StaticBloomFilter<BlockedLayout, 7, 32>, StaticBloomFilter<BlockedLayout, 10, 16>,
+    StaticBloomFilter<BlockedLayout, 10, 24>, StaticBloomFilter<BlockedLayout, 10, 32>>;
+
+// Whether makeStaticFilter has an instantiation for this configuration
+// (kind Standard, Partitioned or Blocked).
+bool hasStaticFilter(FilterKind kind, int numHash, int positionBits);
+
+// Builds the matching AnyStaticFilter alternative; throws
+// std::invalid_argument if there is none.
+AnyStaticFilter makeStaticFilter(FilterKind kind, int numHash, int positionBits,
+    std::size_t elementsToEncode, double falsePositiveRate,
+    RangeReduction reduction = RangeReduction::Modulo, bool rejectSelfCollisions = false);
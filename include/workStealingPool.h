@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running one indexed job at a time. run(numTasks, fn)
+// deals the task indexes out as one contiguous range per worker; a worker
+// takes tasks from the front of its own range and, once that is empty,
+// steals the back half of the largest range left, so uneven tasks (long
+// reads, repetitive regions) do not leave threads idle at the end of a job.
+// The calling thread works as worker 0 for the duration of run().
+class WorkStealingPool {
+public:
+    // 0 = hardware concurrency.
+    explicit WorkStealingPool(unsigned numThreads = 0);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(ranges.size()); }
+
+    // Calls fn(task, worker) once for every task in [0, numTasks), with
+    // worker in [0, size()), and returns when all have finished. The first
+    // exception a task throws is rethrown here after the job has drained.
+    void run(std::size_t numTasks, const std::function<void(std::size_t, unsigned)>& fn);
+
+private:
+    // Remaining tasks [begin, end) of one worker.
+    struct alignas(64) Range {
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    std::vector<std::unique_ptr<Range>> ranges;
+    std::vector<std::thread> threads;
+
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    const std::function<void(std::size_t, unsigned)>* job = nullptr;
+    std::size_t generation = 0;
+    unsigned busyWorkers = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    void workerLoop(unsigned worker);
+    // Runs tasks for worker until no range has any left.
+    void drain(unsigned worker);
+    bool steal(unsigned worker, std::size_t& task);
+};
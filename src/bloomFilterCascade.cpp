@@ -0,0 +1,473 @@
+#include "bloomFilterCascade.h"
+#include "partitionedBloomFilter.h"
+#include "predeterminedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+// Indexes of the first occurrence of every distinct key, in input order.
+std::vector<std::size_t> firstOccurrences(const std::vector<std::string>& keys) {
+    std::vector<std::size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), std::size_t{ 0 });
+    // stable, so the earliest copy of a key leads its run
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return keys[a] < keys[b];
+        });
+    order.erase(std::unique(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return keys[a] == keys[b];
+        }), order.end());
+    std::sort(order.begin(), order.end());
+    return order;
+}
+}
+
+BloomFilterCascade::BloomFilterCascade(CascadeConfig config)
+    : config(config)
+{
+    if (config.positionBits <= 0 || config.positionBits >= (config.canonical ? 63 : 64)) {
+        throw std::invalid_argument("[Cascade] positionBits must be in [1, 63], or [1, 62] when canonical");
+    }
+    int storedBits = config.positionBits + (config.canonical ? 1 : 0);
+    if (config.options.checkBits < 0 || storedBits + config.options.checkBits > 64) {
+        throw std::invalid_argument("[Cascade] checkBits must be non-negative and fit next to the position bits");
+    }
+    if (config.maxRounds == 0) {
+        throw std::invalid_argument("[Cascade] maxRounds must be positive");
+    }
+    if (!(config.sizing.loadFactor > 0.0)) {
+        throw std::invalid_argument("[Cascade] Sizing load factor must be positive");
+    }
+    if (config.routed && (config.routerFingerprintBits < 0 || config.routerFingerprintBits > 32)) {
+        throw std::invalid_argument("[Cascade] routerFingerprintBits must be in [0, 32]");
+    }
+}
+
+std::unique_ptr<BloomFilter> BloomFilterCascade::makeFilter(const CascadeConfig& cascadeConfig,
+    std::size_t elementsToEncode) {
+    // every accepted k-mer has to decode, so self-colliding ones move on
+    CascadeConfig config = cascadeConfig;
+    config.options.rejectSelfCollisions = true;
+    if (config.canonical) {
+        // room for the strand bit
+        config.positionBits += 1;
+    }
+
+    switch (config.kind) {
+    case FilterKind::Standard:
+        return std::make_unique<BloomFilter>(elementsToEncode, config.falsePositiveRate,
+            config.positionBits, config.options);
+    case FilterKind::Partitioned:
+        return std::make_unique<PartitionedBloomFilter>(elementsToEncode, config.falsePositiveRate,
+            config.positionBits, config.numHash, config.options);
+    case FilterKind::Predetermined:
+        return std::make_unique<PredeterminedHashBloomFilter>(elementsToEncode, config.falsePositiveRate,
+            config.numHash, config.positionBits, config.options);
+    case FilterKind::Blocked:
+        return std::make_unique<BlockedBloomFilter>(elementsToEncode, config.falsePositiveRate,
+            config.positionBits, config.options);
+    }
+    throw std::invalid_argument("[Cascade] Unknown filter kind");
+}
+
+// Rounds use distinct seeds so a k-mer that cannot settle in one round (for
+// example because two of its own probes collide) gets fresh probes in the next.
+int BloomFilterCascade::getRoundSeed(std::size_t round) const {
+    return static_cast<int>(static_cast<uint32_t>(config.seed) + static_cast<uint32_t>(round) * ROUND_SEED_STRIDE);
+}
+
+// ------------------ Sizing ------------------ //
+CascadeConfig BloomFilterCascade::roundConfig(std::size_t round) const {
+    CascadeConfig roundConfig = config;
+    if (round > 0 && config.sizing.laterRoundNumHash > 0) {
+        roundConfig.numHash = config.sizing.laterRoundNumHash;
+    }
+    return roundConfig;
+}
+
+std::size_t BloomFilterCascade::roundCapacity(std::size_t totalKmers, std::size_t remaining) const {
+    if (config.sizing.mode == CascadeSizingPolicy::Mode::Fixed) {
+        return totalKmers;
+    }
+    auto capacity = static_cast<std::size_t>(std::ceil(remaining / config.sizing.loadFactor));
+    return std::max(capacity, config.sizing.minElements);
+}
+
+// ------------------ Construction ------------------ //
+void BloomFilterCascade::build(const std::vector<std::string>& kmers) {
+    std::vector<uint64_t> positions(kmers.size());
+    std::iota(positions.begin(), positions.end(), 0ULL);
+    build(kmers, positions);
+}
+
+void BloomFilterCascade::build(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions) {
+    if (kmers.size() != positions.size()) {
+        throw std::invalid_argument("[Cascade] Every k-mer needs exactly one position");
+    }
+    uint64_t positionLimit = 1ULL << config.positionBits;
+    for (uint64_t position : positions) {
+        if (position >= positionLimit) {
+            throw std::invalid_argument("[Cascade] Position does not fit in positionBits");
+        }
+    }
+
+    std::vector<std::string> keys;
+    std::vector<uint64_t> values;
+    if (config.canonical) {
+        keys.reserve(kmers.size());
+        values.reserve(kmers.size());
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            bool reversed;
+            keys.push_back(canonicalKmer(kmers[i], reversed));
+            values.push_back((positions[i] << 1) | static_cast<uint64_t>(reversed));
+        }
+    }
+    const std::vector<std::string>& allKeys = config.canonical ? keys : kmers;
+    const std::vector<uint64_t>& allValues = config.canonical ? values : positions;
+
+    // Every stored copy of a key would conflict with the one before it and
+    // push it into a round of its own, so only the first copy is built.
+    std::vector<std::size_t> first = firstOccurrences(allKeys);
+    if (first.size() == allKeys.size()) {
+        buildRounds(allKeys, allValues);
+        return;
+    }
+    std::vector<std::string> distinctKeys;
+    std::vector<uint64_t> distinctValues;
+    distinctKeys.reserve(first.size());
+    distinctValues.reserve(first.size());
+    for (std::size_t index : first) {
+        distinctKeys.push_back(allKeys[index]);
+        distinctValues.push_back(allValues[index]);
+    }
+    buildRounds(distinctKeys, distinctValues);
+}
+
+void BloomFilterCascade::buildRounds(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions) {
+    rounds.clear();
+    stats.clear();
+    router.reset();
+    numKmers = kmers.size();
+    std::vector<uint64_t> keyRounds(config.routed ? kmers.size() : 0);
+
+    // indexes into kmers still waiting for a round that accepts them
+    std::vector<std::size_t> pending(kmers.size());
+    std::iota(pending.begin(), pending.end(), std::size_t{ 0 });
+    std::vector<std::size_t> rejected;
+
+    while (!pending.empty()) {
+        if (rounds.size() == config.maxRounds) {
+            throw std::runtime_error("[Cascade] Exceeded maxRounds with "
+                + std::to_string(pending.size()) + " k-mers left");
+        }
+
+        std::size_t sizedFor = roundCapacity(kmers.size(), pending.size());
+        std::unique_ptr<BloomFilter> filter = makeFilter(roundConfig(rounds.size()), sizedFor);
+        int seed = getRoundSeed(rounds.size());
+        rejected.clear();
+        std::vector<uint8_t> accepted(pending.size());
+        filter->addParallel(kmers, positions, pending, accepted, seed, config.numThreads);
+        for (std::size_t j = 0; j < pending.size(); j++) {
+            if (!accepted[j]) rejected.push_back(pending[j]);
+            else if (config.routed) keyRounds[pending[j]] = rounds.size();
+        }
+
+        std::size_t inserted = pending.size() - rejected.size();
+        if (inserted == 0) {
+            throw std::runtime_error("[Cascade] Round " + std::to_string(rounds.size())
+                + " accepted no k-mers");
+        }
+
+        // a claim whose check bits fail sends the lookup on to the next round
+        std::size_t shadowed = 0;
+        for (std::size_t index : rejected) {
+            if (filter->getPosition(kmers[index], seed) < BloomFilter::AMBIGUOUS) shadowed++;
+        }
+
+        stats.push_back({
+            rounds.size(),
+            pending.size(),
+            inserted,
+            shadowed,
+            sizedFor,
+            filter->numHashCount,
+            filter->getSize(),
+            filter->getMemoryBits(),
+            static_cast<double>(inserted) / pending.size()
+            });
+        rounds.push_back(std::move(filter));
+        pending.swap(rejected);
+    }
+
+    if (config.routed && !kmers.empty()) {
+        buildRouter(kmers, keyRounds);
+    }
+}
+
+// build() hands over distinct keys, which is what the function needs.
+void BloomFilterCascade::buildRouter(const std::vector<std::string>& keys, const std::vector<uint64_t>& keyRounds) {
+    MphConfig routerConfig;
+    routerConfig.fingerprintBits = config.routerFingerprintBits;
+    routerConfig.seed = static_cast<uint32_t>(config.seed);
+    // pthash refuses more search threads than the machine has cores
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    routerConfig.numThreads = config.numThreads > 0 ? std::min(config.numThreads, cores) : cores;
+    router = std::make_unique<MphPositionIndex>(routerConfig);
+    router->build(keys, keyRounds);
+}
+
+// ------------------ Queries ------------------ //
+uint64_t BloomFilterCascade::lookupValue(const std::string& key) const {
+    if (router) {
+        uint64_t round = router->lookup(key);
+        if (round >= rounds.size()) {
+            return NOT_FOUND;
+        }
+        uint64_t position = rounds[round]->getPosition(key, getRoundSeed(round));
+        return position == BloomFilter::AMBIGUOUS ? NOT_FOUND : position;
+    }
+    // NOT_FOUND and AMBIGUOUS both leave the k-mer to the next round
+    for (std::size_t r = 0; r < rounds.size(); r++) {
+        uint64_t position = rounds[r]->getPosition(key, getRoundSeed(r));
+        if (position < BloomFilter::AMBIGUOUS) {
+            return position;
+        }
+    }
+    return NOT_FOUND;
+}
+
+uint64_t BloomFilterCascade::lookup(const std::string& kmer) const {
+    if (!config.canonical) {
+        return lookupValue(kmer);
+    }
+    return lookupStranded(kmer).position;
+}
+
+StrandedPosition BloomFilterCascade::lookupStranded(const std::string& kmer) const {
+    if (!config.canonical) {
+        return { lookupValue(kmer), false };
+    }
+    bool reversed;
+    uint64_t value = lookupValue(canonicalKmer(kmer, reversed));
+    if (value == NOT_FOUND) {
+        return { NOT_FOUND, false };
+    }
+    return { value >> 1, static_cast<bool>(value & 1ULL) != reversed };
+}
+
+uint64_t BloomFilterCascade::lookupVerified(const std::string& kmer, const PackedReferenceStore& reference) const {
+    return lookupStrandedVerified(kmer, reference).position;
+}
+
+StrandedPosition BloomFilterCascade::lookupStrandedVerified(const std::string& kmer,
+    const PackedReferenceStore& reference) const {
+    bool reversed = false;
+    const std::string key = config.canonical ? canonicalKmer(kmer, reversed) : kmer;
+    auto verify = [&](uint64_t value) -> StrandedPosition {
+        if (value >= BloomFilter::AMBIGUOUS) {
+            return { NOT_FOUND, false };
+        }
+        StrandedPosition hit = config.canonical
+            ? StrandedPosition{ value >> 1, static_cast<bool>(value & 1ULL) != reversed }
+            : StrandedPosition{ value, false };
+        return reference.matches(hit.position, kmer, hit.reverse) ? hit : StrandedPosition{ NOT_FOUND, false };
+    };
+
+    if (router) {
+        uint64_t round = router->lookup(key);
+        if (round >= rounds.size()) {
+            return { NOT_FOUND, false };
+        }
+        return verify(rounds[round]->getPosition(key, getRoundSeed(round)));
+    }
+    for (std::size_t r = 0; r < rounds.size(); r++) {
+        StrandedPosition hit = verify(rounds[r]->getPosition(key, getRoundSeed(r)));
+        if (hit.position != NOT_FOUND) {
+            return hit;
+        }
+    }
+    return { NOT_FOUND, false };
+}
+
+void BloomFilterCascade::lookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const {
+    if (out.size() != kmers.size()) {
+        throw std::invalid_argument("[Cascade] Batch output size must match the number of k-mers");
+    }
+    if (!config.canonical) {
+        lookupValueBatch(kmers, out);
+        return;
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve(kmers.size());
+    for (const auto& kmer : kmers) {
+        bool reversed;
+        keys.push_back(canonicalKmer(kmer, reversed));
+    }
+    lookupValueBatch(keys, out);
+    for (auto& value : out) {
+        if (value != NOT_FOUND) value >>= 1;
+    }
+}
+
+void BloomFilterCascade::lookupStrandedBatch(std::span<const std::string> kmers,
+    std::span<StrandedPosition> out) const {
+    if (out.size() != kmers.size()) {
+        throw std::invalid_argument("[Cascade] Batch output size must match the number of k-mers");
+    }
+
+    std::vector<uint64_t> values(kmers.size());
+    if (!config.canonical) {
+        lookupValueBatch(kmers, values);
+        for (std::size_t j = 0; j < kmers.size(); j++) out[j] = { values[j], false };
+        return;
+    }
+
+    std::vector<std::string> keys;
+    std::vector<uint8_t> reversed(kmers.size());
+    keys.reserve(kmers.size());
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        bool isReversed;
+        keys.push_back(canonicalKmer(kmers[j], isReversed));
+        reversed[j] = isReversed;
+    }
+    lookupValueBatch(keys, values);
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        if (values[j] == NOT_FOUND) {
+            out[j] = { NOT_FOUND, false };
+        }
+        else {
+            out[j] = { values[j] >> 1, static_cast<bool>(values[j] & 1ULL) != static_cast<bool>(reversed[j]) };
+        }
+    }
+}
+
+void BloomFilterCascade::lookupValueBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const {
+    if (router) {
+        routedLookupBatch(kmers, out);
+        return;
+    }
+    std::fill(out.begin(), out.end(), NOT_FOUND);
+
+    // k-mers still unresolved, compacted after every round
+    std::vector<std::size_t> unresolved(kmers.size());
+    std::iota(unresolved.begin(), unresolved.end(), std::size_t{ 0 });
+    std::vector<std::string> batch;
+    std::vector<uint64_t> positions;
+
+    for (std::size_t r = 0; r < rounds.size() && !unresolved.empty(); r++) {
+        if (r == 0) {
+            rounds[r]->getPositionBatch(kmers, out, getRoundSeed(r));
+            std::erase_if(unresolved, [&](std::size_t j) { return out[j] < BloomFilter::AMBIGUOUS; });
+            continue;
+        }
+
+        batch.clear();
+        for (std::size_t j : unresolved) batch.push_back(kmers[j]);
+        positions.resize(batch.size());
+        rounds[r]->getPositionBatch(batch, positions, getRoundSeed(r));
+
+        std::size_t kept = 0;
+        for (std::size_t b = 0; b < batch.size(); b++) {
+            if (positions[b] < BloomFilter::AMBIGUOUS) {
+                out[unresolved[b]] = positions[b];
+            }
+            else {
+                unresolved[kept++] = unresolved[b];
+            }
+        }
+        unresolved.resize(kept);
+    }
+    // k-mers whose every claim failed its check bits
+    for (std::size_t j : unresolved) out[j] = NOT_FOUND;
+}
+
+void BloomFilterCascade::routedLookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const {
+    std::vector<uint64_t> routes(kmers.size());
+    router->lookupBatch(kmers, routes);
+    std::fill(out.begin(), out.end(), NOT_FOUND);
+
+    // group the k-mers by round (counting sort), so each round resolves
+    // only the k-mers routed to it
+    std::vector<std::size_t> roundBegin(rounds.size() + 1, 0);
+    for (uint64_t route : routes) {
+        if (route < rounds.size()) roundBegin[route + 1]++;
+    }
+    std::partial_sum(roundBegin.begin(), roundBegin.end(), roundBegin.begin());
+    std::vector<std::size_t> byRound(roundBegin.back());
+    std::vector<std::size_t> fill(roundBegin.begin(), roundBegin.end() - 1);
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        if (routes[j] < rounds.size()) byRound[fill[routes[j]]++] = j;
+    }
+
+    std::vector<std::string> batch;
+    std::vector<uint64_t> positions;
+    for (std::size_t r = 0; r < rounds.size(); r++) {
+        if (roundBegin[r] == roundBegin[r + 1]) continue;
+        batch.clear();
+        for (std::size_t b = roundBegin[r]; b < roundBegin[r + 1]; b++) batch.push_back(kmers[byRound[b]]);
+        positions.resize(batch.size());
+        rounds[r]->getPositionBatch(batch, positions, getRoundSeed(r));
+        for (std::size_t b = 0; b < batch.size(); b++) {
+            out[byRound[roundBegin[r] + b]] = positions[b] == BloomFilter::AMBIGUOUS ? NOT_FOUND : positions[b];
+        }
+    }
+}
+
+bool BloomFilterCascade::mightContain(const std::string& kmer) const {
+    bool reversed;
+    const std::string key = config.canonical ? canonicalKmer(kmer, reversed) : kmer;
+    if (router) {
+        uint64_t round = router->lookup(key);
+        return round < rounds.size() && rounds[round]->mightContain(key, getRoundSeed(round));
+    }
+    for (std::size_t r = 0; r < rounds.size(); r++) {
+        if (rounds[r]->mightContain(key, getRoundSeed(r))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t BloomFilterCascade::getMemoryBits() const {
+    std::size_t bits = 0;
+    for (const auto& filter : rounds) {
+        bits += filter->getMemoryBits();
+    }
+    return bits + getRouterBits();
+}
+
+std::size_t BloomFilterCascade::getRouterBits() const {
+    return router ? router->getMemoryBits() : 0;
+}
+
+double BloomFilterCascade::getBitsPerKmer() const {
+    if (numKmers == 0) return 0.0;
+    return static_cast<double>(getMemoryBits()) / numKmers;
+}
+
+void BloomFilterCascade::dumpStats(std::ostream& out) const {
+    out << "{\"numKmers\":" << numKmers
+        << ",\"numRounds\":" << rounds.size()
+        << ",\"memoryBytes\":" << (getMemoryBits() + 7) / 8
+        << ",\"routerBytes\":" << (getRouterBits() + 7) / 8
+        << ",\"bitsPerKmer\":" << getBitsPerKmer()
+        << ",\"rounds\":[";
+    for (std::size_t r = 0; r < rounds.size(); r++) {
+        const RoundStats& round = stats[r];
+        out << (r ? "," : "") << "{\"round\":" << round.round
+            << ",\"attempted\":" << round.attempted
+            << ",\"inserted\":" << round.inserted
+            << ",\"shadowed\":" << round.shadowed
+            << ",\"sizedFor\":" << round.sizedFor
+            << ",\"acceptanceRate\":" << round.acceptanceRate
+            << ",\"filter\":";
+        rounds[r]->dumpStats(out);
+        out << '}';
+    }
+    out << "]}";
+}
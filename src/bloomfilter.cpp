@@ -3,7 +3,13 @@
 #include <cmath>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <iostream>
+#include <ostream>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
 
 // ------------------ Hashing Functions ------------------ //
 uint64_t BloomFilter::combine128to64(const uint8_t hash128[16]) {
@@ -13,195 +19,895 @@ uint64_t BloomFilter::combine128to64(const uint8_t hash128[16]) {
     return low ^ high;
 }
 
-uint64_t BloomFilter::generateHash(const std::string& item, int i, int seed) const {
+// Double-hashing step for probe i: h1 + i * h2, plus the cubic term of
+// enhanced double hashing. Arithmetic wraps modulo 2^64 before reduction.
+static uint64_t deriveProbe(uint64_t h1, uint64_t h2, int i, bool enhanced) {
+    uint64_t k = static_cast<uint64_t>(i);
+    uint64_t value = h1 + k * h2;
+    if (enhanced) {
+        value += (k * k * k - k) / 6;
+    }
+    return value;
+}
+
+// Single 128-bit digest split into the (h1, h2) pair used by double hashing.
+// h2 is forced odd so the probe sequence cannot collapse onto one index when
+// it shares factors with the range.
+void BloomFilter::hashDigest(const std::string& item, int seed, uint64_t& h1, uint64_t& h2) {
     uint8_t hash128[16];
-    uint32_t modifiedSeed = seed + i;
-    MurmurHash3_x64_128(item.c_str(), (int)item.size(), modifiedSeed, hash128);
+    MurmurHash3_x64_128(item.c_str(), (int)item.size(), static_cast<uint32_t>(seed), hash128);
+    std::memcpy(&h1, hash128, 8);
+    std::memcpy(&h2, hash128 + 8, 8);
+    h2 |= 1ULL;
+}
+
+uint64_t BloomFilter::probeHash(const std::string& item, int i, int seed) const {
+    if (hashScheme == HashScheme::Independent) {
+        uint8_t hash128[16];
+        uint32_t modifiedSeed = seed + i;
+        MurmurHash3_x64_128(item.c_str(), (int)item.size(), modifiedSeed, hash128);
+        return combine128to64(hash128);
+    }
+
+    uint64_t h1, h2;
+    hashDigest(item, seed, h1, h2);
+    return deriveProbe(h1, h2, i, hashScheme == HashScheme::EnhancedDoubleHashing);
+}
 
-    uint64_t hashValue = combine128to64(hash128);
-    return hashValue % bitArraySize;
+uint64_t BloomFilter::reduceIndex(uint64_t hashValue, int /*i*/) const {
+    return reduceRange(hashValue, bitArraySize);
+}
+
+uint64_t BloomFilter::generateHash(const std::string& item, int i, int seed) const {
+    return reduceIndex(probeHash(item, i, seed), i);
+}
+
+void BloomFilter::computeHashIndexes(const std::string& item, int seed, uint64_t* out) const {
+    if (hashScheme == HashScheme::Independent) {
+        for (int i = 0; i < numHashCount; i++) {
+            out[i] = generateHash(item, i, seed);
+        }
+        return;
+    }
+
+    uint64_t h1, h2;
+    hashDigest(item, seed, h1, h2);
+    indexesFromDigest(h1, h2, out);
+}
+
+void BloomFilter::indexesFromDigest(uint64_t h1, uint64_t h2, uint64_t* out) const {
+    bool enhanced = hashScheme == HashScheme::EnhancedDoubleHashing;
+    for (int i = 0; i < numHashCount; i++) {
+        out[i] = reduceIndex(deriveProbe(h1, h2, i, enhanced), i);
+    }
+}
+
+void BloomFilter::hashDigest(uint64_t itemHash, int seed, uint64_t& h1, uint64_t& h2) {
+    uint64_t seeded = itemHash ^ mix64(static_cast<uint32_t>(seed));
+    h1 = mix64(seeded);
+    h2 = mix64(seeded + 0x9e3779b97f4a7c15ULL) | 1ULL;
+}
+
+void BloomFilter::computeHashIndexesForHash(uint64_t itemHash, int seed, uint64_t* out) const {
+    if (hashScheme == HashScheme::Independent) {
+        // one mix per probe, seeded with seed + i like the string path
+        for (int i = 0; i < numHashCount; i++) {
+            uint64_t h1, h2;
+            hashDigest(itemHash, seed + i, h1, h2);
+            out[i] = reduceIndex(h1, i);
+        }
+        return;
+    }
+
+    uint64_t h1, h2;
+    hashDigest(itemHash, seed, h1, h2);
+    indexesFromDigest(h1, h2, out);
 }
 
 // ------------------ Constructor ------------------ //
 BloomFilter::BloomFilter(std::size_t elementsToEncode,
     double falsePositiveRate,
-    int positionBits)
-    : positionBits(positionBits)
+    int positionBits,
+    BloomFilterOptions options)
+    : BloomFilter(elementsToEncode, falsePositiveRate, positionBits, options, SizeOnly{})
+{
+    if (slotLayout == SlotLayout::Blocked) {
+        throw std::invalid_argument("[BloomFilter] Blocked layout is only available through BlockedBloomFilter");
+    }
+    allocateSlots();
+}
+
+BloomFilter::BloomFilter(std::size_t elementsToEncode,
+    double falsePositiveRate,
+    int positionBits,
+    BloomFilterOptions options,
+    SizeOnly)
+    : positionBits(positionBits),
+    checkBits(options.checkBits),
+    hashScheme(options.hashScheme),
+    slotLayout(options.slotLayout),
+    rangeReduction(options.rangeReduction),
+    rejectSelfCollisions(options.rejectSelfCollisions)
 
    
 {
-    // calculate optimal size of bloom filter
-    bitArraySize = static_cast<std::size_t>(std::ceil(
+    if (options.checkBits < 0 || positionBits + options.checkBits > 64) {
+        throw std::invalid_argument("[BloomFilter] positionBits + checkBits must not exceed 64");
+    }
+
+    bitArraySize = calculateBitArraySize(elementsToEncode, falsePositiveRate);
+
+    numHashCount = calculateOptimalHashNum(elementsToEncode, bitArraySize);
+
+    // the hash count stays the one optimal for the unrounded size
+    if (rangeReduction == RangeReduction::PowerOfTwo) {
+        bitArraySize = std::bit_ceil(bitArraySize);
+    }
+
+    sizeChunks();
+}
+
+// optimal size of a bloom filter for elementsToEncode at falsePositiveRate
+std::size_t BloomFilter::calculateBitArraySize(std::size_t elementsToEncode, double falsePositiveRate) {
+    return static_cast<std::size_t>(std::ceil(
         -(elementsToEncode * std::log(falsePositiveRate)) / (std::log(2) * std::log(2))
     ));
+}
 
-    // resizing presence bitset according to calculations
-    presenceBitset.resize(bitArraySize, false);
-
-    // calculate optimal number of hash functions
-    numHashCount = std::max(1, static_cast<int>(std::round(
+// optimal number of hash functions for that size
+int BloomFilter::calculateOptimalHashNum(std::size_t elementsToEncode, std::size_t bitArraySize) {
+    return std::max(1, static_cast<int>(std::round(
         (bitArraySize / static_cast<double>(elementsToEncode)) * std::log(2)
     )));
+}
+
+BloomFilter::BloomFilter(const FilterParameters& params)
+    : positionBits(params.positionBits),
+    checkBits(params.checkBits),
+    bitArraySize(params.bitArraySize),
+    chunkCount(params.chunkCount),
+    hashScheme(params.hashScheme),
+    slotLayout(params.slotLayout),
+    rangeReduction(params.rangeReduction),
+    blockPlaneWidth(params.blockPlaneWidth),
+    slotFieldWidth(params.slotFieldWidth),
+    rejectSelfCollisions(params.rejectSelfCollisions),
+    numHashCount(static_cast<int>(params.numHashCount))
+{
+    computeSlotMasks();
+}
+
+FilterParameters BloomFilter::getParameters() const {
+    FilterParameters params;
+    params.kind = FilterKind::Standard;
+    params.hashScheme = hashScheme;
+    params.slotLayout = slotLayout;
+    params.bitArraySize = bitArraySize;
+    params.numHashCount = static_cast<uint64_t>(numHashCount);
+    params.chunkCount = chunkCount;
+    params.positionBits = positionBits;
+    params.blockPlaneWidth = blockPlaneWidth;
+    params.slotFieldWidth = slotFieldWidth;
+    params.rejectSelfCollisions = rejectSelfCollisions;
+    params.rangeReduction = rangeReduction;
+    params.checkBits = checkBits;
+    return params;
+}
+
+void BloomFilter::computeSlotMasks() {
+    slotMasks.assign(numHashCount, 1ULL);
+    for (int i = 0; i < numHashCount; i++) {
+        for (std::size_t c = 0; c < chunkCount; c++) {
+            if (c * numHashCount + i >= payloadBits()) break;
+            slotMasks[i] |= 1ULL << (c + 1);
+        }
+    }
+    // the per-probe counters follow the hash count too
+    KMER_STATS(counters = FilterCounters(numHashCount);)
+}
 
+void BloomFilter::requireWritable() const {
+    if (readOnly) {
+        throw std::logic_error("[BloomFilter] Filter is a read-only mapping");
+    }
+}
+
+void BloomFilter::sizeChunks() {
     // calculate how many coupled bit arrays needed for position encoding
-    chunkCount = (positionBits + numHashCount - 1) / numHashCount;
+    chunkCount = (payloadBits() + numHashCount - 1) / numHashCount;
+    computeSlotMasks();
+}
 
-    positionBitsets.resize(chunkCount);
-    for (size_t b = 0; b < chunkCount; b++) {
-        positionBitsets[b].resize(bitArraySize, false);
+void BloomFilter::allocateSlots() {
+    sizeChunks();
+
+    if (slotLayout == SlotLayout::Interleaved) {
+        slotFieldWidth = chunkCount + 1;
+        if (slotFieldWidth > 57) {
+            throw std::invalid_argument("[BloomFilter] Interleaved slots are limited to 56 position chunks");
+        }
+        // one spare word so an unaligned window at the last slot stays in bounds
+        presenceBitset = PackedBitset(bitArraySize * slotFieldWidth + PackedBitset::WORD_BITS);
+        positionBitsets.clear();
+        return;
     }
+
+    presenceBitset = PackedBitset(bitArraySize);
+    positionBitsets.assign(chunkCount, PackedBitset(bitArraySize));
 }
 
 // ------------------ Presence Bloom Filter  ------------------ //
 void BloomFilter::addPresence(const std::string& item, int seed) {
-    for (int i = 0; i < numHashCount; i++) {
-        uint64_t index = generateHash(item, i, seed);
-        presenceBitset[index] = true;
+    requireWritable();
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexes(item, seed, hashIndexes.data());
+    countFilled(hashIndexes.data());
+    for (auto index : hashIndexes) {
+        setPresence(index);
     }
 }
 
 bool BloomFilter::mightContain(const std::string& item, int seed) const {
+    // independent hashes are computed lazily so a miss stops hashing early
+    if (hashScheme == HashScheme::Independent) {
+        for (int i = 0; i < numHashCount; i++) {
+            uint64_t index = generateHash(item, i, seed);
+            if (!presenceAt(index)) {
+                countLookup(i + 1, false);
+                return false;
+            }
+        }
+        countLookup(numHashCount, true);
+        return true;
+    }
+
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexes(item, seed, hashIndexes.data());
+    return presentAt(hashIndexes.data());
+}
+
+bool BloomFilter::presentAt(const uint64_t* hashIndexes) const {
     for (int i = 0; i < numHashCount; i++) {
-        uint64_t index = generateHash(item, i, seed);
-        if (!presenceBitset[index]) {
+        if (!presenceAt(hashIndexes[i])) {
+            countLookup(i + 1, false);
             return false;
         }
     }
+    countLookup(numHashCount, true);
     return true;
 }
 
 // ------------------ Position Bloom Filters ------------------ //
+// Probe i stores payload bits i, i + numHashCount, i + 2 * numHashCount, ...
+// one per chunk, behind the presence bit of its slot.
+uint64_t BloomFilter::slotFieldFor(uint64_t payload, int i) const {
+    uint64_t field = 1ULL;
+    for (std::size_t c = 0; c < chunkCount; c++) {
+        std::size_t bitIndex = c * numHashCount + i;
+        if (bitIndex >= payloadBits()) break;
+        field |= ((payload >> bitIndex) & 1ULL) << (c + 1);
+    }
+    return field;
+}
+
+uint64_t BloomFilter::positionFromPayload(uint64_t payload) const {
+    if (checkBits == 0) return payload;
+    uint64_t position = payload & ((1ULL << positionBits) - 1);
+    if (payloadFor(position) != payload) {
+        KMER_STATS(counters.checkFailures.add();)
+        return AMBIGUOUS;
+    }
+    return position;
+}
+
 void BloomFilter::addPosition(const std::string& item, uint64_t position, int seed) {
+    requireWritable();
     std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexes(item, seed, hashIndexes.data());
+
+    // only sets the one bits, leaving presence untouched
+    uint64_t payload = payloadFor(position);
     for (int i = 0; i < numHashCount; i++) {
-        hashIndexes[i] = generateHash(item, i, seed);
+        uint64_t ones = slotFieldFor(payload, i) & ~1ULL;
+        writeSlot(hashIndexes[i], ones, ones);
     }
+}
 
-    std::vector<bool> bits = encodePosition(position);
+uint64_t BloomFilter::decodeSlots(const uint64_t* hashIndexes) const {
+    // each slot is read once for both its presence and position bits
+    uint64_t reconstructed = 0ULL;
+    for (int i = 0; i < numHashCount; i++) {
+        uint64_t field = readSlot(hashIndexes[i]);
+        if (!(field & 1ULL)) {
+            countLookup(i + 1, false);
+            return NOT_FOUND;
+        }
+        for (std::size_t c = 0; c < chunkCount; c++) {
+            std::size_t bitIndex = c * numHashCount + i;
+            if (bitIndex >= payloadBits()) break;
+            reconstructed |= ((field >> (c + 1)) & 1ULL) << bitIndex;
+        }
+    }
 
-    for (size_t b = 0; b < chunkCount; b++) {
-        for (int i = 0; i < numHashCount; i++) {
-            size_t bitIndex = b * numHashCount + i;
-            if (bitIndex >= bits.size()) break;
+    countLookup(numHashCount, true);
+    return positionFromPayload(reconstructed);
+}
+
+uint64_t BloomFilter::getPosition(const std::string& item, int seed) const {
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexes(item, seed, hashIndexes.data());
+    return decodeSlots(hashIndexes.data());
+}
+
+uint64_t BloomFilter::getVerifiedPosition(const std::string& kmer, const PackedReferenceStore& reference,
+    int seed) const {
+    uint64_t position = getPosition(kmer, seed);
+    return reference.matches(position, kmer) ? position : NOT_FOUND;
+}
+
+// ------------------ Batched Queries ------------------ //
+void BloomFilter::mightContainBatch(std::span<const std::string> items, std::span<uint8_t> out, int seed) const {
+    if (out.size() != items.size()) {
+        throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
+    }
+
+    std::vector<uint64_t> hashIndexes(BATCH_BLOCK * numHashCount);
+    for (std::size_t begin = 0; begin < items.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, items.size() - begin);
 
-            if (bits[bitIndex]) {
-                positionBitsets[b][hashIndexes[i]] = true;
+        // pass 1: hash the whole block and issue loads for every probe
+        for (std::size_t j = 0; j < count; j++) {
+            uint64_t* indexes = hashIndexes.data() + j * numHashCount;
+            computeHashIndexes(items[begin + j], seed, indexes);
+            for (int i = 0; i < numHashCount; i++) {
+                presenceBitset.prefetch(slotLayout == SlotLayout::Interleaved
+                    ? indexes[i] * slotFieldWidth : indexes[i]);
             }
         }
+
+        // pass 2: the presence words should now be in cache
+        for (std::size_t j = 0; j < count; j++) {
+            out[begin + j] = presentAt(hashIndexes.data() + j * numHashCount);
+        }
     }
 }
 
-uint64_t BloomFilter::getPosition(const std::string& item, int seed) const {
-    if (!mightContain(item, seed)) {
-        return static_cast<uint64_t>(-1);
+void BloomFilter::getPositionBatch(std::span<const std::string> items, std::span<uint64_t> out, int seed) const {
+    if (out.size() != items.size()) {
+        throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
     }
 
-    std::vector<uint64_t> hashIndexes(numHashCount);
-    for (int i = 0; i < numHashCount; i++) {
-        hashIndexes[i] = generateHash(item, i, seed);
-    }
+    std::vector<uint64_t> hashIndexes(BATCH_BLOCK * numHashCount);
+    for (std::size_t begin = 0; begin < items.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, items.size() - begin);
 
-    std::vector<bool> bits(positionBits, false);
-    //std::cout << "Reconstructing bits: ";
-    for (size_t b = 0; b < chunkCount; b++) {
-        for (int i = 0; i < numHashCount; i++) {
-            size_t bitIndex = b * numHashCount + i;
-            if (bitIndex >= positionBits) break;
-            bits[bitIndex] = positionBitsets[b][hashIndexes[i]];
-            //std::cout << bits[bitIndex];
+        for (std::size_t j = 0; j < count; j++) {
+            uint64_t* indexes = hashIndexes.data() + j * numHashCount;
+            computeHashIndexes(items[begin + j], seed, indexes);
+            for (int i = 0; i < numHashCount; i++) {
+                prefetchSlot(indexes[i]);
+            }
         }
-    }
-    // debugging
-    //std::cout << std::endl;
 
-    uint64_t reconstructed = 0ULL;
-    for (size_t i = 0; i < bits.size(); i++) {
-        if (bits[i]) {
-            reconstructed |= (1ULL << i);
+        for (std::size_t j = 0; j < count; j++) {
+            out[begin + j] = decodeSlots(hashIndexes.data() + j * numHashCount);
         }
     }
-
-    return reconstructed;
 }
 
 // ------------------ Combined Encoding ------------------ //
 bool BloomFilter::add(const std::string& item, uint64_t position, int seed) {
+    requireWritable();
     std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexes(item, seed, hashIndexes.data());
+    return insertAt(hashIndexes.data(), position);
+}
+
+bool BloomFilter::insertAt(const uint64_t* hashIndexes, uint64_t position) {
+    if (!canInsertAt(hashIndexes, position)) {
+        return false;
+    }
+
+    // Writes go in probe order, so when two probes of the same item share a
+    // slot (an intra-element collision) the later probe's bits win.
+    countFilled(hashIndexes);
+    uint64_t payload = payloadFor(position);
     for (int i = 0; i < numHashCount; i++) {
-        hashIndexes[i] = generateHash(item, i, seed);
+        writeSlot(hashIndexes[i], slotFieldFor(payload, i), slotMasks[i]);
     }
+    return true;
+}
+
+bool BloomFilter::canInsertAt(const uint64_t* hashIndexes, uint64_t position) const {
+    KMER_STATS(counters.adds.add();)
     if (position >= (1ULL << positionBits)) {
+        KMER_STATS(counters.rejectedPositionRange.add();)
         return false;
     }
-    std::vector<bool> newBits = encodePosition(position);
-    std::vector<uint64_t> collisionIndexes;
-    std::vector<int> collisionPositions;
-    collisionIndexes.reserve(numHashCount);
-    collisionPositions.reserve(numHashCount);
+    uint64_t payload = payloadFor(position);
+
+    // an occupied slot must already hold exactly the bits this item needs
     for (int i = 0; i < numHashCount; i++) {
-        uint64_t hIndex = hashIndexes[i];
-        if (presenceBitset[hIndex]) {
-            collisionIndexes.push_back(hIndex);
-            collisionPositions.push_back(i);
-        }
-    }
-    for (size_t b = 0; b < chunkCount; b++) {
-        for (size_t idx = 0; idx < collisionIndexes.size(); idx++) {
-            int hashFuncIndex = collisionPositions[idx];
-            uint64_t hIndex = collisionIndexes[idx];
-            size_t bitIndex = b * numHashCount + hashFuncIndex;
-            if (bitIndex >= newBits.size()) break;
-            bool existingBit = positionBitsets[b][hIndex];
-            bool desiredBit = newBits[bitIndex];
-            if (existingBit != desiredBit) {
-                return false;
+        uint64_t existing = readSlot(hashIndexes[i]);
+        if ((existing & 1ULL) && ((existing ^ slotFieldFor(payload, i)) & slotMasks[i])) {
+            KMER_STATS(
+                counters.probes.add(i + 1);
+                counters.conflictsByProbe[i].add();
+            )
+            return false;
+        }
+    }
+    KMER_STATS(counters.probes.add(numHashCount);)
+
+    if (rejectSelfCollisions) {
+        for (int i = 0; i < numHashCount; i++) {
+            for (int j = i + 1; j < numHashCount; j++) {
+                if (hashIndexes[i] == hashIndexes[j]
+                    && ((slotFieldFor(payload, i) ^ slotFieldFor(payload, j)) & slotMasks[i] & slotMasks[j])) {
+                    KMER_STATS(counters.rejectedSelfCollision.add();)
+                    return false;
+                }
+            }
+        }
+    }
+    KMER_STATS(counters.accepted.add();)
+    return true;
+}
+
+void BloomFilter::countFilled([[maybe_unused]] const uint64_t* hashIndexes) const {
+    KMER_STATS(
+        for (int i = 0; i < numHashCount; i++) {
+            bool earlierProbe = std::find(hashIndexes, hashIndexes + i, hashIndexes[i]) != hashIndexes + i;
+            if (!earlierProbe && !presenceAt(hashIndexes[i])) {
+                counters.filledByProbe[i].add();
             }
         }
+    )
+}
+
+// ------------------ Batched Construction ------------------ //
+// Like the batched queries: the slots of a whole block are prefetched before
+// its first item is checked, so the misses of a block overlap instead of each
+// add waiting out its own. Items are still inserted in order, so every check
+// sees what add would have seen.
+void BloomFilter::insertBlock(const uint64_t* hashIndexes, const uint64_t* positions, std::size_t count,
+    uint8_t* accepted) {
+    for (std::size_t e = 0; e < count * numHashCount; e++) {
+        prefetchSlot(hashIndexes[e]);
     }
+    for (std::size_t j = 0; j < count; j++) {
+        accepted[j] = insertAt(hashIndexes + j * numHashCount, positions[j]);
+    }
+}
 
-    // Debug statements - be aware of intra-element collisions which happen
-    //std::cout << "Setting position bits for " << item << ":\n";
-    //for (size_t b = 0; b < chunkCount; b++) {
-    //    for (int i = 0; i < numHashCount; i++) {
-    //        size_t bitIndex = b * numHashCount + i;
-    //        if (bitIndex >= newBits.size()) break;
-    //        std::cout << "chunk " << b << ", hash " << i << ": setting bit "
-    //            << newBits[bitIndex] << " at index " << hashIndexes[i] << std::endl;
-    //    }
-    //}
+void BloomFilter::addBatch(std::span<const std::string> items, std::span<const uint64_t> positions,
+    std::span<uint8_t> accepted, int seed) {
+    requireWritable();
+    if (positions.size() != items.size() || accepted.size() != items.size()) {
+        throw std::invalid_argument("[BloomFilter] Positions and accepted flags must match the number of items");
+    }
+    std::vector<uint64_t> hashIndexes(BATCH_BLOCK * numHashCount);
+    for (std::size_t begin = 0; begin < items.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, items.size() - begin);
+        for (std::size_t j = 0; j < count; j++) {
+            computeHashIndexes(items[begin + j], seed, hashIndexes.data() + j * numHashCount);
+        }
+        insertBlock(hashIndexes.data(), &positions[begin], count, &accepted[begin]);
+    }
+}
 
-    for (auto hIndex : hashIndexes) {
-        presenceBitset[hIndex] = true;
+void BloomFilter::addBatchHashed(std::span<const uint64_t> itemHashes, std::span<const uint64_t> positions,
+    std::span<uint8_t> accepted, int seed) {
+    requireWritable();
+    if (positions.size() != itemHashes.size() || accepted.size() != itemHashes.size()) {
+        throw std::invalid_argument("[BloomFilter] Positions and accepted flags must match the number of items");
     }
-    for (size_t b = 0; b < chunkCount; b++) {
-        for (int i = 0; i < numHashCount; i++) {
-            size_t bitIndex = b * numHashCount + i;
-            if (bitIndex >= newBits.size()) break;
-            positionBitsets[b][hashIndexes[i]] = newBits[bitIndex];
+    std::vector<uint64_t> hashIndexes(BATCH_BLOCK * numHashCount);
+    for (std::size_t begin = 0; begin < itemHashes.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, itemHashes.size() - begin);
+        for (std::size_t j = 0; j < count; j++) {
+            computeHashIndexesForHash(itemHashes[begin + j], seed, hashIndexes.data() + j * numHashCount);
         }
+        insertBlock(hashIndexes.data(), &positions[begin], count, &accepted[begin]);
     }
-    return true;
 }
 
+// ------------------ Parallel Construction ------------------ //
+// Deterministic reservations: in every pass each undecided item reserves its
+// probed slots, and the lowest-numbered item probing a slot owns it. An item
+// owning all of its slots has every earlier item that touches them already
+// decided, and no later item can have written there, so it sees exactly the
+// slots a sequential add would see. Owners are checked and written in
+// parallel; the rest wait for the next pass.
+namespace {
+template <typename Fn>
+void parallelFor(std::size_t count, unsigned numThreads, Fn fn) {
+    std::size_t workers = std::min<std::size_t>(numThreads, count);
+    if (workers <= 1) {
+        if (count > 0) fn(std::size_t{ 0 }, count);
+        return;
+    }
+    std::size_t step = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (std::size_t begin = step; begin < count; begin += step) {
+        threads.emplace_back(fn, begin, std::min(count, begin + step));
+    }
+    fn(std::size_t{ 0 }, step);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
 
+// Lock-free open-addressing map from a slot to the lowest item reserving it.
+class SlotReservations {
+public:
+    static constexpr uint32_t UNOWNED = UINT32_MAX;
 
-// Helper to convert a position into binary bits with padding
-std::vector<bool> BloomFilter::encodePosition(uint64_t position) const {
-    std::vector<bool> bits(positionBits, false);
-    for (size_t i = 0; i < positionBits; i++) {
-        bits[i] = ((position >> i) & 1ULL) != 0;
+    void reset(std::size_t maxEntries) {
+        std::size_t capacity = std::bit_ceil(std::max<std::size_t>(2 * maxEntries, 64));
+        keys.assign(capacity, 0);
+        owners.assign(capacity, UNOWNED);
+        mask = capacity - 1;
     }
 
-    // debugging
-    //std::cout << "Encoding position " << position << ": ";
-    //for (bool b : bits) {
-    //    std::cout << b;
-    //}
-    //std::cout << std::endl;
+    void reserve(uint64_t slot, uint32_t item) {
+        std::atomic_ref<uint32_t> owner(owners[entryFor(slot)]);
+        uint32_t current = owner.load(std::memory_order_relaxed);
+        while (item < current && !owner.compare_exchange_weak(current, item, std::memory_order_relaxed)) {
+        }
+    }
 
-    return bits;
+    // Only valid once every reserve call has finished.
+    uint32_t ownerOf(uint64_t slot) const {
+        for (std::size_t p = mix64(slot) & mask;; p = (p + 1) & mask) {
+            if (keys[p] == slot + 1) return owners[p];
+            if (keys[p] == 0) return UNOWNED;
+        }
+    }
+
+private:
+    // keys hold slot + 1, so 0 marks an empty entry
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> owners;
+    std::size_t mask = 0;
+
+    std::size_t entryFor(uint64_t slot) {
+        uint64_t key = slot + 1;
+        for (std::size_t p = mix64(slot) & mask;; p = (p + 1) & mask) {
+            std::atomic_ref<uint64_t> entry(keys[p]);
+            uint64_t current = entry.load(std::memory_order_relaxed);
+            if (current == 0 && entry.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+                return p;
+            }
+            if (current == key) return p;
+        }
+    }
 };
 
+// Replaces the bits of word selected by mask with those of bits.
+void assignBitsAtomic(uint64_t& word, uint64_t mask, uint64_t bits) {
+    std::atomic_ref<uint64_t> ref(word);
+    if (bits & mask) ref.fetch_or(bits & mask, std::memory_order_relaxed);
+    if (mask & ~bits) ref.fetch_and(~(mask & ~bits), std::memory_order_relaxed);
+}
+
+void assignBitAtomic(PackedBitset& bitset, uint64_t index, bool value) {
+    uint64_t bit = 1ULL << (index % PackedBitset::WORD_BITS);
+    assignBitsAtomic(bitset.data()[index / PackedBitset::WORD_BITS], bit, value ? bit : 0);
+}
+}
+
+void BloomFilter::writeSlotAtomic(uint64_t slot, uint64_t field, uint64_t mask) {
+    if (slotLayout == SlotLayout::Interleaved) {
+        uint64_t bit = slot * slotFieldWidth;
+        uint64_t* words = presenceBitset.data();
+        std::size_t word = bit / PackedBitset::WORD_BITS;
+        unsigned shift = bit % PackedBitset::WORD_BITS;
+        assignBitsAtomic(words[word], mask << shift, (field & mask) << shift);
+        // the field may straddle two words
+        if (shift + slotFieldWidth > PackedBitset::WORD_BITS) {
+            unsigned spill = PackedBitset::WORD_BITS - shift;
+            assignBitsAtomic(words[word + 1], mask >> spill, (field & mask) >> spill);
+        }
+        return;
+    }
+
+    if (mask & 1ULL) {
+        assignBitAtomic(presenceBitset, slot, field & 1ULL);
+    }
+    for (std::size_t c = 0; c < chunkCount; c++) {
+        if (!((mask >> (c + 1)) & 1ULL)) continue;
+        bool bit = (field >> (c + 1)) & 1ULL;
+        if (slotLayout == SlotLayout::Blocked) {
+            assignBitAtomic(presenceBitset, slot + (c + 1) * blockPlaneWidth, bit);
+        }
+        else {
+            assignBitAtomic(positionBitsets[c], slot, bit);
+        }
+    }
+}
+
+void BloomFilter::addParallel(std::span<const std::string> items, std::span<const uint64_t> positions,
+    std::span<const std::size_t> selection, std::span<uint8_t> accepted, int seed, unsigned numThreads) {
+    requireWritable();
+    if (positions.size() != items.size()) {
+        throw std::invalid_argument("[BloomFilter] Positions must match the number of items");
+    }
+    if (accepted.size() != selection.size()) {
+        throw std::invalid_argument("[BloomFilter] Accepted flags must match the selection size");
+    }
+    for (std::size_t index : selection) {
+        if (index >= items.size()) {
+            throw std::out_of_range("[BloomFilter] Selection index out of range");
+        }
+    }
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    const std::size_t probes = numHashCount;
+    if (numThreads == 1) {
+        std::vector<uint64_t> hashIndexes(BATCH_BLOCK * probes);
+        uint64_t selected[BATCH_BLOCK];
+        for (std::size_t begin = 0; begin < selection.size(); begin += BATCH_BLOCK) {
+            std::size_t count = std::min(BATCH_BLOCK, selection.size() - begin);
+            for (std::size_t j = 0; j < count; j++) {
+                computeHashIndexes(items[selection[begin + j]], seed, hashIndexes.data() + j * probes);
+                selected[j] = positions[selection[begin + j]];
+            }
+            insertBlock(hashIndexes.data(), selected, count, &accepted[begin]);
+        }
+        return;
+    }
+
+    std::vector<uint64_t> hashIndexes(std::min(PARALLEL_CHUNK, selection.size()) * probes);
+
+    SlotReservations reservations;
+    std::vector<uint32_t> undecided;
+    std::vector<uint8_t> owned;
+    for (std::size_t chunkBegin = 0; chunkBegin < selection.size(); chunkBegin += PARALLEL_CHUNK) {
+        std::size_t count = std::min(PARALLEL_CHUNK, selection.size() - chunkBegin);
+        parallelFor(count, numThreads, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t j = begin; j < end; j++) {
+                computeHashIndexes(items[selection[chunkBegin + j]], seed, &hashIndexes[j * probes]);
+            }
+            });
+
+        undecided.resize(count);
+        std::iota(undecided.begin(), undecided.end(), uint32_t{ 0 });
+        while (!undecided.empty()) {
+            reservations.reset(undecided.size() * probes);
+            parallelFor(undecided.size(), numThreads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t t = begin; t < end; t++) {
+                    for (std::size_t i = 0; i < probes; i++) {
+                        reservations.reserve(hashIndexes[undecided[t] * probes + i], undecided[t]);
+                    }
+                }
+                });
+
+            owned.assign(undecided.size(), 0);
+            parallelFor(undecided.size(), numThreads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t t = begin; t < end; t++) {
+                    uint32_t j = undecided[t];
+                    const uint64_t* indexes = &hashIndexes[j * probes];
+                    bool ownsAll = true;
+                    for (std::size_t i = 0; i < probes && ownsAll; i++) {
+                        ownsAll = reservations.ownerOf(indexes[i]) == j;
+                    }
+                    if (!ownsAll) continue;
+                    owned[t] = 1;
+                    accepted[chunkBegin + j] = canInsertAt(indexes, positions[selection[chunkBegin + j]]);
+                    // counted here, while no thread is writing
+                    if (accepted[chunkBegin + j]) countFilled(indexes);
+                }
+                });
+
+            // writes start only after every owner has been checked
+            parallelFor(undecided.size(), numThreads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t t = begin; t < end; t++) {
+                    uint32_t j = undecided[t];
+                    if (!owned[t] || !accepted[chunkBegin + j]) continue;
+                    uint64_t payload = payloadFor(positions[selection[chunkBegin + j]]);
+                    for (int i = 0; i < numHashCount; i++) {
+                        writeSlotAtomic(hashIndexes[j * probes + i], slotFieldFor(payload, i), slotMasks[i]);
+                    }
+                }
+                });
+
+            std::size_t kept = 0;
+            for (std::size_t t = 0; t < undecided.size(); t++) {
+                if (!owned[t]) undecided[kept++] = undecided[t];
+            }
+            undecided.resize(kept);
+        }
+    }
+}
+
+// ------------------ Pre-hashed Items ------------------ //
+bool BloomFilter::addHashed(uint64_t itemHash, uint64_t position, int seed) {
+    requireWritable();
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexesForHash(itemHash, seed, hashIndexes.data());
+    return insertAt(hashIndexes.data(), position);
+}
+
+void BloomFilter::addPresenceHashed(uint64_t itemHash, int seed) {
+    requireWritable();
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexesForHash(itemHash, seed, hashIndexes.data());
+    countFilled(hashIndexes.data());
+    for (auto index : hashIndexes) {
+        setPresence(index);
+    }
+}
+
+bool BloomFilter::mightContainHashed(uint64_t itemHash, int seed) const {
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexesForHash(itemHash, seed, hashIndexes.data());
+    return presentAt(hashIndexes.data());
+}
+
+uint64_t BloomFilter::getPositionHashed(uint64_t itemHash, int seed) const {
+    std::vector<uint64_t> hashIndexes(numHashCount);
+    computeHashIndexesForHash(itemHash, seed, hashIndexes.data());
+    return decodeSlots(hashIndexes.data());
+}
+
+bool BloomFilter::addCanonicalHashed(uint64_t canonicalHash, bool reversed, uint64_t position, int seed) {
+    if (position >= (1ULL << (positionBits - 1))) {
+        return false;
+    }
+    return addHashed(canonicalHash, (position << 1) | static_cast<uint64_t>(reversed), seed);
+}
+
+StrandedPosition BloomFilter::getCanonicalPositionHashed(uint64_t canonicalHash, bool reversed, int seed) const {
+    uint64_t stored = getPositionHashed(canonicalHash, seed);
+    if (stored >= AMBIGUOUS) {
+        return { stored, false };
+    }
+    // the strand of the query relative to the strand that was inserted
+    return { stored >> 1, static_cast<bool>(stored & 1ULL) != reversed };
+}
+
+void BloomFilter::mightContainBatchHashed(std::span<const uint64_t> itemHashes, std::span<uint8_t> out,
+    int seed) const {
+    if (out.size() != itemHashes.size()) {
+        throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
+    }
+
+    std::vector<uint64_t> hashIndexes(BATCH_BLOCK * numHashCount);
+    for (std::size_t begin = 0; begin < itemHashes.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, itemHashes.size() - begin);
+
+        for (std::size_t j = 0; j < count; j++) {
+            uint64_t* indexes = hashIndexes.data() + j * numHashCount;
+            computeHashIndexesForHash(itemHashes[begin + j], seed, indexes);
+            for (int i = 0; i < numHashCount; i++) {
+                presenceBitset.prefetch(slotLayout == SlotLayout::Interleaved
+                    ? indexes[i] * slotFieldWidth : indexes[i]);
+            }
+        }
+
+        for (std::size_t j = 0; j < count; j++) {
+            out[begin + j] = presentAt(hashIndexes.data() + j * numHashCount);
+        }
+    }
+}
+
+void BloomFilter::getPositionBatchHashed(std::span<const uint64_t> itemHashes, std::span<uint64_t> out,
+    int seed) const {
+    if (out.size() != itemHashes.size()) {
+        throw std::invalid_argument("[BloomFilter] Batch output size must match the number of items");
+    }
+
+    std::vector<uint64_t> hashIndexes(BATCH_BLOCK * numHashCount);
+    for (std::size_t begin = 0; begin < itemHashes.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, itemHashes.size() - begin);
+
+        for (std::size_t j = 0; j < count; j++) {
+            uint64_t* indexes = hashIndexes.data() + j * numHashCount;
+            computeHashIndexesForHash(itemHashes[begin + j], seed, indexes);
+            for (int i = 0; i < numHashCount; i++) {
+                prefetchSlot(indexes[i]);
+            }
+        }
+
+        for (std::size_t j = 0; j < count; j++) {
+            out[begin + j] = decodeSlots(hashIndexes.data() + j * numHashCount);
+        }
+    }
+}
+
+std::size_t BloomFilter::countPresence(std::size_t beginSlot, std::size_t endSlot) const {
+    if (slotLayout == SlotLayout::Planar) {
+        return presenceBitset.count(beginSlot, endSlot);
+    }
+    std::size_t occupied = 0;
+    for (std::size_t slot = beginSlot; slot < endSlot; slot++) {
+        occupied += presenceAt(slot);
+    }
+    return occupied;
+}
+
 std::size_t BloomFilter::getSize() const {
     return bitArraySize;
-}
\ No newline at end of file
+}
+
+std::size_t BloomFilter::getMemoryBits() const {
+    std::size_t bits = presenceBitset.size();
+    for (const auto& plane : positionBitsets) {
+        bits += plane.size();
+    }
+    return bits;
+}
+
+const PackedBitset& BloomFilter::getBitArray() const {
+    return presenceBitset;
+}
+
+// ------------------ Statistics ------------------ //
+namespace {
+const char* filterKindName(FilterKind kind) {
+    switch (kind) {
+    case FilterKind::Partitioned: return "Partitioned";
+    case FilterKind::Predetermined: return "Predetermined";
+    case FilterKind::Blocked: return "Blocked";
+    default: return "Standard";
+    }
+}
+
+void writeJsonArray(std::ostream& out, const std::vector<uint64_t>& values) {
+    out << '[';
+    for (std::size_t i = 0; i < values.size(); i++) {
+        out << (i ? "," : "") << values[i];
+    }
+    out << ']';
+}
+}
+
+FilterStats BloomFilter::getStats() const {
+#ifdef KMER_ENCODING_STATS
+    return counters.snapshot();
+#else
+    return {};
+#endif
+}
+
+void BloomFilter::resetStats() {
+    KMER_STATS(counters = FilterCounters(numHashCount);)
+}
+
+void BloomFilter::writeStatsFields(std::ostream& out) const {
+    FilterParameters params = getParameters();
+    out << "\"kind\":\"" << filterKindName(params.kind) << '"'
+        << ",\"slots\":" << params.bitArraySize
+        << ",\"numHash\":" << numHashCount
+        << ",\"positionBits\":" << positionBits
+        << ",\"checkBits\":" << checkBits
+        << ",\"chunkCount\":" << chunkCount
+        << ",\"memoryBytes\":" << (getMemoryBits() + 7) / 8
+        << ",\"instrumented\":" << (STATS_ENABLED ? "true" : "false");
+    if (!STATS_ENABLED) return;
+
+    FilterStats stats = getStats();
+    out << ",\"counters\":{\"lookups\":" << stats.lookups
+        << ",\"probes\":" << stats.probes
+        << ",\"presenceHits\":" << stats.presenceHits
+        << ",\"adds\":" << stats.adds
+        << ",\"accepted\":" << stats.accepted
+        << ",\"rejectedPositionRange\":" << stats.rejectedPositionRange
+        << ",\"rejectedSelfCollision\":" << stats.rejectedSelfCollision
+        << ",\"checkFailures\":" << stats.checkFailures
+        << ",\"conflictsByProbe\":";
+    writeJsonArray(out, stats.conflictsByProbe);
+    out << ",\"filledByProbe\":";
+    writeJsonArray(out, stats.filledByProbe);
+    out << '}';
+}
+
+void BloomFilter::dumpStats(std::ostream& out) const {
+    out << '{';
+    writeStatsFields(out);
+    out << '}';
+}
@@ -0,0 +1,50 @@
+#include "fastaReader.h"
+#include <stdexcept>
+
+FastaReader::FastaReader(const std::string& path, std::size_t bufferSize)
+    : path(path),
+    in(path, std::ios::binary),
+    buffer(bufferSize)
+{
+    if (!in.is_open()) {
+        throw std::runtime_error("[FastaReader] Unable to open input file: " + path);
+    }
+    if (bufferSize == 0) {
+        throw std::invalid_argument("[FastaReader] Buffer size must be positive");
+    }
+}
+
+void FastaReader::rewind() {
+    in.clear();
+    in.seekg(0);
+    bufferPos = 0;
+    bufferEnd = 0;
+    records.clear();
+}
+
+bool FastaReader::refill() {
+    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    bufferPos = 0;
+    bufferEnd = static_cast<std::size_t>(in.gcount());
+    if (in.bad()) {
+        throw std::runtime_error("[FastaReader] Failed reading " + path);
+    }
+    return bufferEnd > 0;
+}
+
+void FastaReader::startRecord() {
+    FastaRecord record;
+    // the name is the header up to the first whitespace
+    bool inName = true;
+    for (int c = next(); c != -1 && c != '\n'; c = next()) {
+        if (c == ' ' || c == '\t' || c == '\r') inName = false;
+        if (inName) record.name.push_back(static_cast<char>(c));
+    }
+    records.push_back(std::move(record));
+}
+
+uint64_t FastaReader::getTotalLength() const {
+    uint64_t total = 0;
+    for (const auto& record : records) total += record.length;
+    return total;
+}
@@ -0,0 +1,66 @@
+#include "fastqReader.h"
+#include <stdexcept>
+
+FastqReader::FastqReader(const std::string& path, std::size_t bufferSize)
+    : path(path),
+    buffer(bufferSize)
+{
+    if (bufferSize == 0) {
+        throw std::invalid_argument("[FastqReader] Buffer size must be positive");
+    }
+    // the buffer has to be installed before the file is opened
+    in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    in.open(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("[FastqReader] Unable to open input file: " + path);
+    }
+}
+
+bool FastqReader::readLine(std::string& out) {
+    if (!std::getline(in, out)) {
+        if (in.bad()) {
+            throw std::runtime_error("[FastqReader] Failed reading " + path);
+        }
+        return false;
+    }
+    if (!out.empty() && out.back() == '\r') out.pop_back();
+    return true;
+}
+
+void FastqReader::fail(const char* what) const {
+    throw std::runtime_error(std::string("[FastqReader] ") + what + " in record "
+        + std::to_string(recordCount + 1) + " of " + path);
+}
+
+bool FastqReader::next(FastqRecord& record) {
+    // blank lines between records are tolerated
+    do {
+        if (!readLine(line)) return false;
+    } while (line.empty());
+
+    if (line.front() != '@') {
+        fail("Expected '@' header");
+    }
+    std::size_t nameEnd = line.find_first_of(" \t", 1);
+    record.name.assign(line, 1, nameEnd == std::string::npos ? std::string::npos : nameEnd - 1);
+
+    if (!readLine(record.sequence)) {
+        fail("Missing sequence");
+    }
+    if (!readLine(line) || line.empty() || line.front() != '+') {
+        fail("Expected '+' separator");
+    }
+    if (!readLine(record.quality) || record.quality.size() != record.sequence.size()) {
+        fail("Quality length does not match the sequence");
+    }
+    recordCount++;
+    return true;
+}
+
+std::size_t FastqReader::readBatch(std::vector<FastqRecord>& batch, std::size_t maxRecords) {
+    if (batch.size() < maxRecords) batch.resize(maxRecords);
+    std::size_t count = 0;
+    while (count < maxRecords && next(batch[count])) count++;
+    batch.resize(count);
+    return count;
+}
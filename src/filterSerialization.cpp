@@ -0,0 +1,685 @@
+#include "filterSerialization.h"
+#include "partitionedBloomFilter.h"
+#include "predeterminedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "mm_file/mm_file.hpp"
+
+static_assert(std::endian::native == std::endian::little,
+    "The filter file format is little endian");
+
+namespace {
+constexpr char FILTER_MAGIC[8] = { 'K', 'M', 'E', 'R', 'B', 'L', 'O', 'M' };
+constexpr char CASCADE_MAGIC[8] = { 'K', 'M', 'E', 'R', 'C', 'A', 'S', 'C' };
+constexpr char SHARDED_MAGIC[8] = { 'K', 'M', 'E', 'R', 'S', 'H', 'R', 'D' };
+
+struct FilterHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t hashScheme;
+    uint32_t slotLayout;
+    uint64_t bitArraySize;
+    uint64_t numHashCount;
+    uint64_t chunkCount;
+    uint64_t positionBits;
+    uint64_t partitionSize;
+    uint64_t blockPlaneWidth;
+    uint64_t slotFieldWidth;
+    int64_t seed;
+    uint64_t rejectSelfCollisions;
+    uint64_t numArrays;
+    uint32_t rangeReduction;
+    // BloomFilterOptions::checkBits, stored after the position bits
+    uint32_t checkBits;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(FilterHeader) == 128);
+
+struct ArrayHeader {
+    uint64_t numBits;
+    uint64_t numWords;
+    uint8_t reserved[48];
+};
+static_assert(sizeof(ArrayHeader) == 64);
+
+struct CascadeHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    double falsePositiveRate;
+    int64_t numHash;
+    int64_t positionBits;
+    int64_t seed;
+    uint64_t maxRounds;
+    uint32_t hashScheme;
+    uint32_t slotLayout;
+    uint32_t rejectSelfCollisions;
+    uint32_t rangeReduction;
+    uint32_t sizingMode;
+    uint32_t canonical;
+    double loadFactor;
+    int64_t laterRoundNumHash;
+    uint64_t minElements;
+    uint64_t numKmers;
+    uint64_t numRounds;
+    uint16_t routed;
+    uint16_t routerFingerprintBits;
+    // BloomFilterOptions::checkBits; every round filter holds the same
+    uint32_t checkBits;
+};
+static_assert(sizeof(CascadeHeader) == 128);
+
+struct RoundRecord {
+    uint64_t round;
+    uint64_t attempted;
+    uint64_t inserted;
+    uint64_t shadowed;
+    uint64_t sizedFor;
+    int64_t numHash;
+    uint64_t filterSize;
+    uint64_t memoryBits;
+    double acceptanceRate;
+};
+static_assert(sizeof(RoundRecord) == 72);
+
+struct ShardedHeader {
+    char magic[8];
+    uint32_t version;
+    // ShardRoutingPolicy::Mode
+    uint32_t routingMode;
+    uint64_t numBuckets;
+    uint64_t numShards;
+    uint64_t numKmers;
+    uint32_t minimizerLength;
+    uint8_t reserved[20];
+};
+static_assert(sizeof(ShardedHeader) == 64);
+
+// Writers zero every reserved byte, so a set one is a field this reader
+// does not know about.
+template <std::size_t N>
+void requireZeroReserved(const uint8_t (&reserved)[N]) {
+    for (uint8_t byte : reserved) {
+        if (byte != 0) {
+            throw std::runtime_error("[Serialization] Unknown fields in reserved header bytes");
+        }
+    }
+}
+
+RangeReduction readRangeReduction(uint32_t value) {
+    if (value > static_cast<uint32_t>(RangeReduction::PowerOfTwo)) {
+        throw std::runtime_error("[Serialization] Unknown range reduction " + std::to_string(value));
+    }
+    return static_cast<RangeReduction>(value);
+}
+
+// Checks the header against the geometry the filter constructors build and
+// returns the length in bits every one of its arrays must have, so a
+// corrupt header cannot size the arrays past what probes stay inside.
+uint64_t expectedArrayBits(const FilterHeader& header) {
+    auto fail = [](const std::string& what) {
+        throw std::runtime_error("[Serialization] " + what);
+    };
+    if (header.kind > static_cast<uint32_t>(FilterKind::Blocked)) fail("Unknown filter kind");
+    if (header.hashScheme > static_cast<uint32_t>(HashScheme::EnhancedDoubleHashing)) fail("Unknown hash scheme");
+    if (header.slotLayout > static_cast<uint32_t>(SlotLayout::Interleaved)) fail("Unknown slot layout");
+    bool blocked = header.kind == static_cast<uint32_t>(FilterKind::Blocked);
+    if (blocked != (header.slotLayout == static_cast<uint32_t>(SlotLayout::Blocked))) {
+        fail("Slot layout does not match the filter kind");
+    }
+    if (header.bitArraySize == 0 || header.numHashCount == 0
+        || header.numHashCount > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+        fail("Filter without slots or hash functions");
+    }
+    uint64_t payloadBits = header.positionBits + header.checkBits;
+    if (header.chunkCount != (payloadBits + header.numHashCount - 1) / header.numHashCount) {
+        fail("Chunk count does not match positionBits and numHashCount");
+    }
+    // predetermined filters are partitioned too
+    bool partitioned = header.kind == static_cast<uint32_t>(FilterKind::Partitioned)
+        || header.kind == static_cast<uint32_t>(FilterKind::Predetermined);
+    if (partitioned
+        && (header.partitionSize == 0 || header.partitionSize > header.bitArraySize / header.numHashCount)) {
+        fail("Partition size does not fit the filter");
+    }
+
+    switch (static_cast<SlotLayout>(header.slotLayout)) {
+    case SlotLayout::Blocked:
+        if (header.bitArraySize % BlockedBloomFilter::BLOCK_BITS != 0
+            || header.blockPlaneWidth != BlockedBloomFilter::BLOCK_BITS / (header.chunkCount + 1)
+            || header.blockPlaneWidth < header.numHashCount) {
+            fail("Block geometry does not match the chunk count");
+        }
+        return header.bitArraySize;
+    case SlotLayout::Interleaved:
+        if (header.slotFieldWidth != header.chunkCount + 1 || header.slotFieldWidth > 57
+            || header.bitArraySize > (UINT64_MAX - PackedBitset::WORD_BITS) / header.slotFieldWidth) {
+            fail("Slot field width does not match the chunk count");
+        }
+        return header.bitArraySize * header.slotFieldWidth + PackedBitset::WORD_BITS;
+    default:
+        return header.bitArraySize;
+    }
+}
+
+// Checks a cascade header against what the BloomFilterCascade constructor
+// accepts, so a corrupt file fails with a serialization error instead of
+// an out-of-range enum or width.
+void validateCascadeHeader(const CascadeHeader& header) {
+    auto fail = [](const std::string& what) {
+        throw std::runtime_error("[Serialization] " + what);
+    };
+    constexpr auto INT_LIMIT = static_cast<int64_t>(std::numeric_limits<int>::max());
+    if (header.kind > static_cast<uint32_t>(FilterKind::Blocked)) fail("Unknown filter kind");
+    if (header.hashScheme > static_cast<uint32_t>(HashScheme::EnhancedDoubleHashing)) fail("Unknown hash scheme");
+    if (header.slotLayout > static_cast<uint32_t>(SlotLayout::Interleaved)) fail("Unknown slot layout");
+    if (header.sizingMode > static_cast<uint32_t>(CascadeSizingPolicy::Mode::Adaptive)) fail("Unknown sizing mode");
+    if (header.positionBits <= 0 || header.positionBits >= (header.canonical ? 63 : 64)) {
+        fail("Cascade positionBits out of range");
+    }
+    if (header.numHash < 0 || header.numHash > INT_LIMIT
+        || header.laterRoundNumHash < 0 || header.laterRoundNumHash > INT_LIMIT) {
+        fail("Cascade hash count out of range");
+    }
+    if (header.seed < std::numeric_limits<int>::min() || header.seed > INT_LIMIT) {
+        fail("Cascade seed out of range");
+    }
+    if (header.maxRounds == 0 || header.numRounds > header.maxRounds) {
+        fail("Cascade round count out of range");
+    }
+    if (!(header.loadFactor > 0.0)) fail("Cascade load factor must be positive");
+    if (header.routed && header.routerFingerprintBits > 32) fail("Router fingerprint width out of range");
+    if (header.checkBits > static_cast<uint64_t>(64 - header.positionBits - (header.canonical ? 1 : 0))) {
+        fail("Cascade checkBits do not fit next to the position bits");
+    }
+}
+}
+
+// ------------------ Writer / Reader ------------------ //
+class FilterSerializer::Writer {
+public:
+    explicit Writer(const std::string& path)
+        : out(path, std::ios::binary | std::ios::trunc) {
+        if (!out.is_open()) {
+            throw std::runtime_error("[Serialization] Unable to open output file: " + path);
+        }
+    }
+
+    void write(const void* data, std::size_t bytes) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        offset += bytes;
+    }
+
+    // Zero padding up to the next section boundary.
+    void align() {
+        static const char zeros[SECTION_ALIGNMENT] = {};
+        std::size_t padding = (SECTION_ALIGNMENT - offset % SECTION_ALIGNMENT) % SECTION_ALIGNMENT;
+        write(zeros, padding);
+    }
+
+    void close() {
+        out.close();
+        if (out.fail()) {
+            throw std::runtime_error("[Serialization] Failed writing filter file");
+        }
+    }
+
+private:
+    std::ofstream out;
+    std::size_t offset = 0;
+};
+
+class FilterSerializer::Reader {
+public:
+    Reader(const uint8_t* data, std::size_t size) : data(data), size(size) {}
+
+    const uint8_t* take(std::size_t bytes) {
+        if (bytes > size - offset) {
+            throw std::runtime_error("[Serialization] Truncated filter file");
+        }
+        const uint8_t* start = data + offset;
+        offset += bytes;
+        return start;
+    }
+
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    void align() {
+        std::size_t padding = (SECTION_ALIGNMENT - offset % SECTION_ALIGNMENT) % SECTION_ALIGNMENT;
+        take(padding);
+    }
+
+    std::size_t remaining() const { return size - offset; }
+
+private:
+    const uint8_t* data;
+    std::size_t size;
+    std::size_t offset = 0;
+};
+
+// ------------------ Filters ------------------ //
+void FilterSerializer::writeFilterSection(Writer& writer, const BloomFilter& filter, int seed) {
+    FilterParameters params = filter.getParameters();
+
+    FilterHeader header{};
+    std::memcpy(header.magic, FILTER_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.kind = static_cast<uint32_t>(params.kind);
+    header.hashScheme = static_cast<uint32_t>(params.hashScheme);
+    header.slotLayout = static_cast<uint32_t>(params.slotLayout);
+    header.bitArraySize = params.bitArraySize;
+    header.numHashCount = params.numHashCount;
+    header.chunkCount = params.chunkCount;
+    header.positionBits = params.positionBits;
+    header.partitionSize = params.partitionSize;
+    header.blockPlaneWidth = params.blockPlaneWidth;
+    header.slotFieldWidth = params.slotFieldWidth;
+    header.seed = seed;
+    header.rejectSelfCollisions = params.rejectSelfCollisions;
+    header.rangeReduction = static_cast<uint32_t>(params.rangeReduction);
+    header.checkBits = static_cast<uint32_t>(params.checkBits);
+    header.numArrays = 1 + filter.positionBitsets.size();
+    writer.write(&header, sizeof(header));
+
+    auto writeArray = [&writer](const PackedBitset& bits) {
+        ArrayHeader arrayHeader{};
+        arrayHeader.numBits = bits.size();
+        arrayHeader.numWords = PackedBitset::storageWordsFor(bits.size());
+        writer.write(&arrayHeader, sizeof(arrayHeader));
+        writer.write(bits.data(), arrayHeader.numWords * sizeof(uint64_t));
+    };
+    writeArray(filter.presenceBitset);
+    for (const auto& plane : filter.positionBitsets) {
+        writeArray(plane);
+    }
+    writer.align();
+}
+
+StoredFilter FilterSerializer::readFilterSection(Reader& reader, const std::shared_ptr<const void>& mapping) {
+    auto header = reader.read<FilterHeader>();
+    if (std::memcmp(header.magic, FILTER_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("[Serialization] Not a filter file");
+    }
+    if (header.version != FORMAT_VERSION) {
+        throw std::runtime_error("[Serialization] Unsupported filter format version "
+            + std::to_string(header.version));
+    }
+    requireZeroReserved(header.reserved);
+
+    FilterParameters params;
+    params.kind = static_cast<FilterKind>(header.kind);
+    params.hashScheme = static_cast<HashScheme>(header.hashScheme);
+    params.slotLayout = static_cast<SlotLayout>(header.slotLayout);
+    params.bitArraySize = header.bitArraySize;
+    params.numHashCount = header.numHashCount;
+    params.chunkCount = header.chunkCount;
+    params.positionBits = header.positionBits;
+    params.partitionSize = header.partitionSize;
+    params.blockPlaneWidth = header.blockPlaneWidth;
+    params.slotFieldWidth = header.slotFieldWidth;
+    params.rejectSelfCollisions = header.rejectSelfCollisions != 0;
+    params.rangeReduction = readRangeReduction(header.rangeReduction);
+    params.checkBits = header.checkBits;
+    if (header.positionBits > 64 || header.checkBits > 64 - header.positionBits) {
+        throw std::runtime_error("[Serialization] positionBits + checkBits exceed 64");
+    }
+    uint64_t arrayBits = expectedArrayBits(header);
+
+    std::unique_ptr<BloomFilter> filter;
+    switch (params.kind) {
+    case FilterKind::Standard:
+        filter.reset(new BloomFilter(params));
+        break;
+    case FilterKind::Partitioned:
+        filter = std::make_unique<PartitionedBloomFilter>(params);
+        break;
+    case FilterKind::Predetermined:
+        filter = std::make_unique<PredeterminedHashBloomFilter>(params);
+        break;
+    case FilterKind::Blocked:
+        filter = std::make_unique<BlockedBloomFilter>(params);
+        break;
+    default:
+        throw std::runtime_error("[Serialization] Unknown filter kind");
+    }
+
+    std::size_t expectedArrays = params.slotLayout == SlotLayout::Planar ? 1 + params.chunkCount : 1;
+    if (header.numArrays != expectedArrays) {
+        throw std::runtime_error("[Serialization] Bit array count does not match the layout");
+    }
+
+    auto readArray = [&reader, &mapping, arrayBits]() {
+        auto arrayHeader = reader.read<ArrayHeader>();
+        if (arrayHeader.numBits != arrayBits
+            || arrayHeader.numWords != PackedBitset::storageWordsFor(arrayHeader.numBits)) {
+            throw std::runtime_error("[Serialization] Bit array length does not match the filter geometry");
+        }
+        if (arrayHeader.numWords > reader.remaining() / sizeof(uint64_t)) {
+            throw std::runtime_error("[Serialization] Truncated filter file");
+        }
+        requireZeroReserved(arrayHeader.reserved);
+        const uint8_t* words = reader.take(arrayHeader.numWords * sizeof(uint64_t));
+        if (mapping) {
+            return PackedBitset::view(reinterpret_cast<const uint64_t*>(words), arrayHeader.numBits);
+        }
+        PackedBitset bits(arrayHeader.numBits);
+        std::memcpy(bits.data(), words, arrayHeader.numWords * sizeof(uint64_t));
+        return bits;
+    };
+
+    filter->presenceBitset = readArray();
+    filter->positionBitsets.clear();
+    for (uint64_t a = 1; a < header.numArrays; a++) {
+        filter->positionBitsets.push_back(readArray());
+    }
+    if (mapping) {
+        filter->readOnly = true;
+        filter->backing = mapping;
+    }
+    reader.align();
+
+    return { std::move(filter), static_cast<int>(header.seed) };
+}
+
+void FilterSerializer::saveFilter(const BloomFilter& filter, const std::string& path, int seed) {
+    Writer writer(path);
+    writeFilterSection(writer, filter, seed);
+    writer.close();
+}
+
+// Reads a whole file into memory for the copying load path.
+static std::vector<uint8_t> readWholeFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("[Serialization] Unable to open input file: " + path);
+    }
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static std::shared_ptr<mm::file_source<uint8_t>> mapWholeFile(const std::string& path) {
+    // queries probe random lines, so readahead would only waste page cache
+    return std::make_shared<mm::file_source<uint8_t>>(path, mm::advice::random);
+}
+
+StoredFilter FilterSerializer::loadFilter(const std::string& path) {
+    std::vector<uint8_t> bytes = readWholeFile(path);
+    Reader reader(bytes.data(), bytes.size());
+    return readFilterSection(reader, nullptr);
+}
+
+StoredFilter FilterSerializer::mapFilter(const std::string& path) {
+    auto file = mapWholeFile(path);
+    Reader reader(file->data(), file->bytes());
+    return readFilterSection(reader, file);
+}
+
+// ------------------ Cascades ------------------ //
+void FilterSerializer::saveCascade(const BloomFilterCascade& cascade, const std::string& path) {
+    Writer writer(path);
+    writeCascadeSection(writer, cascade);
+    writer.close();
+}
+
+void FilterSerializer::writeCascadeSection(Writer& writer, const BloomFilterCascade& cascade) {
+    const CascadeConfig& config = cascade.config;
+
+    CascadeHeader header{};
+    std::memcpy(header.magic, CASCADE_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.kind = static_cast<uint32_t>(config.kind);
+    header.falsePositiveRate = config.falsePositiveRate;
+    header.numHash = config.numHash;
+    header.positionBits = config.positionBits;
+    header.seed = config.seed;
+    header.maxRounds = config.maxRounds;
+    header.hashScheme = static_cast<uint32_t>(config.options.hashScheme);
+    header.slotLayout = static_cast<uint32_t>(config.options.slotLayout);
+    header.rejectSelfCollisions = config.options.rejectSelfCollisions;
+    header.rangeReduction = static_cast<uint32_t>(config.options.rangeReduction);
+    header.sizingMode = static_cast<uint32_t>(config.sizing.mode);
+    header.canonical = config.canonical;
+    header.loadFactor = config.sizing.loadFactor;
+    header.laterRoundNumHash = config.sizing.laterRoundNumHash;
+    header.minElements = config.sizing.minElements;
+    header.numKmers = cascade.numKmers;
+    header.numRounds = cascade.rounds.size();
+    header.routed = cascade.router != nullptr;
+    header.routerFingerprintBits = static_cast<uint16_t>(config.routerFingerprintBits);
+    header.checkBits = static_cast<uint32_t>(config.options.checkBits);
+
+    writer.write(&header, sizeof(header));
+    for (const auto& stats : cascade.stats) {
+        RoundRecord record{
+            stats.round, stats.attempted, stats.inserted, stats.shadowed, stats.sizedFor,
+            stats.numHash, stats.filterSize, stats.memoryBits, stats.acceptanceRate
+        };
+        writer.write(&record, sizeof(record));
+    }
+    writer.align();
+
+    for (std::size_t r = 0; r < cascade.rounds.size(); r++) {
+        writeFilterSection(writer, *cascade.rounds[r], cascade.getRoundSeed(r));
+    }
+
+    // router: its byte length, then the index in pthash's own layout
+    if (cascade.router) {
+        std::ostringstream routerBytes(std::ios::binary);
+        cascade.router->save(routerBytes);
+        std::string bytes = routerBytes.str();
+        uint64_t length = bytes.size();
+        writer.align();
+        writer.write(&length, sizeof(length));
+        writer.write(bytes.data(), bytes.size());
+        writer.align();
+    }
+}
+
+BloomFilterCascade FilterSerializer::readCascade(Reader& reader, const std::shared_ptr<const void>& mapping) {
+    auto header = reader.read<CascadeHeader>();
+    if (std::memcmp(header.magic, CASCADE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("[Serialization] Not a cascade file");
+    }
+    if (header.version != FORMAT_VERSION) {
+        throw std::runtime_error("[Serialization] Unsupported cascade format version "
+            + std::to_string(header.version));
+    }
+    validateCascadeHeader(header);
+
+    CascadeConfig config;
+    config.kind = static_cast<FilterKind>(header.kind);
+    config.falsePositiveRate = header.falsePositiveRate;
+    config.numHash = static_cast<int>(header.numHash);
+    config.positionBits = static_cast<int>(header.positionBits);
+    config.seed = static_cast<int>(header.seed);
+    config.maxRounds = header.maxRounds;
+    config.options.hashScheme = static_cast<HashScheme>(header.hashScheme);
+    config.options.slotLayout = static_cast<SlotLayout>(header.slotLayout);
+    config.options.rejectSelfCollisions = header.rejectSelfCollisions != 0;
+    config.options.rangeReduction = readRangeReduction(header.rangeReduction);
+    config.sizing.mode = static_cast<CascadeSizingPolicy::Mode>(header.sizingMode);
+    config.canonical = header.canonical != 0;
+    config.sizing.loadFactor = header.loadFactor;
+    config.sizing.laterRoundNumHash = static_cast<int>(header.laterRoundNumHash);
+    config.sizing.minElements = header.minElements;
+    config.routed = header.routed != 0;
+    config.routerFingerprintBits = static_cast<int>(header.routerFingerprintBits);
+    config.options.checkBits = static_cast<int>(header.checkBits);
+
+    BloomFilterCascade cascade(config);
+    cascade.numKmers = header.numKmers;
+    for (uint64_t r = 0; r < header.numRounds; r++) {
+        auto record = reader.read<RoundRecord>();
+        cascade.stats.push_back({
+            record.round, record.attempted, record.inserted, record.shadowed, record.sizedFor,
+            static_cast<int>(record.numHash), record.filterSize, record.memoryBits, record.acceptanceRate
+            });
+    }
+    reader.align();
+
+    for (uint64_t r = 0; r < header.numRounds; r++) {
+        StoredFilter round = readFilterSection(reader, mapping);
+        if (round.seed != cascade.getRoundSeed(r)) {
+            throw std::runtime_error("[Serialization] Round seed does not match the cascade seed");
+        }
+        // rounds carry the strand bit next to the position in canonical mode
+        std::size_t storedBits = static_cast<std::size_t>(config.positionBits) + (config.canonical ? 1 : 0);
+        if (round.filter->getParameters().kind != config.kind || round.filter->getPositionBits() != storedBits) {
+            throw std::runtime_error("[Serialization] Round filter does not match the cascade config");
+        }
+        if (round.filter->getCheckBits() != header.checkBits) {
+            throw std::runtime_error("[Serialization] Round check bits do not match the cascade");
+        }
+        cascade.rounds.push_back(std::move(round.filter));
+    }
+
+    // the router is small next to the rounds, so it is always copied
+    if (header.routed) {
+        reader.align();
+        auto length = reader.read<uint64_t>();
+        const uint8_t* bytes = reader.take(length);
+        std::istringstream routerBytes(std::string(reinterpret_cast<const char*>(bytes), length),
+            std::ios::binary);
+        cascade.router = std::make_unique<MphPositionIndex>();
+        cascade.router->load(routerBytes);
+    }
+    return cascade;
+}
+
+BloomFilterCascade FilterSerializer::loadCascade(const std::string& path) {
+    std::vector<uint8_t> bytes = readWholeFile(path);
+    Reader reader(bytes.data(), bytes.size());
+    return readCascade(reader, nullptr);
+}
+
+BloomFilterCascade FilterSerializer::mapCascade(const std::string& path) {
+    auto file = mapWholeFile(path);
+    Reader reader(file->data(), file->bytes());
+    return readCascade(reader, file);
+}
+
+// ------------------ Sharded Cascades ------------------ //
+FilterSerializer::ShardWriter::ShardWriter(const std::string& path, const std::vector<uint32_t>& bucketShards,
+    uint64_t numKmers, const ShardRoutingPolicy& routing)
+    : writer(std::make_unique<Writer>(path)),
+    numShards(bucketShards.empty() ? 0 : bucketShards.back() + std::size_t{ 1 })
+{
+    if (numShards == 0) {
+        throw std::invalid_argument("[Serialization] A sharded cascade needs at least one bucket");
+    }
+    ShardedHeader header{};
+    std::memcpy(header.magic, SHARDED_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.numBuckets = bucketShards.size();
+    header.numShards = numShards;
+    header.numKmers = numKmers;
+    header.routingMode = static_cast<uint32_t>(routing.mode);
+    header.minimizerLength = routing.minimizerLength;
+    writer->write(&header, sizeof(header));
+    writer->write(bucketShards.data(), bucketShards.size() * sizeof(uint32_t));
+    writer->align();
+}
+
+FilterSerializer::ShardWriter::~ShardWriter() = default;
+
+void FilterSerializer::ShardWriter::append(const BloomFilterCascade& shard) {
+    if (written == numShards) {
+        throw std::logic_error("[Serialization] More shards appended than the bucket table names");
+    }
+    writeCascadeSection(*writer, shard);
+    written++;
+}
+
+void FilterSerializer::ShardWriter::close() {
+    if (written != numShards) {
+        throw std::logic_error("[Serialization] Sharded cascade closed with "
+            + std::to_string(numShards - written) + " shards missing");
+    }
+    writer->close();
+}
+
+void FilterSerializer::saveShardedCascade(const ShardedCascade& index, const std::string& path) {
+    ShardWriter writer(path, index.bucketShards, index.kmerCount, index.routing);
+    for (const auto& shard : index.shards) {
+        writer.append(shard);
+    }
+    writer.close();
+}
+
+ShardedCascade FilterSerializer::readShardedCascade(Reader& reader, const std::shared_ptr<const void>& mapping) {
+    auto header = reader.read<ShardedHeader>();
+    if (std::memcmp(header.magic, SHARDED_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("[Serialization] Not a sharded cascade file");
+    }
+    if (header.version != FORMAT_VERSION) {
+        throw std::runtime_error("[Serialization] Unsupported sharded cascade format version "
+            + std::to_string(header.version));
+    }
+    requireZeroReserved(header.reserved);
+    if (header.numShards == 0 || header.numBuckets == 0) {
+        throw std::runtime_error("[Serialization] Sharded cascade without shards");
+    }
+    ShardRoutingPolicy routing;
+    if (header.routingMode > static_cast<uint32_t>(ShardRoutingPolicy::Mode::Minimizer)) {
+        throw std::runtime_error("[Serialization] Unknown shard routing mode");
+    }
+    routing.mode = static_cast<ShardRoutingPolicy::Mode>(header.routingMode);
+    if (routing.mode == ShardRoutingPolicy::Mode::Minimizer) {
+        if (header.minimizerLength == 0 || header.minimizerLength > 32) {
+            throw std::runtime_error("[Serialization] Invalid minimizer length");
+        }
+        routing.minimizerLength = header.minimizerLength;
+    }
+
+    if (header.numBuckets > reader.remaining() / sizeof(uint32_t)) {
+        throw std::runtime_error("[Serialization] Truncated sharded cascade file");
+    }
+    std::vector<uint32_t> bucketShards(header.numBuckets);
+    std::memcpy(bucketShards.data(), reader.take(header.numBuckets * sizeof(uint32_t)),
+        header.numBuckets * sizeof(uint32_t));
+    reader.align();
+    for (std::size_t b = 0; b < bucketShards.size(); b++) {
+        uint32_t previous = b == 0 ? 0 : bucketShards[b - 1];
+        if (bucketShards[b] < previous || bucketShards[b] > previous + 1 || bucketShards[b] >= header.numShards) {
+            throw std::runtime_error("[Serialization] Corrupt bucket table");
+        }
+    }
+
+    std::vector<BloomFilterCascade> shards;
+    shards.reserve(header.numShards);
+    for (uint64_t s = 0; s < header.numShards; s++) {
+        shards.push_back(readCascade(reader, mapping));
+        // a routed section ends with padding readCascade leaves unread
+        reader.align();
+    }
+
+    ShardedCascade index(shards.front().getConfig(), routing);
+    index.bucketShards = std::move(bucketShards);
+    index.shards = std::move(shards);
+    index.kmerCount = header.numKmers;
+    return index;
+}
+
+ShardedCascade FilterSerializer::loadShardedCascade(const std::string& path) {
+    std::vector<uint8_t> bytes = readWholeFile(path);
+    Reader reader(bytes.data(), bytes.size());
+    return readShardedCascade(reader, nullptr);
+}
+
+ShardedCascade FilterSerializer::mapShardedCascade(const std::string& path) {
+    auto file = mapWholeFile(path);
+    Reader reader(file->data(), file->bytes());
+    return readShardedCascade(reader, file);
+}
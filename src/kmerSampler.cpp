@@ -0,0 +1,141 @@
+#include "kmerSampler.h"
+#include "packedKmer.h"
+#include <stdexcept>
+
+namespace {
+// Reverse complement of an s-mer of s <= 32 bases packed in the low bits.
+uint64_t reverseComplementSmer(uint64_t bits, unsigned s) {
+    uint64_t x = byteSwap64(~bits);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    return x >> (64 - 2 * s);
+}
+}
+
+KmerSampler::KmerSampler(unsigned k, SamplingConfig config)
+    : k(k), config(config)
+{
+    if (k == 0 || k > RollingKmerHasher::MAX_K) {
+        throw std::invalid_argument("[KmerSampler] k must be in [1, 64]");
+    }
+    switch (config.scheme) {
+    case SamplingScheme::All:
+        break;
+    case SamplingScheme::Minimizer:
+        if (config.w == 0) {
+            throw std::invalid_argument("[KmerSampler] Minimizer window must be positive");
+        }
+        window.init(config.w);
+        break;
+    case SamplingScheme::OpenSyncmer:
+    case SamplingScheme::ClosedSyncmer:
+        if (config.s == 0 || config.s >= k || config.s > 32) {
+            throw std::invalid_argument("[KmerSampler] Syncmer s must be in [1, min(k - 1, 32)]");
+        }
+        if (config.scheme == SamplingScheme::OpenSyncmer && config.t > k - config.s) {
+            throw std::invalid_argument("[KmerSampler] Open syncmer offset t must be at most k - s");
+        }
+        window.init(k - config.s + 1);
+        break;
+    }
+}
+
+std::size_t KmerSampler::maxDelay() const {
+    return config.scheme == SamplingScheme::Minimizer ? config.w - 1 : 0;
+}
+
+std::size_t KmerSampler::push(uint64_t hash, uint64_t canonicalHash, uint128 packed) {
+    stats.kmers++;
+    std::size_t sampled;
+    switch (config.scheme) {
+    case SamplingScheme::Minimizer:
+        sampled = pushMinimizer(config.canonical ? canonicalHash : hash);
+        break;
+    case SamplingScheme::OpenSyncmer:
+    case SamplingScheme::ClosedSyncmer:
+        sampled = pushSyncmer(packed);
+        break;
+    default:
+        sampled = runLength;
+        break;
+    }
+    runLength++;
+    if (sampled != NONE) stats.sampled++;
+    return sampled;
+}
+
+std::size_t KmerSampler::endRun() {
+    std::size_t sampled = NONE;
+    // no window was ever complete, so nothing of this run was sampled yet
+    if (config.scheme == SamplingScheme::Minimizer && runLength > 0 && runLength < config.w) {
+        sampled = window.frontIndex();
+        stats.sampled++;
+    }
+    if (runLength > 0) stats.bases += runLength + k - 1;
+    runLength = 0;
+    lastSampled = NONE;
+    window.clear();
+    return sampled;
+}
+
+// ------------------ Schemes ------------------ //
+std::size_t KmerSampler::pushMinimizer(uint64_t hash) {
+    const std::size_t j = runLength;
+    if (j >= config.w) window.evictBefore(j + 1 - config.w);
+    // ntHash is linear in the bases, so it is mixed before being used as
+    // an order
+    window.push(mix64(hash), j);
+    if (j + 1 < config.w) return NONE;
+
+    std::size_t minimizer = window.frontIndex();
+    if (minimizer == lastSampled) return NONE;
+    lastSampled = minimizer;
+    return minimizer;
+}
+
+std::size_t KmerSampler::pushSyncmer(uint128 packed) {
+    const std::size_t j = runLength;
+    const unsigned last = k - config.s;
+    // s-mers are indexed by their offset in the run; k-mer j holds
+    // s-mers j .. j + last, and only the last one is new after the first
+    if (j == 0) {
+        for (unsigned i = 0; i <= last; i++) window.push(smerHash(packed, i), i);
+    }
+    else {
+        window.evictBefore(j);
+        window.push(smerHash(packed, last), j + last);
+    }
+
+    std::size_t smallest = window.frontIndex() - j;
+    bool sampled = config.scheme == SamplingScheme::OpenSyncmer
+        ? smallest == config.t
+        : smallest == 0 || smallest == last;
+    return sampled ? j : NONE;
+}
+
+uint64_t KmerSampler::smerHash(uint128 packed, unsigned offset) const {
+    const unsigned s = config.s;
+    uint64_t mask = s == 32 ? ~0ULL : ((1ULL << (2 * s)) - 1);
+    auto bits = static_cast<uint64_t>(packed >> (2 * (k - s - offset))) & mask;
+    if (config.canonical) {
+        uint64_t rc = reverseComplementSmer(bits, s);
+        if (rc < bits) bits = rc;
+    }
+    return mix64(bits + 0x9e3779b97f4a7c15ULL * s);
+}
+
+// ------------------ MinWindow ------------------ //
+void KmerSampler::MinWindow::push(uint64_t value, std::size_t index) {
+    const std::size_t capacity = entries.size();
+    // later entries win ties only once the earlier one leaves the window
+    while (count > 0 && entries[(head + count - 1) % capacity].value > value) count--;
+    entries[(head + count) % capacity] = { value, index };
+    count++;
+}
+
+void KmerSampler::MinWindow::evictBefore(std::size_t index) {
+    while (count > 0 && entries[head].index < index) {
+        head = (head + 1) % entries.size();
+        count--;
+    }
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "mphPositionIndex.h"
+#include "bloomFilterCascade.h"
+
+std::vector<std::string> readFileLines(const std::string& filepath) {
+    std::vector<std::string> lines;
+    std::ifstream inFile(filepath);
+    if (!inFile.is_open()) {
+        throw std::runtime_error("Unable to open input file: " + filepath);
+    }
+
+    std::string line;
+    while (std::getline(inFile, line)) {
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    inFile.close();
+    return lines;
+}
+
+// Average nanoseconds per lookup over every k-mer, plus the number of k-mers
+// that did not decode to their own index.
+template <typename Index>
+std::pair<double, std::size_t> timeLookups(const Index& index, const std::vector<std::string>& kmers) {
+    std::vector<uint64_t> positions(kmers.size());
+    auto start = std::chrono::steady_clock::now();
+    index.lookupBatch(kmers, positions);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        if (positions[i] != i) mismatches++;
+    }
+    double nanos = std::chrono::duration<double, std::nano>(elapsed).count();
+    return { nanos / kmers.size(), mismatches };
+}
+
+int main() {
+    try {
+        const std::string uniqueKmersPath = "/mnt/d/Research/Capstone_v2/test_files/unique_37mers_1000.txt";
+
+        std::vector<std::string> kmers = readFileLines(uniqueKmersPath);
+
+        MphConfig mphConfig;
+        mphConfig.fingerprintBits = 10;
+        mphConfig.numThreads = std::max(1u, std::thread::hardware_concurrency());
+        mphConfig.partitioned = kmers.size() > 1000000;
+        mphConfig.seed = 42;
+
+        MphPositionIndex index(mphConfig);
+        index.build(kmers);
+        auto [mphNanos, mphMismatches] = timeLookups(index, kmers);
+
+        std::cout << "MPH index: " << index.getBitsPerKmer() << " bits/k-mer ("
+            << static_cast<double>(index.getFunctionBits()) / kmers.size() << " for the function, "
+            << index.getPositionBits() << " position bits, "
+            << mphConfig.fingerprintBits << " fingerprint bits), "
+            << mphNanos << " ns/lookup, " << mphMismatches << " lookup mismatches.\n";
+
+        CascadeConfig cascadeConfig;
+        cascadeConfig.kind = FilterKind::Partitioned;
+        cascadeConfig.falsePositiveRate = 0.001;
+        cascadeConfig.positionBits = index.getPositionBits();
+        cascadeConfig.seed = 42;
+
+        BloomFilterCascade cascade(cascadeConfig);
+        cascade.build(kmers);
+        auto [cascadeNanos, cascadeMismatches] = timeLookups(cascade, kmers);
+
+        std::cout << "Bloom cascade: " << cascade.getBitsPerKmer() << " bits/k-mer in "
+            << cascade.numRounds() << " rounds, "
+            << cascadeNanos << " ns/lookup, " << cascadeMismatches << " lookup mismatches.\n"
+            << "Press ENTER to exit.\n";
+        std::cin.get();
+
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
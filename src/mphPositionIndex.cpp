@@ -0,0 +1,251 @@
+#include "mphPositionIndex.h"
+#include "intrinsics.h"
+#include <algorithm>
+#include <bit>
+#include <istream>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+// Fresh seeds tried when pthash cannot find pilots for the configured one.
+constexpr int MAX_SEED_ATTEMPTS = 10;
+constexpr uint64_t SEED_STRIDE = 0x9E3779B97F4A7C15ULL;
+constexpr uint64_t DEFAULT_PARTITION_SIZE = 100000;
+}
+
+MphPositionIndex::MphPositionIndex(MphConfig config)
+    : config(config)
+{
+    if (config.positionBits < 0 || config.positionBits >= 64) {
+        throw std::invalid_argument("[MPH] positionBits must be in [0, 63]");
+    }
+    if (config.fingerprintBits < 0 || config.positionBits + config.fingerprintBits > 64) {
+        throw std::invalid_argument("[MPH] positionBits + fingerprintBits must not exceed 64");
+    }
+    if (config.numThreads == 0) {
+        throw std::invalid_argument("[MPH] numThreads must be positive");
+    }
+}
+
+// ------------------ Construction ------------------ //
+void MphPositionIndex::build(const std::vector<std::string>& kmers) {
+    std::vector<uint64_t> positions(kmers.size());
+    std::iota(positions.begin(), positions.end(), 0ULL);
+    build(kmers, positions);
+}
+
+void MphPositionIndex::build(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions) {
+    if (kmers.size() != positions.size()) {
+        throw std::invalid_argument("[MPH] Every k-mer needs exactly one position");
+    }
+    if (kmers.empty()) {
+        throw std::invalid_argument("[MPH] Cannot build an index over no k-mers");
+    }
+
+    uint64_t maxPosition = *std::max_element(positions.begin(), positions.end());
+    int neededBits = std::max(1, static_cast<int>(std::bit_width(maxPosition)));
+    if (config.positionBits == 0) {
+        // the same [1, 63] an explicit width is held to, so a position mask
+        // and the fingerprint shift stay below 64
+        if (neededBits > 63) {
+            throw std::invalid_argument("[MPH] Positions must fit in 63 bits");
+        }
+        positionBits = neededBits;
+    }
+    else if (neededBits > config.positionBits) {
+        throw std::invalid_argument("[MPH] Position does not fit in positionBits");
+    }
+    else {
+        positionBits = config.positionBits;
+    }
+    if (positionBits + config.fingerprintBits > 64) {
+        throw std::invalid_argument("[MPH] positionBits + fingerprintBits must not exceed 64");
+    }
+
+    pthash::build_configuration buildConfig;
+    buildConfig.lambda = config.lambda;
+    buildConfig.alpha = config.alpha;
+    buildConfig.minimal = true;
+    buildConfig.search = pthash::pthash_search_type::xor_displacement;
+    buildConfig.num_threads = config.numThreads;
+    buildConfig.tmp_dir = config.tmpDir;
+    if (config.ramBytes > 0) buildConfig.ram = config.ramBytes;
+    buildConfig.verbose = false;
+    if (config.partitioned) {
+        buildConfig.avg_partition_size = config.avgPartitionSize > 0
+            ? config.avgPartitionSize
+            : DEFAULT_PARTITION_SIZE;
+    }
+
+    // a fixed seed keeps builds reproducible; only a failed search moves on
+    for (int attempt = 0;; attempt++) {
+        buildConfig.seed = config.seed + attempt * SEED_STRIDE;
+        try {
+            auto buildWith = [&](auto& f) {
+                if (config.externalMemory) {
+                    f.build_in_external_memory(kmers.begin(), kmers.size(), buildConfig);
+                }
+                else {
+                    f.build_in_internal_memory(kmers.begin(), kmers.size(), buildConfig);
+                }
+            };
+            if (config.partitioned) {
+                buildWith(function.emplace<PartitionedFunction>());
+            }
+            else {
+                buildWith(function.emplace<SingleFunction>());
+            }
+            break;
+        }
+        catch (const pthash::seed_runtime_error&) {
+            if (attempt + 1 == MAX_SEED_ATTEMPTS) {
+                throw std::runtime_error("[MPH] Failed to build the function; are the k-mers distinct?");
+            }
+        }
+    }
+    seed = buildConfig.seed;
+    numKmers = kmers.size();
+
+    int width = positionBits + config.fingerprintBits;
+    bits::compact_vector::builder entries(kmers.size(), width);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        pthash::hash128 hash = hashKmer(kmers[i]);
+        entries.set(slotFor(hash), (fingerprintOf(hash) << positionBits) | positions[i]);
+    }
+    entries.build(values);
+}
+
+// ------------------ Hashing ------------------ //
+pthash::hash128 MphPositionIndex::hashKmer(const std::string& kmer) const {
+    return pthash::xxhash128::hash(kmer, seed);
+}
+
+uint64_t MphPositionIndex::slotFor(const pthash::hash128& hash) const {
+    return std::visit([&hash](const auto& f) { return f.position(hash); }, function);
+}
+
+// The function consumes first() and second() separately (and mix() for the
+// partition), so the fingerprint mixes a different combination of both.
+uint64_t MphPositionIndex::fingerprintOf(const pthash::hash128& hash) const {
+    if (config.fingerprintBits == 0) return 0;
+    uint64_t mixed = pthash::hash64(hash.first() * SEED_STRIDE + hash.second()).mix();
+    return mixed >> (64 - config.fingerprintBits);
+}
+
+uint64_t MphPositionIndex::resolve(const pthash::hash128& hash, uint64_t slot) const {
+    // word-aligned read; access() loads 64 bits at a byte offset, which
+    // is misaligned and drops the top bits of entries wider than 57 bits
+    uint64_t entry = values[slot];
+    if ((entry >> positionBits) != fingerprintOf(hash)) {
+        return NOT_FOUND;
+    }
+    return entry & ((1ULL << positionBits) - 1);
+}
+
+// ------------------ Queries ------------------ //
+uint64_t MphPositionIndex::lookup(const std::string& kmer) const {
+    if (numKmers == 0) return NOT_FOUND;
+    pthash::hash128 hash = hashKmer(kmer);
+    return resolve(hash, slotFor(hash));
+}
+
+void MphPositionIndex::lookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const {
+    if (out.size() != kmers.size()) {
+        throw std::invalid_argument("[MPH] Batch output size must match the number of k-mers");
+    }
+    if (numKmers == 0) {
+        std::fill(out.begin(), out.end(), NOT_FOUND);
+        return;
+    }
+
+    const uint64_t* words = values.data().data();
+    const uint64_t width = values.width();
+    pthash::hash128 hashes[BATCH_BLOCK];
+    uint64_t slots[BATCH_BLOCK];
+    for (std::size_t begin = 0; begin < kmers.size(); begin += BATCH_BLOCK) {
+        std::size_t count = std::min(BATCH_BLOCK, kmers.size() - begin);
+
+        // pass 1: evaluate the function and issue loads for the packed entries
+        for (std::size_t j = 0; j < count; j++) {
+            hashes[j] = hashKmer(kmers[begin + j]);
+            slots[j] = slotFor(hashes[j]);
+            prefetchRead(words + ((slots[j] * width) >> 6));
+        }
+
+        // pass 2: read the entries, which should now be in cache
+        for (std::size_t j = 0; j < count; j++) {
+            out[begin + j] = resolve(hashes[j], slots[j]);
+        }
+    }
+}
+
+bool MphPositionIndex::mightContain(const std::string& kmer) const {
+    return lookup(kmer) != NOT_FOUND;
+}
+
+std::size_t MphPositionIndex::getFunctionBits() const {
+    if (numKmers == 0) return 0;
+    return std::visit([](const auto& f) { return static_cast<std::size_t>(f.num_bits()); }, function);
+}
+
+std::size_t MphPositionIndex::getMemoryBits() const {
+    if (numKmers == 0) return 0;
+    return getFunctionBits() + values.num_bytes() * 8;
+}
+
+double MphPositionIndex::getBitsPerKmer() const {
+    if (numKmers == 0) return 0.0;
+    return static_cast<double>(getMemoryBits()) / numKmers;
+}
+
+// ------------------ Persistence ------------------ //
+void MphPositionIndex::save(std::ostream& out) const {
+    if (numKmers == 0) {
+        throw std::logic_error("[MPH] Cannot save an index that was never built");
+    }
+    essentials::generic_saver saver(out);
+    uint64_t partitioned = function.index();
+    uint64_t fingerprintBits = config.fingerprintBits;
+    uint64_t width = positionBits;
+    uint64_t count = numKmers;
+    saver.visit(partitioned);
+    saver.visit(fingerprintBits);
+    saver.visit(width);
+    saver.visit(seed);
+    saver.visit(count);
+    std::visit([&saver](const auto& f) { saver.visit(f); }, function);
+    saver.visit(values);
+    if (!out) {
+        throw std::runtime_error("[MPH] Failed writing the index");
+    }
+}
+
+void MphPositionIndex::load(std::istream& in) {
+    essentials::generic_loader loader(in);
+    uint64_t partitioned = 0, fingerprintBits = 0, width = 0, count = 0;
+    loader.visit(partitioned);
+    loader.visit(fingerprintBits);
+    loader.visit(width);
+    loader.visit(seed);
+    loader.visit(count);
+    if (!in || width == 0 || width > 63 || width + fingerprintBits > 64) {
+        throw std::runtime_error("[MPH] Corrupt index header");
+    }
+
+    config.partitioned = partitioned != 0;
+    config.fingerprintBits = static_cast<int>(fingerprintBits);
+    config.positionBits = static_cast<int>(width);
+    positionBits = static_cast<int>(width);
+    if (config.partitioned) {
+        loader.visit(function.emplace<PartitionedFunction>());
+    }
+    else {
+        loader.visit(function.emplace<SingleFunction>());
+    }
+    loader.visit(values);
+    if (!in) {
+        throw std::runtime_error("[MPH] Truncated index");
+    }
+    numKmers = count;
+}
@@ -0,0 +1,102 @@
+#include "packedReferenceStore.h"
+#include "fastaReader.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+PackedReferenceStore PackedReferenceStore::fromFasta(const std::string& path) {
+    FastaReader reader(path);
+    PackedReferenceStore store;
+    // 1-mers are the ACGT bases with their coordinates; the coordinates
+    // they skip are non-ACGT bases
+    reader.forEachKmer(1, [&](const KmerOccurrence& base) {
+        if (base.coordinate > store.length) store.appendGap(base.coordinate - store.length);
+        store.appendCode(static_cast<uint8_t>(base.packed));
+        });
+    uint64_t total = reader.getTotalLength();
+    if (total > store.length) store.appendGap(total - store.length);
+    return store;
+}
+
+void PackedReferenceStore::append(std::string_view sequence) {
+    for (char base : sequence) {
+        uint8_t code = encodeBase(base);
+        if (code == INVALID_BASE) appendGap(1);
+        else appendCode(code);
+    }
+}
+
+void PackedReferenceStore::appendCode(uint8_t code) {
+    unsigned slot = static_cast<unsigned>(length % BASES_PER_WORD);
+    words[length / BASES_PER_WORD] |= static_cast<uint64_t>(code) << (2 * (BASES_PER_WORD - 1 - slot));
+    length++;
+    if (length % BASES_PER_WORD == 0) words.push_back(0);
+}
+
+void PackedReferenceStore::appendGap(uint64_t count) {
+    if (!gaps.empty() && gaps.back().second == length) gaps.back().second += count;
+    else gaps.emplace_back(length, length + count);
+    // gap bases stay A (zero) in the words
+    for (uint64_t i = 0; i < count; i++) {
+        length++;
+        if (length % BASES_PER_WORD == 0) words.push_back(0);
+    }
+}
+
+bool PackedReferenceStore::isValid(uint64_t position, std::size_t k) const {
+    if (position > length || k > length - position) return false;
+    // the last gap starting before the window's end must end before its start
+    auto after = std::upper_bound(gaps.begin(), gaps.end(), position + k,
+        [](uint64_t end, const std::pair<uint64_t, uint64_t>& gap) { return end <= gap.first; });
+    return after == gaps.begin() || std::prev(after)->second <= position;
+}
+
+uint64_t PackedReferenceStore::extract(uint64_t position, unsigned count) const {
+    std::size_t word = position / BASES_PER_WORD;
+    unsigned shift = 2 * static_cast<unsigned>(position % BASES_PER_WORD);
+    // the window's bases at the top of one word, then shifted down to count;
+    // the next word is only read when the window spills into it, since a
+    // window in the last word has none
+    uint64_t bits = words[word] << shift;
+    if (shift + 2 * count > 64) bits |= words[word + 1] >> (64 - shift);
+    return count == BASES_PER_WORD ? bits : bits >> (64 - 2 * count);
+}
+
+std::string PackedReferenceStore::toString(uint64_t position, std::size_t count) const {
+    if (position > length || count > length - position) {
+        throw std::out_of_range("[ReferenceStore] Range past the end of the reference");
+    }
+    std::string bases(count, 'A');
+    for (std::size_t j = 0; j < count; j++) {
+        bases[j] = "ACGT"[extract(position + j, 1)];
+    }
+    for (const auto& [begin, end] : gaps) {
+        for (uint64_t p = std::max(begin, position); p < std::min(end, position + count); p++) bases[p - position] = 'N';
+    }
+    return bases;
+}
+
+bool PackedReferenceStore::matches(uint64_t position, std::string_view kmer, bool reverse) const {
+    const std::size_t k = kmer.size();
+    if (!isValid(position, k)) return false;
+
+    // compare a word (up to 32 bases) at a time: pack the query chunk the
+    // way extract returns the reference and test the words for equality
+    for (std::size_t begin = 0; begin < k; begin += BASES_PER_WORD) {
+        auto count = static_cast<unsigned>(std::min<std::size_t>(BASES_PER_WORD, k - begin));
+        uint64_t query = 0;
+        for (unsigned j = 0; j < count; j++) {
+            // on the reverse strand, reference base i pairs with the
+            // complement of query base k - 1 - i
+            uint8_t code = encodeBase(reverse ? kmer[k - 1 - (begin + j)] : kmer[begin + j]);
+            if (code == INVALID_BASE) return false;
+            query = (query << 2) | (reverse ? 3 - code : code);
+        }
+        if (extract(position + begin, count) != query) return false;
+    }
+    return true;
+}
+
+std::size_t PackedReferenceStore::getMemoryBits() const {
+    return words.size() * 64 + gaps.size() * 2 * 64;
+}
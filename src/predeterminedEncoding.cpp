@@ -3,8 +3,7 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
-#include "predeterminedBloomFilter.h" 
-#include "BloomFilter.h"     
+#include "bloomFilterCascade.h"
 #include <bit>
 #include <cstdint>
 
@@ -25,19 +24,6 @@ std::vector<std::string> readFileLines(const std::string& filepath) {
     return lines;
 }
 
-// Helper function for writing lines to a file.
-void writeFileLines(const std::string& filepath,
-    const std::vector<std::string>& lines) {
-    std::ofstream outFile(filepath);
-    if (!outFile.is_open()) {
-        throw std::runtime_error("Unable to open output file: " + filepath);
-    }
-    for (const auto& line : lines) {
-        outFile << line << "\n";
-    }
-    outFile.close();
-}
-
 int numBits(uint64_t x) {
     if (x == 0) return 1;
     return 64 - std::countl_zero(x);
@@ -58,84 +44,44 @@ int main() {
 
         const int seed = 42;
 
-        std::vector<PredeterminedHashBloomFilter> bloomFilters;
-        bloomFilters.emplace_back(
-            elementsToEncode,
-            falsePositiveRate,
-            numHash,
-            positionBits
-        );
-
-        std::string currentRoundFile = uniqueKmersPath;
-        bool collisionsExist = true;
-        std::size_t round = 0;
-
-        std::size_t totalElementsLeft = elementsToEncode;
-
-        uint64_t currentPosition = 0;
-
-        while (collisionsExist) {
-            collisionsExist = false;
-            std::cout << "\n--- Processing Round " << round
-                << " (Elements left: " << totalElementsLeft << ") ---\n";
-
-            const std::string collisionFilePath =
-                "D:/Research/Capstone/capstone_code2/test_output/collisions_round_"
-                + std::to_string(round) + ".txt";
-
-            std::ifstream inFile(currentRoundFile);
-            if (!inFile.is_open()) {
-                throw std::runtime_error("Unable to open input file: " + currentRoundFile);
-            }
-
-            std::ofstream collisionFile(collisionFilePath);
-            if (!collisionFile.is_open()) {
-                throw std::runtime_error("Unable to open collision file: " + collisionFilePath);
-            }
-
-            std::string line;
-            while (std::getline(inFile, line)) {
-                if (line.empty()) {
-                    continue; 
-                }
-
-                bool inserted = false;
-                for (auto& bf : bloomFilters) {
-                    if (bf.add(line, currentPosition, seed)) {
-                        inserted = true;
-                        totalElementsLeft--;
-                        break;
-                    }
-                }
-
-                if (!inserted) {
-                    collisionFile << line << "\n";
-                    collisionsExist = true;
-                }
-                currentPosition++;
-            }
+        std::vector<std::string> kmers = readFileLines(uniqueKmersPath);
+
+        CascadeConfig config;
+        config.kind = FilterKind::Predetermined;
+        config.falsePositiveRate = falsePositiveRate;
+        config.numHash = numHash;
+        config.positionBits = positionBits;
+        config.seed = seed;
+        config.sizing.mode = CascadeSizingPolicy::Mode::Adaptive;
+        config.sizing.loadFactor = 1.0;
+        // all hardware threads; the rounds come out the same as with one
+        config.numThreads = 0;
+        config.routed = true;
+
+        BloomFilterCascade cascade(config);
+        cascade.build(kmers);
+
+        for (const auto& round : cascade.getRoundStats()) {
+            std::cout << "\n--- Round " << round.round
+                << " (Elements attempted: " << round.attempted << ") ---\n"
+                << "Inserted: " << round.inserted
+                << ", acceptance rate: " << round.acceptanceRate
+                << ", shadowed: " << round.shadowed
+                << ", sized for: " << round.sizedFor
+                << ", filter bits: " << round.memoryBits << "\n";
+        }
 
-            inFile.close();
-            collisionFile.close();
-
-        
-            if (collisionsExist) {
-                currentRoundFile = collisionFilePath;
-                bloomFilters.emplace_back(
-                    elementsToEncode,
-                    falsePositiveRate,
-                    numHash,
-                    positionBits
-                );
-                round++;
-                currentPosition = 0;
-            }
-            else {
-                std::cout << "No collisions found in this round. Done.\n";
+        std::size_t mismatches = 0;
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            if (cascade.lookup(kmers[i]) != i) {
+                mismatches++;
             }
         }
 
-        std::cout << "\nAll items processed successfully without further collisions.\n"
+        std::cout << "\nAll items processed in " << cascade.numRounds() << " rounds ("
+            << cascade.getBitsPerKmer() << " bits/k-mer, "
+            << cascade.getRouterBits() << " router bits, "
+            << mismatches << " lookup mismatches).\n"
             << "Press ENTER to exit.\n";
         std::cin.get();
 
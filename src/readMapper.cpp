@@ -0,0 +1,240 @@
+#include "readMapper.h"
+#include "rollingHash.h"
+#include <algorithm>
+#include <stdexcept>
+
+ReadMapper::ReadMapper(const BloomFilter& filter, MapperConfig config, int seed)
+    : filter(&filter), seed(seed), config(config), pool(config.numThreads), scratch(pool.size())
+{
+    init();
+}
+
+ReadMapper::ReadMapper(const BloomFilterCascade& cascade, MapperConfig config)
+    : cascade(&cascade), config(config), pool(config.numThreads), scratch(pool.size())
+{
+    init();
+}
+
+ReadMapper::ReadMapper(const ShardedCascade& index, MapperConfig config)
+    : sharded(&index), config(config), pool(config.numThreads), scratch(pool.size())
+{
+    init();
+}
+
+void ReadMapper::init() {
+    if (config.k == 0 || config.kmerStride == 0) {
+        throw std::invalid_argument("[ReadMapper] k and kmerStride must be positive");
+    }
+    if (config.readsPerTask == 0 || config.readsPerChunk == 0) {
+        throw std::invalid_argument("[ReadMapper] readsPerTask and readsPerChunk must be positive");
+    }
+    if (config.sampling.scheme != SamplingScheme::All) {
+        for (auto& buffers : scratch) buffers.sampler.emplace(config.k, config.sampling);
+    }
+}
+
+bool ReadMapper::canonicalIndex() const {
+    return (cascade && cascade->getConfig().canonical) || (sharded && sharded->getConfig().canonical);
+}
+
+// ------------------ Mapping ------------------ //
+std::vector<ReadPlacement> ReadMapper::mapReads(std::span<const std::string> reads) {
+    std::vector<const std::string*> sequences(reads.size());
+    for (std::size_t r = 0; r < reads.size(); r++) sequences[r] = &reads[r];
+    std::vector<ReadPlacement> placements(reads.size());
+    mapAll(sequences.data(), sequences.size(), placements.data());
+    return placements;
+}
+
+uint64_t ReadMapper::mapFastq(const std::string& path, const ReadCallback& onRead) {
+    FastqReader reader(path);
+    std::vector<FastqRecord> chunk;
+    std::vector<const std::string*> sequences;
+    std::vector<ReadPlacement> placements;
+    uint64_t total = 0;
+
+    while (std::size_t count = reader.readBatch(chunk, config.readsPerChunk)) {
+        sequences.resize(count);
+        for (std::size_t r = 0; r < count; r++) sequences[r] = &chunk[r].sequence;
+        placements.assign(count, ReadPlacement{});
+        mapAll(sequences.data(), count, placements.data());
+        for (std::size_t r = 0; r < count; r++) {
+            onRead(chunk[r], placements[r]);
+        }
+        total += count;
+    }
+    return total;
+}
+
+void ReadMapper::mapAll(const std::string* const* reads, std::size_t count, ReadPlacement* out) {
+    std::size_t perTask = config.readsPerTask;
+    std::size_t tasks = (count + perTask - 1) / perTask;
+    pool.run(tasks, [&](std::size_t task, unsigned worker) {
+        std::size_t begin = task * perTask;
+        mapTask(reads + begin, std::min(perTask, count - begin), out + begin, scratch[worker]);
+        });
+}
+
+void ReadMapper::mapTask(const std::string* const* reads, std::size_t count, ReadPlacement* out,
+    Scratch& buffers) const {
+    // canonical cascades answer for both strands from the forward k-mers
+    bool reverseLookups = config.bothStrands && !canonicalIndex();
+
+    buffers.probes.clear();
+    for (std::size_t r = 0; r < count; r++) {
+        const std::string& read = *reads[r];
+        collectKmers(read, static_cast<uint32_t>(r), false, buffers);
+        if (reverseLookups) {
+            buffers.reverseRead.resize(read.size());
+            for (std::size_t j = 0; j < read.size(); j++) {
+                uint8_t code = encodeBase(read[read.size() - 1 - j]);
+                buffers.reverseRead[j] = code == INVALID_BASE ? 'N' : "TGCA"[code];
+            }
+            collectKmers(buffers.reverseRead, static_cast<uint32_t>(r), true, buffers);
+        }
+    }
+
+    lookup(buffers);
+
+    // probes are grouped by read, so each read votes over one run of them
+    std::size_t begin = 0;
+    for (std::size_t r = 0; r < count; r++) {
+        std::size_t end = begin;
+        while (end < buffers.probes.size() && buffers.probes[end].read == r) end++;
+        out[r] = vote(buffers, begin, end, reads[r]->size());
+        begin = end;
+    }
+}
+
+void ReadMapper::collectKmers(const std::string& sequence, uint32_t read, bool reverse, Scratch& buffers) const {
+    const std::size_t k = config.k;
+    if (sequence.size() < k) return;
+
+    if (buffers.sampler) {
+        // the sampler skips k-mers with a non-ACGT base itself
+        buffers.sampler->forEachSampled(sequence, [&](std::size_t offset) {
+            appendKmer(sequence, offset, read, reverse, buffers);
+            });
+        return;
+    }
+
+    // invalidBefore[j]: non-ACGT bases in sequence[0, j), so a window is
+    // valid when the count does not change across it
+    buffers.invalidBefore.resize(sequence.size() + 1);
+    buffers.invalidBefore[0] = 0;
+    for (std::size_t j = 0; j < sequence.size(); j++) {
+        buffers.invalidBefore[j + 1] = buffers.invalidBefore[j] + (encodeBase(sequence[j]) == INVALID_BASE);
+    }
+
+    std::size_t last = sequence.size() - k;
+    for (std::size_t offset = 0; offset <= last;) {
+        if (buffers.invalidBefore[offset + k] == buffers.invalidBefore[offset]) {
+            appendKmer(sequence, offset, read, reverse, buffers);
+        }
+        if (offset == last) break;
+        offset = std::min(offset + config.kmerStride, last);
+    }
+}
+
+void ReadMapper::appendKmer(const std::string& sequence, std::size_t offset, uint32_t read, bool reverse,
+    Scratch& buffers) const {
+    std::size_t n = buffers.probes.size();
+    if (n == buffers.kmers.size()) buffers.kmers.emplace_back();
+    // assign reuses the capacity of the slot's previous k-mer
+    std::string& kmer = buffers.kmers[n];
+    kmer.assign(sequence, offset, config.k);
+    for (auto& base : kmer) {
+        base = "ACGT"[encodeBase(base)];
+    }
+    buffers.probes.push_back({ read, static_cast<uint32_t>(offset), reverse });
+}
+
+void ReadMapper::lookup(Scratch& buffers) const {
+    std::size_t n = buffers.probes.size();
+    std::span<const std::string> kmers(buffers.kmers.data(), n);
+    if (cascade || sharded) {
+        buffers.stranded.resize(n);
+        if (cascade) cascade->lookupStrandedBatch(kmers, buffers.stranded);
+        else sharded->lookupStrandedBatch(kmers, buffers.stranded);
+    }
+    else {
+        buffers.stranded.resize(n);
+        buffers.positions.resize(n);
+        filter->getPositionBatch(kmers, buffers.positions, seed);
+        // a hit whose check bits failed is no hit
+        for (std::size_t j = 0; j < n; j++) {
+            uint64_t position = buffers.positions[j];
+            buffers.stranded[j] = { position == BloomFilter::AMBIGUOUS ? BloomFilter::NOT_FOUND : position, false };
+        }
+    }
+
+    if (config.reference) {
+        for (std::size_t j = 0; j < n; j++) {
+            StrandedPosition& hit = buffers.stranded[j];
+            if (hit.position != BloomFilter::NOT_FOUND && !config.reference->matches(hit.position, kmers[j], hit.reverse)) {
+                hit = { BloomFilter::NOT_FOUND, false };
+            }
+        }
+    }
+}
+
+ReadPlacement ReadMapper::vote(Scratch& buffers, std::size_t begin, std::size_t end,
+    std::size_t readLength) const {
+    ReadPlacement placement;
+    std::vector<uint64_t>& diagonals = buffers.diagonals;
+    diagonals.clear();
+
+    const int64_t k = config.k;
+    const int64_t length = static_cast<int64_t>(readLength);
+    for (std::size_t j = begin; j < end; j++) {
+        const Probe& probe = buffers.probes[j];
+        if (!probe.reverse) placement.kmers++;
+        const StrandedPosition& hit = buffers.stranded[j];
+        if (hit.position == BloomFilter::NOT_FOUND) continue;
+
+        auto position = static_cast<int64_t>(hit.position);
+        int64_t start;
+        bool reverse;
+        if (hit.reverse) {
+            // a canonical hit on the other strand: the k-mer at offset o of
+            // the read is the reverse complement of the reference k-mer at
+            // start + (length - k - o)
+            start = position + probe.offset + k - length;
+            reverse = true;
+        }
+        else {
+            // offsets in the reverse complemented read count from its own
+            // start, so both strands share the forward diagonal
+            start = position - probe.offset;
+            reverse = probe.reverse;
+        }
+        if (start < 0) continue;
+        diagonals.push_back((static_cast<uint64_t>(start) << 1) | static_cast<uint64_t>(reverse));
+    }
+
+    std::sort(diagonals.begin(), diagonals.end());
+    uint32_t best = 0;
+    uint32_t second = 0;
+    uint64_t bestDiagonal = 0;
+    for (std::size_t a = 0; a < diagonals.size();) {
+        std::size_t b = a;
+        while (b < diagonals.size() && diagonals[b] == diagonals[a]) b++;
+        auto votes = static_cast<uint32_t>(b - a);
+        if (votes > best) {
+            second = best;
+            best = votes;
+            bestDiagonal = diagonals[a];
+        }
+        else if (votes > second) {
+            second = votes;
+        }
+        a = b;
+    }
+
+    if (best == 0 || best < config.minVotes) return placement;
+    placement.position = bestDiagonal >> 1;
+    placement.reverse = bestDiagonal & 1ULL;
+    placement.votes = best;
+    placement.confidence = static_cast<double>(best - second) / std::max<uint32_t>(placement.kmers, best);
+    return placement;
+}
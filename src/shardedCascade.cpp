@@ -0,0 +1,421 @@
+#include "shardedCascade.h"
+#include "filterSerialization.h"
+#include "packedKmer.h"
+#include "workStealingPool.h"
+#include "../external/MurmurHash3/murmurhash3.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+// Fixed and distinct from any round seed, so the bucket of a k-mer says
+// nothing about its probes inside the shard.
+constexpr uint32_t BUCKET_SEED = 0x5eed5a4d;
+
+// Hash of the smallest m-mer of kmer (canonical m-mers when Canonical, so
+// both strands of the k-mer agree). M-mers are ordered by a single multiply
+// of their packed bases, which is enough to break up lexicographic order;
+// only the winner is fully mixed. Canonical is a template parameter so the
+// forward loop carries no data-dependent branch. False if kmer is shorter
+// than m or holds a non-ACGT base.
+template <bool Canonical>
+bool minimizerHash(std::string_view kmer, unsigned m, uint64_t& minimizer) {
+    if (kmer.size() < m) return false;
+    const uint64_t mask = m == 32 ? ~0ULL : ((1ULL << (2 * m)) - 1);
+    const unsigned top = 2 * (m - 1);
+    uint64_t forward = 0;
+    uint64_t reverse = 0;
+    // a local, since stores through the reference could alias the k-mer
+    uint64_t smallest = ~0ULL;
+    for (std::size_t j = 0; j < kmer.size(); j++) {
+        uint8_t code = encodeBase(kmer[j]);
+        if (code == INVALID_BASE) return false;
+        forward = ((forward << 2) | code) & mask;
+        if constexpr (Canonical) {
+            reverse = (reverse >> 2) | (static_cast<uint64_t>(3 - code) << top);
+        }
+        if (j + 1 < m) continue;
+        uint64_t mmer = Canonical ? std::min(forward, reverse) : forward;
+        smallest = std::min<uint64_t>(smallest, (mmer ^ BUCKET_SEED) * 0x9e3779b97f4a7c15ULL);
+    }
+    minimizer = mix64(smallest);
+    return true;
+}
+}
+
+// ------------------ Sharded Lookups ------------------ //
+std::size_t ShardedCascade::bucketOf(std::string_view kmer, bool canonical, std::size_t numBuckets,
+    const ShardRoutingPolicy& routing) {
+    if (routing.mode == ShardRoutingPolicy::Mode::Minimizer) {
+        uint64_t minimizer;
+        bool valid = canonical ? minimizerHash<true>(kmer, routing.minimizerLength, minimizer)
+            : minimizerHash<false>(kmer, routing.minimizerLength, minimizer);
+        if (valid) return reduceToRange(minimizer, numBuckets, RangeReduction::FastRange);
+    }
+
+    std::string key;
+    if (canonical) {
+        bool reversed;
+        key = canonicalKmer(kmer, reversed);
+        kmer = key;
+    }
+    uint64_t hash128[2];
+    MurmurHash3_x64_128(kmer.data(), static_cast<int>(kmer.size()), BUCKET_SEED, hash128);
+    return reduceToRange(hash128[0], numBuckets, RangeReduction::FastRange);
+}
+
+std::size_t ShardedCascade::shardOf(std::string_view kmer) const {
+    return bucketShards[bucketOf(kmer, config.canonical, bucketShards.size(), routing)];
+}
+
+uint64_t ShardedCascade::lookup(const std::string& kmer) const {
+    return shards[shardOf(kmer)].lookup(kmer);
+}
+
+StrandedPosition ShardedCascade::lookupStranded(const std::string& kmer) const {
+    return shards[shardOf(kmer)].lookupStranded(kmer);
+}
+
+template <typename Out, typename Lookup>
+void ShardedCascade::lookupByShard(std::span<const std::string> kmers, std::span<Out> out, Lookup&& lookup) const {
+    if (out.size() != kmers.size()) {
+        throw std::invalid_argument("[Cascade] Batch output size must match the number of k-mers");
+    }
+
+    // group the k-mers by shard (counting sort), like a routed cascade
+    // groups them by round
+    std::vector<std::size_t> owners(kmers.size());
+    std::vector<std::size_t> shardBegin(shards.size() + 1, 0);
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        owners[j] = shardOf(kmers[j]);
+        shardBegin[owners[j] + 1]++;
+    }
+    std::partial_sum(shardBegin.begin(), shardBegin.end(), shardBegin.begin());
+    std::vector<std::size_t> byShard(kmers.size());
+    std::vector<std::size_t> fill(shardBegin.begin(), shardBegin.end() - 1);
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        byShard[fill[owners[j]]++] = j;
+    }
+
+    std::vector<std::string> batch;
+    std::vector<Out> results;
+    for (std::size_t s = 0; s < shards.size(); s++) {
+        if (shardBegin[s] == shardBegin[s + 1]) continue;
+        batch.clear();
+        for (std::size_t b = shardBegin[s]; b < shardBegin[s + 1]; b++) batch.push_back(kmers[byShard[b]]);
+        results.resize(batch.size());
+        lookup(shards[s], std::span<const std::string>(batch), std::span<Out>(results));
+        for (std::size_t b = 0; b < batch.size(); b++) {
+            out[byShard[shardBegin[s] + b]] = results[b];
+        }
+    }
+}
+
+void ShardedCascade::lookupBatch(std::span<const std::string> kmers, std::span<uint64_t> out) const {
+    lookupByShard(kmers, out, [](const BloomFilterCascade& shard, auto batch, auto results) {
+        shard.lookupBatch(batch, results);
+        });
+}
+
+void ShardedCascade::lookupStrandedBatch(std::span<const std::string> kmers,
+    std::span<StrandedPosition> out) const {
+    lookupByShard(kmers, out, [](const BloomFilterCascade& shard, auto batch, auto results) {
+        shard.lookupStrandedBatch(batch, results);
+        });
+}
+
+bool ShardedCascade::mightContain(const std::string& kmer) const {
+    return shards[shardOf(kmer)].mightContain(kmer);
+}
+
+std::size_t ShardedCascade::estimateFilterBytes(const CascadeConfig& config, std::size_t count) {
+    if (count == 0) return 0;
+    // first-round filter, presence plus position planes; later rounds are
+    // sized for what is left, so the whole cascade is counted as twice that
+    std::size_t bitArraySize = BloomFilter::calculateBitArraySize(count, config.falsePositiveRate);
+    int numHash = config.numHash > 0 ? config.numHash
+        : BloomFilter::calculateOptimalHashNum(count, bitArraySize);
+    int positionBits = config.positionBits + (config.canonical ? 1 : 0);
+    std::size_t chunkCount = (positionBits + numHash - 1) / numHash;
+    return 2 * (bitArraySize * (1 + chunkCount) / 8);
+}
+
+std::size_t ShardedCascade::getMemoryBits() const {
+    std::size_t bits = bucketShards.size() * sizeof(uint32_t) * 8;
+    for (const auto& shard : shards) {
+        bits += shard.getMemoryBits();
+    }
+    return bits;
+}
+
+double ShardedCascade::getBitsPerKmer() const {
+    if (kmerCount == 0) return 0.0;
+    return static_cast<double>(getMemoryBits()) / kmerCount;
+}
+
+void ShardedCascade::dumpStats(std::ostream& out) const {
+    out << "{\"numKmers\":" << kmerCount
+        << ",\"routing\":\"" << (routing.mode == ShardRoutingPolicy::Mode::Minimizer ? "minimizer" : "hash") << "\""
+        << ",\"numBuckets\":" << bucketShards.size()
+        << ",\"memoryBytes\":" << (getMemoryBits() + 7) / 8
+        << ",\"shards\":[";
+    for (std::size_t s = 0; s < shards.size(); s++) {
+        out << (s ? "," : "");
+        shards[s].dumpStats(out);
+    }
+    out << "]}";
+}
+
+// ------------------ In-Memory Construction ------------------ //
+ShardedCascade ShardedCascade::build(const std::vector<std::string>& kmers, const std::vector<uint64_t>& positions,
+    const ShardedBuildConfig& config) {
+    if (kmers.size() != positions.size()) {
+        throw std::invalid_argument("[Cascade] Every k-mer needs exactly one position");
+    }
+    if (config.routing.minimizerLength == 0 || config.routing.minimizerLength > 32) {
+        throw std::invalid_argument("[Cascade] minimizerLength must be in [1, 32]");
+    }
+    if (config.shardBytes == 0) {
+        throw std::invalid_argument("[Cascade] shardBytes must be positive");
+    }
+    // fail on a bad cascade config before bucketing
+    BloomFilterCascade check(config.cascade);
+
+    std::size_t numBuckets = config.numBuckets;
+    if (numBuckets == 0) {
+        std::size_t bytes = estimateFilterBytes(config.cascade, kmers.size());
+        numBuckets = std::max<std::size_t>(1, (bytes + config.shardBytes - 1) / config.shardBytes);
+    }
+
+    // k-mer indexes grouped by bucket (counting sort)
+    std::vector<uint32_t> buckets(kmers.size());
+    std::vector<std::size_t> bucketBegin(numBuckets + 1, 0);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        buckets[i] = static_cast<uint32_t>(bucketOf(kmers[i], config.cascade.canonical, numBuckets, config.routing));
+        bucketBegin[buckets[i] + 1]++;
+    }
+    std::partial_sum(bucketBegin.begin(), bucketBegin.end(), bucketBegin.begin());
+    std::vector<std::size_t> byBucket(kmers.size());
+    std::vector<std::size_t> fill(bucketBegin.begin(), bucketBegin.end() - 1);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        byBucket[fill[buckets[i]]++] = i;
+    }
+
+    ShardedCascade index(config.cascade, config.routing);
+    index.kmerCount = kmers.size();
+    index.bucketShards.resize(numBuckets);
+    std::iota(index.bucketShards.begin(), index.bucketShards.end(), 0u);
+    CascadeConfig shardConfig = config.cascade;
+    shardConfig.numThreads = 1;
+    index.shards.reserve(numBuckets);
+    for (std::size_t b = 0; b < numBuckets; b++) {
+        index.shards.emplace_back(shardConfig);
+    }
+
+    // a shard's k-mers are copied out only while it is being built
+    WorkStealingPool pool(config.numThreads);
+    pool.run(numBuckets, [&](std::size_t b, unsigned) {
+        std::vector<std::string> shardKmers;
+        std::vector<uint64_t> shardPositions;
+        shardKmers.reserve(bucketBegin[b + 1] - bucketBegin[b]);
+        shardPositions.reserve(bucketBegin[b + 1] - bucketBegin[b]);
+        for (std::size_t j = bucketBegin[b]; j < bucketBegin[b + 1]; j++) {
+            shardKmers.push_back(kmers[byBucket[j]]);
+            shardPositions.push_back(positions[byBucket[j]]);
+        }
+        index.shards[b].build(shardKmers, shardPositions);
+        });
+    return index;
+}
+
+// ------------------ External Construction ------------------ //
+ExternalCascadeBuilder::ExternalCascadeBuilder(ExternalBuildConfig config, std::string outputPath)
+    : config(std::move(config)), outputPath(std::move(outputPath))
+{
+    if (this->config.numBuckets == 0) {
+        throw std::invalid_argument("[ExternalBuild] numBuckets must be positive");
+    }
+    if (this->config.ramBytes == 0) {
+        throw std::invalid_argument("[ExternalBuild] ramBytes must be positive");
+    }
+    if (this->config.routing.minimizerLength == 0 || this->config.routing.minimizerLength > 32) {
+        throw std::invalid_argument("[ExternalBuild] minimizerLength must be in [1, 32]");
+    }
+    // fail on a bad cascade config before any input is spilled
+    BloomFilterCascade check(this->config.cascade);
+
+    // a random tag keeps processes sharing tmpDir apart, the counter keeps
+    // builders in one process apart
+    static std::atomic<uint64_t> builders{ 0 };
+    auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::random_device entropy;
+    spillPrefix = (std::filesystem::path(this->config.tmpDir) / ("kmer_encoding." + std::to_string(entropy())
+        + "." + std::to_string(stamp) + "." + std::to_string(builders++) + ".bucket")).string();
+
+    std::size_t numBuckets = this->config.numBuckets;
+    buffers.resize(numBuckets);
+    bucketCounts.assign(numBuckets, 0);
+    bucketKeyBytes.assign(numBuckets, 0);
+    bufferLimit = std::max<std::size_t>(4096, this->config.ramBytes / 8 / numBuckets);
+}
+
+ExternalCascadeBuilder::~ExternalCascadeBuilder() {
+    removeSpillFiles();
+}
+
+std::string ExternalCascadeBuilder::bucketPath(std::size_t bucket) const {
+    return spillPrefix + std::to_string(bucket);
+}
+
+void ExternalCascadeBuilder::add(std::string_view kmer, uint64_t position) {
+    if (finished) {
+        throw std::logic_error("[ExternalBuild] add() after finish()");
+    }
+    int bits = config.cascade.positionBits;
+    if (position >= (1ULL << bits)) {
+        throw std::invalid_argument("[ExternalBuild] Position does not fit in positionBits");
+    }
+
+    // record: uint32 length, the k-mer bytes, uint64 position
+    std::size_t bucket = ShardedCascade::bucketOf(kmer, config.cascade.canonical, config.numBuckets, config.routing);
+    std::string& buffer = buffers[bucket];
+    auto length = static_cast<uint32_t>(kmer.size());
+    buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    buffer.append(kmer.data(), kmer.size());
+    buffer.append(reinterpret_cast<const char*>(&position), sizeof(position));
+    bucketCounts[bucket]++;
+    bucketKeyBytes[bucket] += kmer.size();
+    kmerCount++;
+
+    if (buffer.size() >= bufferLimit) {
+        flush(bucket);
+    }
+}
+
+uint64_t ExternalCascadeBuilder::addLines(const std::string& path, uint64_t nextPosition) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("[ExternalBuild] Unable to open input file: " + path);
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        add(line, nextPosition++);
+    }
+    return nextPosition;
+}
+
+void ExternalCascadeBuilder::flush(std::size_t bucket) {
+    std::string& buffer = buffers[bucket];
+    if (buffer.empty()) return;
+    std::ofstream out(bucketPath(bucket), std::ios::binary | std::ios::app);
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.close();
+    if (out.fail()) {
+        throw std::runtime_error("[ExternalBuild] Failed writing bucket file: " + bucketPath(bucket));
+    }
+    buffer.clear();
+}
+
+void ExternalCascadeBuilder::readBucket(std::size_t bucket, std::vector<std::string>& kmers,
+    std::vector<uint64_t>& positions) const {
+    if (bucketCounts[bucket] == 0) return;
+    std::ifstream in(bucketPath(bucket), std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("[ExternalBuild] Missing bucket file: " + bucketPath(bucket));
+    }
+    for (std::size_t i = 0; i < bucketCounts[bucket]; i++) {
+        uint32_t length;
+        uint64_t position;
+        std::string kmer;
+        in.read(reinterpret_cast<char*>(&length), sizeof(length));
+        kmer.resize(length);
+        in.read(kmer.data(), length);
+        in.read(reinterpret_cast<char*>(&position), sizeof(position));
+        if (!in) {
+            throw std::runtime_error("[ExternalBuild] Truncated bucket file: " + bucketPath(bucket));
+        }
+        kmers.push_back(std::move(kmer));
+        positions.push_back(position);
+    }
+}
+
+void ExternalCascadeBuilder::removeSpillFiles() const {
+    for (std::size_t b = 0; b < config.numBuckets; b++) {
+        std::remove(bucketPath(b).c_str());
+    }
+}
+
+std::size_t ExternalCascadeBuilder::estimateBuildBytes(const CascadeConfig& config, std::size_t count,
+    std::size_t keyBytes) {
+    if (count == 0) return 0;
+    // the k-mers and positions as read, the canonical keys and values built
+    // from them, and the cascade's pending / rejected index lists
+    std::size_t perKmer = 2 * sizeof(std::string) + 2 * sizeof(uint64_t) + 2 * sizeof(std::size_t);
+    return count * perKmer + 2 * keyBytes + ShardedCascade::estimateFilterBytes(config, count);
+}
+
+void ExternalCascadeBuilder::finish() {
+    if (finished) {
+        throw std::logic_error("[ExternalBuild] finish() called twice");
+    }
+    finished = true;
+    for (std::size_t b = 0; b < config.numBuckets; b++) {
+        flush(b);
+    }
+
+    // greedily group consecutive buckets while the estimate stays in budget
+    std::vector<uint32_t> bucketShards(config.numBuckets);
+    std::vector<std::size_t> shardStart{ 0 };
+    std::size_t count = 0;
+    std::size_t keyBytes = 0;
+    for (std::size_t b = 0; b < config.numBuckets; b++) {
+        if (estimateBuildBytes(config.cascade, bucketCounts[b], bucketKeyBytes[b]) > config.ramBytes) {
+            throw std::runtime_error("[ExternalBuild] Bucket " + std::to_string(b) + " with "
+                + std::to_string(bucketCounts[b]) + " k-mers exceeds ramBytes; use more buckets");
+        }
+        if (b > shardStart.back() && estimateBuildBytes(config.cascade,
+            count + bucketCounts[b], keyBytes + bucketKeyBytes[b]) > config.ramBytes) {
+            shardStart.push_back(b);
+            count = 0;
+            keyBytes = 0;
+        }
+        count += bucketCounts[b];
+        keyBytes += bucketKeyBytes[b];
+        bucketShards[b] = static_cast<uint32_t>(shardStart.size() - 1);
+    }
+    shardStart.push_back(config.numBuckets);
+
+    FilterSerializer::ShardWriter writer(outputPath, bucketShards, kmerCount, config.routing);
+    stats.clear();
+    for (std::size_t s = 0; s + 1 < shardStart.size(); s++) {
+        std::vector<std::string> kmers;
+        std::vector<uint64_t> positions;
+        std::size_t shardKeyBytes = 0;
+        for (std::size_t b = shardStart[s]; b < shardStart[s + 1]; b++) {
+            readBucket(b, kmers, positions);
+            shardKeyBytes += bucketKeyBytes[b];
+        }
+
+        BloomFilterCascade shard(config.cascade);
+        shard.build(kmers, positions);
+        writer.append(shard);
+        for (std::size_t b = shardStart[s]; b < shardStart[s + 1]; b++) {
+            std::remove(bucketPath(b).c_str());
+        }
+
+        stats.push_back({ s, shardStart[s], shardStart[s + 1] - shardStart[s], kmers.size(),
+            estimateBuildBytes(config.cascade, kmers.size(), shardKeyBytes),
+            shard.numRounds(), shard.getMemoryBits() });
+    }
+    writer.close();
+}
@@ -0,0 +1,61 @@
+#include "staticBloomFilter.h"
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace {
+// Calls visit with a null Filter* naming the instantiation that
+// matches the runtime parameters; false if there is none.
+template <typename Layout, typename Visit>
+bool selectPositionBits(int numHash, int positionBits, Visit&& visit) {
+    auto withHash = [&](auto hashTag) {
+        constexpr int NUM_HASH = decltype(hashTag)::value;
+        switch (positionBits) {
+        case 16: visit(static_cast<StaticBloomFilter<Layout, NUM_HASH, 16>*>(nullptr)); return true;
+        case 24: visit(static_cast<StaticBloomFilter<Layout, NUM_HASH, 24>*>(nullptr)); return true;
+        case 32: visit(static_cast<StaticBloomFilter<Layout, NUM_HASH, 32>*>(nullptr)); return true;
+        default: return false;
+        }
+        };
+    switch (numHash) {
+    case 7: return withHash(std::integral_constant<int, 7>{});
+    case 10: return withHash(std::integral_constant<int, 10>{});
+    default: return false;
+    }
+}
+
+template <typename Visit>
+bool selectStaticFilter(FilterKind kind, int numHash, int positionBits, Visit&& visit) {
+    switch (kind) {
+    case FilterKind::Standard:
+        return selectPositionBits<PlainLayout>(numHash, positionBits, visit);
+    case FilterKind::Partitioned:
+        return selectPositionBits<PartitionedLayout>(numHash, positionBits, visit);
+    case FilterKind::Blocked:
+        return selectPositionBits<BlockedLayout>(numHash, positionBits, visit);
+    default:
+        return false;
+    }
+}
+}
+
+bool hasStaticFilter(FilterKind kind, int numHash, int positionBits) {
+    return selectStaticFilter(kind, numHash, positionBits, [](auto*) {});
+}
+
+AnyStaticFilter makeStaticFilter(FilterKind kind, int numHash, int positionBits,
+    std::size_t elementsToEncode, double falsePositiveRate,
+    RangeReduction reduction, bool rejectSelfCollisions) {
+    std::optional<AnyStaticFilter> filter;
+    bool found = selectStaticFilter(kind, numHash, positionBits, [&](auto* tag) {
+        using Filter = std::remove_pointer_t<decltype(tag)>;
+        filter.emplace(std::in_place_type<Filter>,
+            elementsToEncode, falsePositiveRate, reduction, rejectSelfCollisions);
+        });
+    if (!found) {
+        throw std::invalid_argument("[StaticBF] No static filter for " + std::to_string(numHash)
+            + " hashes and " + std::to_string(positionBits) + " position bits of this kind");
+    }
+    return std::move(*filter);
+}
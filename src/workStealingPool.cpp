@@ -0,0 +1,134 @@
+#include "workStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned numThreads) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned w = 0; w < numThreads; w++) {
+        ranges.push_back(std::make_unique<Range>());
+    }
+    threads.reserve(numThreads - 1);
+    for (unsigned w = 1; w < numThreads; w++) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, w);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::run(std::size_t numTasks, const std::function<void(std::size_t, unsigned)>& fn) {
+    if (numTasks == 0) return;
+
+    std::size_t step = (numTasks + ranges.size() - 1) / ranges.size();
+    for (std::size_t w = 0; w < ranges.size(); w++) {
+        std::lock_guard<std::mutex> lock(ranges[w]->mutex);
+        ranges[w]->begin = std::min(numTasks, w * step);
+        ranges[w]->end = std::min(numTasks, (w + 1) * step);
+    }
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        job = &fn;
+        failure = nullptr;
+        busyWorkers = static_cast<unsigned>(threads.size());
+        generation++;
+    }
+    jobReady.notify_all();
+
+    drain(0);
+
+    std::exception_ptr thrown;
+    {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        jobDone.wait(lock, [this] { return busyWorkers == 0; });
+        job = nullptr;
+        thrown = failure;
+    }
+    if (thrown) std::rethrow_exception(thrown);
+}
+
+void WorkStealingPool::workerLoop(unsigned worker) {
+    std::size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        drain(worker);
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            if (--busyWorkers == 0) jobDone.notify_one();
+        }
+    }
+}
+
+void WorkStealingPool::drain(unsigned worker) {
+    Range& own = *ranges[worker];
+    while (true) {
+        std::size_t task;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.begin < own.end) {
+                task = own.begin++;
+                found = true;
+            }
+        }
+        if (!found && !steal(worker, task)) return;
+
+        try {
+            (*job)(task, worker);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            if (!failure) failure = std::current_exception();
+        }
+    }
+}
+
+bool WorkStealingPool::steal(unsigned worker, std::size_t& task) {
+    while (true) {
+        // the largest range is the one least likely to run dry meanwhile
+        std::size_t victim = worker;
+        std::size_t largest = 0;
+        for (std::size_t w = 0; w < ranges.size(); w++) {
+            if (w == worker) continue;
+            std::lock_guard<std::mutex> lock(ranges[w]->mutex);
+            std::size_t left = ranges[w]->end - ranges[w]->begin;
+            if (left > largest) {
+                largest = left;
+                victim = w;
+            }
+        }
+        if (largest == 0) return false;
+
+        std::size_t begin;
+        std::size_t end;
+        {
+            Range& range = *ranges[victim];
+            std::lock_guard<std::mutex> lock(range.mutex);
+            std::size_t left = range.end - range.begin;
+            if (left == 0) continue;
+            end = range.end;
+            begin = end - (left + 1) / 2;
+            range.end = begin;
+        }
+
+        task = begin;
+        Range& own = *ranges[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = begin + 1;
+        own.end = end;
+        return true;
+    }
+}
@@ -2,9 +2,15 @@
 #include "bloomfilter.h"
 #include "partitionedBloomFilter.h"
 #include "predeterminedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include "packedBitset.h"
 #include <string>
 #include <vector>
 #include <iostream>
+#include <bit>
+#include <cmath>
+#include <memory>
+#include <sstream>
 
 // ------------------ Construction Tests ------------------ //
 TEST_CASE("BloomFilter Construction", "[bloom]") {
@@ -25,6 +31,82 @@ TEST_CASE("PartitionedBloomFilter Construction", "[partitioned_bloom]") {
     }
 }
 
+// ------------------ Packed Bitset ------------------ //
+TEST_CASE("PackedBitset set, test and popcount", "[bitset]") {
+    PackedBitset bits(1000);
+
+    SECTION("Storage is cache-line aligned and starts empty") {
+        REQUIRE(reinterpret_cast<std::uintptr_t>(bits.data()) % PackedBitset::CACHE_LINE_BYTES == 0);
+        REQUIRE(bits.size() == 1000);
+        REQUIRE(bits.count() == 0);
+    }
+
+    SECTION("Set, reset and assign single bits") {
+        bits.set(0);
+        bits.set(63);
+        bits.set(64);
+        bits.set(999);
+        REQUIRE(bits.test(0));
+        REQUIRE(bits[63]);
+        REQUIRE(bits.test(64));
+        REQUIRE(bits.test(999));
+        REQUIRE_FALSE(bits.test(1));
+        REQUIRE(bits.count() == 4);
+
+        bits.reset(63);
+        bits.assign(64, false);
+        bits.assign(500, true);
+        REQUIRE_FALSE(bits.test(63));
+        REQUIRE_FALSE(bits.test(64));
+        REQUIRE(bits.test(500));
+        REQUIRE(bits.count() == 3);
+    }
+
+    SECTION("Range popcount matches a bit-by-bit scan") {
+        for (std::size_t i = 0; i < 1000; i += 3) {
+            bits.set(i);
+        }
+        for (std::size_t begin : {0, 1, 63, 64, 130}) {
+            for (std::size_t end : {130, 191, 192, 700, 1000}) {
+                std::size_t expected = 0;
+                for (std::size_t j = begin; j < end; j++) {
+                    if (bits.test(j)) expected++;
+                }
+                REQUIRE(bits.count(begin, end) == expected);
+            }
+        }
+    }
+
+    SECTION("Bulk OR and filled resize keep the tail clean") {
+        PackedBitset other(1000);
+        other.set(10);
+        bits.set(20);
+        bits |= other;
+        REQUIRE(bits.test(10));
+        REQUIRE(bits.test(20));
+
+        PackedBitset filled(70, true);
+        REQUIRE(filled.count() == 70);
+        filled.resize(130, true);
+        REQUIRE(filled.count() == 130);
+        filled.resize(65);
+        REQUIRE(filled.count() == 65);
+    }
+}
+
+TEST_CASE("Partition stats count set bits per partition", "[par_bloom]") {
+    PartitionedBloomFilter bf(1000, 0.01, 10);
+    for (int i = 0; i < 200; i++) {
+        bf.add("kmer" + std::to_string(i), i);
+    }
+
+    std::size_t totalSet = 0;
+    for (const auto& stat : bf.getPartitionStats()) {
+        totalSet += static_cast<std::size_t>(std::llround(stat.fillRatio * stat.size));
+    }
+    REQUIRE(totalSet == bf.getBitArray().count());
+}
+
 // ------------------ Basic Operations ------------------ //
 TEST_CASE("Basic Operations", "[bloom]") {
     // Create with 10 bits for position
@@ -133,6 +215,85 @@ TEST_CASE("Hash Function - Hash Distribution", "[bloom][hash]") {
 }
 
 
+// ------------------ Hash Schemes ------------------ //
+namespace {
+struct SchemeQuality {
+    double falsePositiveRate;
+    double decodeErrorRate;
+};
+
+// Inserts numElements keys at their index and measures the FPR on unseen keys
+// and the fraction of accepted keys whose position no longer decodes.
+template <typename Filter>
+SchemeQuality measureScheme(Filter& bf, std::size_t numElements) {
+    std::vector<bool> accepted(numElements);
+    for (std::size_t i = 0; i < numElements; i++) {
+        accepted[i] = bf.add("element" + std::to_string(i), i, 7);
+    }
+
+    std::size_t decodeErrors = 0;
+    std::size_t acceptedCount = 0;
+    for (std::size_t i = 0; i < numElements; i++) {
+        if (!accepted[i]) continue;
+        acceptedCount++;
+        if (bf.getPosition("element" + std::to_string(i), 7) != i) decodeErrors++;
+    }
+
+    std::size_t falsePositives = 0;
+    std::size_t testElements = 20000;
+    for (std::size_t i = 0; i < testElements; i++) {
+        if (bf.mightContain("absent" + std::to_string(i), 7)) falsePositives++;
+    }
+    return {
+        static_cast<double>(falsePositives) / testElements,
+        static_cast<double>(decodeErrors) / acceptedCount
+    };
+}
+}
+
+TEST_CASE("Double hashing matches independent hashing quality", "[bloom][hash]") {
+    const std::size_t numElements = 2000;
+    const double targetFPR = 0.01;
+
+    BloomFilter independent(numElements, targetFPR, 11);
+    SchemeQuality baseline = measureScheme(independent, numElements);
+
+    for (HashScheme scheme : {HashScheme::DoubleHashing, HashScheme::EnhancedDoubleHashing}) {
+        BloomFilter bf(numElements, targetFPR, 11, {scheme});
+        REQUIRE(bf.getHashScheme() == scheme);
+        SchemeQuality quality = measureScheme(bf, numElements);
+
+        REQUIRE(quality.falsePositiveRate < targetFPR * 1.5);
+        REQUIRE(quality.falsePositiveRate < baseline.falsePositiveRate * 1.5 + 0.002);
+        REQUIRE(quality.decodeErrorRate <= baseline.decodeErrorRate + 0.02);
+    }
+}
+
+TEST_CASE("Double hashing keeps partition semantics", "[par_bloom][hash]") {
+    const std::size_t numElements = 2000;
+    const double targetFPR = 0.01;
+
+    PartitionedBloomFilter independent(numElements, targetFPR, 11);
+    SchemeQuality baseline = measureScheme(independent, numElements);
+
+    PartitionedBloomFilter bf(numElements, targetFPR, 11, 0, {HashScheme::EnhancedDoubleHashing});
+    auto sizes = bf.getPartitionSizes();
+    for (int i = 0; i < bf.numHashCount; i++) {
+        uint64_t index = bf.generateHash("ACGTACGT", i, 3);
+        uint64_t start = static_cast<uint64_t>(i) * sizes[0];
+        REQUIRE(index >= start);
+        REQUIRE(index < start + sizes[i]);
+    }
+
+    SchemeQuality quality = measureScheme(bf, numElements);
+    REQUIRE(quality.falsePositiveRate < targetFPR * 1.5);
+    REQUIRE(quality.decodeErrorRate <= baseline.decodeErrorRate + 0.02);
+
+    PredeterminedHashBloomFilter pre(numElements, targetFPR, 10, 10, {HashScheme::DoubleHashing});
+    REQUIRE(pre.add("test", 42, 0));
+    REQUIRE(pre.getPosition("test", 0) == 42);
+}
+
 // ------------------ False Positive Rate ------------------ //
 TEST_CASE("False Positive Rate", "[bloom]") {
     size_t numElements = 1000;
@@ -200,6 +361,82 @@ TEST_CASE("Position Tracking", "[bloom]") {
 
 }
 
+TEST_CASE("Self-collision rejection", "[bloom]") {
+    BloomFilterOptions options;
+    options.rejectSelfCollisions = true;
+    BloomFilter bf(1000, 0.01, 10, options);
+
+    // two probes of GCTA share a slot but need different position bits
+    REQUIRE(bf.add("ATCG", 100, 0));
+    REQUIRE_FALSE(bf.add("GCTA", 200, 0));
+    REQUIRE(bf.getPosition("ATCG", 0) == 100);
+}
+
+TEST_CASE("Check bits report garbled positions as ambiguous", "[bloom][check]") {
+    const std::size_t count = 2000;
+    BloomFilterOptions plainOptions;
+    plainOptions.slotLayout = SlotLayout::Interleaved;
+    BloomFilterOptions checkedOptions = plainOptions;
+    checkedOptions.checkBits = 8;
+
+    // loose filters, so absent items often hit every slot and some
+    // inserted items garble their own position through shared slots
+    for (bool partitioned : { false, true }) {
+        std::unique_ptr<BloomFilter> plain, checked;
+        if (partitioned) {
+            plain = std::make_unique<PartitionedBloomFilter>(count, 0.05, 12, 0, plainOptions);
+            checked = std::make_unique<PartitionedBloomFilter>(count, 0.05, 12, 0, checkedOptions);
+        }
+        else {
+            plain = std::make_unique<BloomFilter>(count, 0.05, 12, plainOptions);
+            checked = std::make_unique<BloomFilter>(count, 0.05, 12, checkedOptions);
+        }
+        REQUIRE(checked->getCheckBits() == 8);
+        REQUIRE(checked->getPositionBits() == 12);
+        REQUIRE(checked->getMemoryBits() > plain->getMemoryBits());
+
+        std::vector<uint8_t> added(count);
+        for (std::size_t i = 0; i < count; i++) {
+            std::string item = "element" + std::to_string(i);
+            plain->add(item, i);
+            added[i] = checked->add(item, i);
+        }
+        std::size_t garbled = 0;
+        std::size_t ambiguous = 0;
+        std::size_t selfGarbled = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            std::string item = "element" + std::to_string(i);
+            uint64_t position = checked->getPosition(item);
+            ambiguous += position == BloomFilter::AMBIGUOUS;
+            if (!added[i]) continue;
+            REQUIRE((position == i || position == BloomFilter::AMBIGUOUS));
+            garbled += plain->getPosition(item) != i;
+            selfGarbled += position == BloomFilter::AMBIGUOUS;
+        }
+        REQUIRE(selfGarbled <= garbled);
+
+        std::size_t claimed = 0;
+        std::size_t passed = 0;
+        for (std::size_t i = 0; i < 20000; i++) {
+            std::string item = "absent" + std::to_string(i);
+            claimed += plain->getPosition(item) != BloomFilter::NOT_FOUND;
+            uint64_t position = checked->getPosition(item);
+            if (position == BloomFilter::AMBIGUOUS) ambiguous++;
+            else passed += position != BloomFilter::NOT_FOUND;
+        }
+        REQUIRE(claimed > 200);
+        // about 2^-8 of the false positives carry matching check bits
+        REQUIRE(passed < claimed / 16);
+        if (STATS_ENABLED) REQUIRE(checked->getStats().checkFailures == ambiguous);
+    }
+
+    BloomFilterOptions tooWide;
+    tooWide.checkBits = 8;
+    REQUIRE_THROWS_AS(BloomFilter(100, 0.01, 60, tooWide), std::invalid_argument);
+    tooWide.checkBits = -1;
+    REQUIRE_THROWS_AS(BloomFilter(100, 0.01, 10, tooWide), std::invalid_argument);
+}
+
 TEST_CASE("Partitioned Position Tracking", "[par_bloom]") {
     PartitionedBloomFilter bf(1000, 0.01, 10);
     std::string kmer = "ATCG";
@@ -256,6 +493,499 @@ TEST_CASE("Edge Cases with Position Bits", "[bloom]") {
 
 
 
+// ------------------ Slot Layouts ------------------ //
+namespace {
+// Inserting the same keys into two layouts must accept and decode identically.
+template <typename Filter>
+void requireSameBehaviour(Filter& planar, Filter& interleaved) {
+    REQUIRE(planar.getSlotLayout() == SlotLayout::Planar);
+    REQUIRE(interleaved.getSlotLayout() == SlotLayout::Interleaved);
+    for (std::size_t i = 0; i < 1500; i++) {
+        std::string item = "element" + std::to_string(i);
+        uint64_t position = (i * 37) % 1024;
+        REQUIRE(planar.add(item, position, 1) == interleaved.add(item, position, 1));
+    }
+    for (std::size_t i = 0; i < 3000; i++) {
+        std::string item = (i < 1500 ? "element" : "absent") + std::to_string(i);
+        REQUIRE(planar.mightContain(item, 1) == interleaved.mightContain(item, 1));
+        REQUIRE(planar.getPosition(item, 1) == interleaved.getPosition(item, 1));
+    }
+}
+}
+
+TEST_CASE("Interleaved layout behaves like the planar layout", "[bloom][layout]") {
+    BloomFilterOptions interleavedOptions;
+    interleavedOptions.slotLayout = SlotLayout::Interleaved;
+
+    SECTION("BloomFilter") {
+        BloomFilter planar(1000, 0.01, 10);
+        BloomFilter interleaved(1000, 0.01, 10, interleavedOptions);
+        requireSameBehaviour(planar, interleaved);
+    }
+
+    SECTION("PartitionedBloomFilter with several chunks") {
+        PartitionedBloomFilter planar(1000, 0.01, 30);
+        PartitionedBloomFilter interleaved(1000, 0.01, 30, 0, interleavedOptions);
+        requireSameBehaviour(planar, interleaved);
+
+        auto planarStats = planar.getPartitionStats();
+        auto interleavedStats = interleaved.getPartitionStats();
+        for (std::size_t p = 0; p < planarStats.size(); p++) {
+            REQUIRE(planarStats[p].fillRatio == interleavedStats[p].fillRatio);
+        }
+    }
+
+    SECTION("PredeterminedHashBloomFilter") {
+        PredeterminedHashBloomFilter planar(1000, 0.01, 6, 10);
+        PredeterminedHashBloomFilter interleaved(1000, 0.01, 6, 10, interleavedOptions);
+        requireSameBehaviour(planar, interleaved);
+    }
+}
+
+// ------------------ Batched Queries ------------------ //
+namespace {
+// Batch answers must match the single-item API exactly.
+void requireBatchMatchesSingle(BloomFilter& bf) {
+    std::vector<std::string> items;
+    for (std::size_t i = 0; i < 500; i++) {
+        bf.add("element" + std::to_string(i), i, 3);
+    }
+    // mix of present and absent items, with a length that is not a multiple of the block
+    for (std::size_t i = 0; i < 1000 + BloomFilter::BATCH_BLOCK / 2; i++) {
+        items.push_back((i % 2 ? "element" : "absent") + std::to_string(i / 2));
+    }
+
+    std::vector<uint64_t> positions(items.size());
+    std::vector<uint8_t> contained(items.size());
+    bf.getPositionBatch(items, positions, 3);
+    bf.mightContainBatch(items, contained, 3);
+
+    for (std::size_t j = 0; j < items.size(); j++) {
+        REQUIRE(positions[j] == bf.getPosition(items[j], 3));
+        REQUIRE(static_cast<bool>(contained[j]) == bf.mightContain(items[j], 3));
+        REQUIRE((positions[j] == BloomFilter::NOT_FOUND) == !contained[j]);
+    }
+}
+}
+
+TEST_CASE("Batched queries match single queries", "[bloom][batch]") {
+    BloomFilterOptions interleavedOptions;
+    interleavedOptions.slotLayout = SlotLayout::Interleaved;
+
+    SECTION("BloomFilter") {
+        BloomFilter bf(1000, 0.01, 10);
+        requireBatchMatchesSingle(bf);
+    }
+
+    SECTION("Interleaved PartitionedBloomFilter") {
+        PartitionedBloomFilter bf(1000, 0.01, 20, 0, interleavedOptions);
+        requireBatchMatchesSingle(bf);
+    }
+
+    SECTION("PredeterminedHashBloomFilter") {
+        PredeterminedHashBloomFilter bf(1000, 0.01, 10, 10, {HashScheme::DoubleHashing});
+        requireBatchMatchesSingle(bf);
+    }
+
+    SECTION("BlockedBloomFilter") {
+        BlockedBloomFilter bf(1000, 0.01, 10);
+        requireBatchMatchesSingle(bf);
+    }
+
+    SECTION("Output span must match the input") {
+        BloomFilter bf(1000, 0.01, 10);
+        std::vector<std::string> items(3, "ATCG");
+        std::vector<uint64_t> positions(2);
+        REQUIRE_THROWS_AS(bf.getPositionBatch(items, positions), std::invalid_argument);
+    }
+}
+
+// ------------------ Range Reduction ------------------ //
+namespace {
+void requireReducedRoundTrip(BloomFilter& bf) {
+    std::vector<bool> added(600);
+    for (std::size_t i = 0; i < added.size(); i++) {
+        added[i] = bf.add("element" + std::to_string(i), i, 2);
+    }
+    std::size_t accepted = 0;
+    for (std::size_t i = 0; i < added.size(); i++) {
+        if (!added[i]) continue;
+        accepted++;
+        REQUIRE(bf.getPosition("element" + std::to_string(i), 2) == i);
+    }
+    REQUIRE(accepted > added.size() / 4);
+}
+}
+
+TEST_CASE("Range reductions keep probes in range", "[bloom][reduction]") {
+    for (RangeReduction reduction : { RangeReduction::Modulo, RangeReduction::FastRange,
+        RangeReduction::PowerOfTwo }) {
+        BloomFilterOptions options;
+        options.rangeReduction = reduction;
+        options.hashScheme = HashScheme::DoubleHashing;
+        options.rejectSelfCollisions = true;
+
+        BloomFilter standard(1000, 0.01, 10, options);
+        REQUIRE(standard.getRangeReduction() == reduction);
+        for (int i = 0; i < 2000; i++) {
+            REQUIRE(standard.generateHash("item" + std::to_string(i), i % standard.numHashCount)
+                < standard.getSize());
+        }
+        requireReducedRoundTrip(standard);
+
+        PartitionedBloomFilter partitioned(1000, 0.01, 10, 7, options);
+        auto sizes = partitioned.getPartitionSizes();
+        std::size_t start = 0;
+        for (int p = 0; p < partitioned.numHashCount; p++) {
+            for (int j = 0; j < 200; j++) {
+                uint64_t index = partitioned.generateHash("item" + std::to_string(j), p);
+                REQUIRE(index >= start);
+                REQUIRE(index < start + sizes[p]);
+            }
+            start += sizes[p];
+        }
+        REQUIRE(start == partitioned.getSize());
+        requireReducedRoundTrip(partitioned);
+
+        BlockedBloomFilter blocked(1000, 0.01, 10, options);
+        REQUIRE(blocked.getRangeReduction() == reduction);
+        requireReducedRoundTrip(blocked);
+
+        if (reduction == RangeReduction::PowerOfTwo) {
+            REQUIRE(std::has_single_bit(standard.getSize()));
+            for (std::size_t size : sizes) {
+                REQUIRE(size == sizes[0]);
+                REQUIRE(std::has_single_bit(size));
+            }
+            REQUIRE(std::has_single_bit(blocked.getNumBlocks()));
+        }
+    }
+}
+
+TEST_CASE("Fast range spreads probes evenly", "[bloom][reduction][hash]") {
+    BloomFilterOptions options;
+    options.rangeReduction = RangeReduction::FastRange;
+    PartitionedBloomFilter bf(1000, 0.01, 10, 4, options);
+
+    // quarter each partition and count the probes falling in every quarter
+    auto sizes = bf.getPartitionSizes();
+    std::vector<std::size_t> quarters(4 * sizes.size());
+    const int samples = 20000;
+    std::size_t start = 0;
+    for (int p = 0; p < bf.numHashCount; p++) {
+        for (int j = 0; j < samples; j++) {
+            uint64_t offset = bf.generateHash("probe" + std::to_string(j), p) - start;
+            quarters[4 * p + offset * 4 / sizes[p]]++;
+        }
+        start += sizes[p];
+    }
+    for (std::size_t count : quarters) {
+        REQUIRE(count > samples / 4 * 0.9);
+        REQUIRE(count < samples / 4 * 1.1);
+    }
+}
+
+// ------------------ Parallel Construction ------------------ //
+namespace {
+bool sameBits(const PackedBitset& a, const PackedBitset& b) {
+    if (a.size() != b.size()) return false;
+    std::size_t words = (a.size() + PackedBitset::WORD_BITS - 1) / PackedBitset::WORD_BITS;
+    return std::equal(a.data(), a.data() + words, b.data());
+}
+
+// addParallel must leave the filter and the accepted flags exactly as a
+// sequential add loop over the selection does, for any thread count.
+template <typename MakeFilter>
+void requireParallelMatchesSequential(MakeFilter makeFilter) {
+    // three times the designed load, so many items collide and wait for
+    // earlier ones over several passes
+    std::vector<std::string> items;
+    std::vector<uint64_t> positions;
+    for (std::size_t i = 0; i < 3000; i++) {
+        items.push_back("element" + std::to_string(i));
+        positions.push_back((i * 7919) % 1100);
+    }
+    // skips some items, visits the rest out of order
+    std::vector<std::size_t> selection;
+    for (std::size_t i = 0; i < items.size(); i++) {
+        if (i % 5 != 0) selection.push_back((i * 1237) % items.size());
+    }
+
+    auto sequential = makeFilter();
+    std::vector<uint8_t> expected(selection.size());
+    for (std::size_t j = 0; j < selection.size(); j++) {
+        expected[j] = sequential->add(items[selection[j]], positions[selection[j]], 5);
+    }
+
+    for (unsigned threads : { 1u, 2u, 3u, 8u }) {
+        auto parallel = makeFilter();
+        std::vector<uint8_t> accepted(selection.size());
+        parallel->addParallel(items, positions, selection, accepted, 5, threads);
+        REQUIRE(accepted == expected);
+        REQUIRE(sameBits(parallel->getBitArray(), sequential->getBitArray()));
+        // insertion counters too (all zero without KMER_ENCODING_STATS)
+        FilterStats parallelStats = parallel->getStats();
+        FilterStats sequentialStats = sequential->getStats();
+        REQUIRE(parallelStats.accepted == sequentialStats.accepted);
+        REQUIRE(parallelStats.conflictsByProbe == sequentialStats.conflictsByProbe);
+        REQUIRE(parallelStats.filledByProbe == sequentialStats.filledByProbe);
+        for (std::size_t i = 0; i < items.size(); i++) {
+            REQUIRE(parallel->getPosition(items[i], 5) == sequential->getPosition(items[i], 5));
+        }
+    }
+}
+}
+
+TEST_CASE("Parallel insertion matches sequential insertion", "[bloom][parallel]") {
+    BloomFilterOptions interleaved;
+    interleaved.slotLayout = SlotLayout::Interleaved;
+
+    SECTION("BloomFilter") {
+        requireParallelMatchesSequential([] { return std::make_unique<BloomFilter>(1000, 0.01, 10); });
+    }
+
+    SECTION("Interleaved BloomFilter with double hashing") {
+        requireParallelMatchesSequential([] {
+            return std::make_unique<BloomFilter>(1000, 0.01, 11,
+                BloomFilterOptions{ HashScheme::DoubleHashing, SlotLayout::Interleaved });
+            });
+    }
+
+    SECTION("Interleaved PartitionedBloomFilter") {
+        requireParallelMatchesSequential([&] {
+            return std::make_unique<PartitionedBloomFilter>(1000, 0.01, 20, 0, interleaved);
+            });
+    }
+
+    SECTION("BlockedBloomFilter") {
+        requireParallelMatchesSequential([] { return std::make_unique<BlockedBloomFilter>(1000, 0.01, 10); });
+    }
+
+    SECTION("Spans must agree") {
+        BloomFilter bf(1000, 0.01, 10);
+        std::vector<std::string> items(3, "ATCG");
+        std::vector<uint64_t> positions(3);
+        std::vector<std::size_t> selection = { 0, 3 };
+        std::vector<uint8_t> accepted(2);
+        REQUIRE_THROWS_AS(bf.addParallel(items, positions, selection, accepted), std::out_of_range);
+        std::vector<uint8_t> tooShort(1);
+        REQUIRE_THROWS_AS(bf.addParallel(items, positions, selection, tooShort), std::invalid_argument);
+    }
+}
+
+// ------------------ Batched Construction ------------------ //
+namespace {
+// addBatch must accept and reject exactly what an add loop does; twice the
+// designed load and a few positions too wide to store exercise both, and the
+// item count leaves a partial last block.
+template <typename MakeFilter>
+void requireBatchMatchesSequential(MakeFilter makeFilter) {
+    std::vector<std::string> items;
+    std::vector<uint64_t> positions;
+    std::vector<uint64_t> hashes;
+    for (std::size_t i = 0; i < 10007; i++) {
+        items.push_back("element" + std::to_string(i));
+        positions.push_back(i % 97 == 0 ? (1ULL << 20) : (i * 7919) % 1000);
+        hashes.push_back(mix64(i));
+    }
+
+    auto sequential = makeFilter();
+    auto sequentialHashed = makeFilter();
+    std::vector<uint8_t> expected(items.size());
+    std::vector<uint8_t> expectedHashed(items.size());
+    for (std::size_t i = 0; i < items.size(); i++) {
+        expected[i] = sequential->add(items[i], positions[i], 5);
+        expectedHashed[i] = sequentialHashed->addHashed(hashes[i], positions[i], 5);
+    }
+
+    auto batched = makeFilter();
+    std::vector<uint8_t> accepted(items.size());
+    batched->addBatch(items, positions, accepted, 5);
+    REQUIRE(accepted == expected);
+    REQUIRE(sameBits(batched->getBitArray(), sequential->getBitArray()));
+
+    auto batchedHashed = makeFilter();
+    batchedHashed->addBatchHashed(hashes, positions, accepted, 5);
+    REQUIRE(accepted == expectedHashed);
+    REQUIRE(sameBits(batchedHashed->getBitArray(), sequentialHashed->getBitArray()));
+}
+}
+
+TEST_CASE("Batched insertion matches sequential insertion", "[bloom][batch]") {
+    const std::size_t designed = 5000;
+
+    SECTION("BloomFilter") {
+        requireBatchMatchesSequential([&] { return std::make_unique<BloomFilter>(designed, 0.01, 20); });
+    }
+
+    SECTION("Interleaved BloomFilter rejecting self-collisions") {
+        requireBatchMatchesSequential([&] {
+            return std::make_unique<BloomFilter>(designed, 0.01, 20,
+                BloomFilterOptions{ HashScheme::DoubleHashing, SlotLayout::Interleaved, true });
+            });
+    }
+
+    SECTION("PartitionedBloomFilter") {
+        requireBatchMatchesSequential([&] { return std::make_unique<PartitionedBloomFilter>(designed, 0.01, 20); });
+    }
+
+    SECTION("BlockedBloomFilter") {
+        requireBatchMatchesSequential([&] { return std::make_unique<BlockedBloomFilter>(designed, 0.01, 20); });
+    }
+
+    SECTION("Spans must agree") {
+        BloomFilter bf(1000, 0.01, 10);
+        std::vector<std::string> items(3, "ATCG");
+        std::vector<uint64_t> positions(3);
+        std::vector<uint8_t> tooShort(2);
+        REQUIRE_THROWS_AS(bf.addBatch(items, positions, tooShort), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Filters dump their stats as JSON", "[bloom][stats]") {
+    PartitionedBloomFilter filter(1000, 0.01, 16);
+    // twice the designed load, so some adds are rejected
+    std::size_t accepted = 0;
+    for (std::size_t i = 0; i < 2000; i++) {
+        accepted += filter.add("element" + std::to_string(i), i % 1000);
+    }
+    REQUIRE_FALSE(filter.add("element0", 1 << 16));
+    std::size_t found = 0;
+    for (std::size_t i = 0; i < 500; i++) {
+        found += filter.mightContain("element" + std::to_string(i));
+    }
+
+    std::ostringstream json;
+    filter.dumpStats(json);
+    std::string dumped = json.str();
+    REQUIRE(dumped.front() == '{');
+    REQUIRE(dumped.back() == '}');
+    REQUIRE(dumped.find("\"kind\":\"Partitioned\"") != std::string::npos);
+    REQUIRE(dumped.find("\"partitions\":[{\"index\":0,") != std::string::npos);
+    REQUIRE((dumped.find("\"counters\":") != std::string::npos) == STATS_ENABLED);
+
+    FilterStats stats = filter.getStats();
+    if (!STATS_ENABLED) {
+        REQUIRE(stats.adds == 0);
+        REQUIRE(stats.conflictsByProbe.empty());
+        return;
+    }
+    REQUIRE(stats.adds == 2001);
+    REQUIRE(stats.accepted == accepted);
+    REQUIRE(stats.rejectedPositionRange == 1);
+    std::size_t conflicts = 0;
+    for (uint64_t count : stats.conflictsByProbe) conflicts += count;
+    REQUIRE(stats.accepted + stats.rejectedPositionRange + stats.rejectedSelfCollision + conflicts == stats.adds);
+    REQUIRE(stats.lookups == 500);
+    REQUIRE(stats.presenceHits == found);
+
+    // probe i fills partition i
+    auto partitions = filter.getPartitionStats();
+    for (std::size_t i = 0; i < partitions.size(); i++) {
+        REQUIRE(stats.filledByProbe[i] == static_cast<uint64_t>(std::llround(partitions[i].fillRatio * partitions[i].size)));
+    }
+
+    filter.resetStats();
+    REQUIRE(filter.getStats().adds == 0);
+}
+
+// ------------------ Blocked Bloom Filter ------------------ //
+TEST_CASE("Blocked probes stay inside one cache line", "[blocked_bloom]") {
+    BlockedBloomFilter bf(1000, 0.01, 20);
+    REQUIRE(bf.getSlotLayout() == SlotLayout::Blocked);
+    REQUIRE(bf.getSize() == bf.getNumBlocks() * BlockedBloomFilter::BLOCK_BITS);
+
+    for (int k = 0; k < 100; k++) {
+        std::string item = "kmer" + std::to_string(k);
+        std::set<uint64_t> slots;
+        uint64_t block = bf.generateHash(item, 0) / BlockedBloomFilter::BLOCK_BITS;
+        for (int i = 0; i < bf.numHashCount; i++) {
+            uint64_t slot = bf.generateHash(item, i);
+            REQUIRE(slot / BlockedBloomFilter::BLOCK_BITS == block);
+            REQUIRE(slot % BlockedBloomFilter::BLOCK_BITS < bf.getBlockPlaneWidth());
+            slots.insert(slot);
+        }
+        // offsets inside the block never repeat
+        REQUIRE(slots.size() == static_cast<std::size_t>(bf.numHashCount));
+    }
+}
+
+TEST_CASE("Blocked probes use every stride prime", "[blocked_bloom]") {
+    BlockedBloomFilter bf(1000, 0.01, 20);
+    const uint64_t width = bf.getBlockPlaneWidth();
+    REQUIRE(bf.numHashCount >= 2);
+
+    std::set<uint64_t> expected;
+    for (uint32_t prime : BlockedBloomFilter::STRIDE_PRIMES) expected.insert(prime % width);
+    std::set<uint64_t> strides;
+    for (int k = 0; k < 2000; k++) {
+        std::string item = "kmer" + std::to_string(k);
+        uint64_t first = bf.generateHash(item, 0) % BlockedBloomFilter::BLOCK_BITS;
+        uint64_t second = bf.generateHash(item, 1) % BlockedBloomFilter::BLOCK_BITS;
+        strides.insert((second + width - first) % width);
+    }
+    REQUIRE(strides == expected);
+}
+
+TEST_CASE("Blocked filters accept only the planar or blocked layout", "[blocked_bloom]") {
+    BloomFilterOptions options;
+    options.slotLayout = SlotLayout::Interleaved;
+    REQUIRE_THROWS_AS(BlockedBloomFilter(1000, 0.01, 8, options), std::invalid_argument);
+
+    options.slotLayout = SlotLayout::Blocked;
+    BlockedBloomFilter requested(1000, 0.01, 8, options);
+    BlockedBloomFilter byDefault(1000, 0.01, 8);
+    REQUIRE(requested.getSlotLayout() == SlotLayout::Blocked);
+    REQUIRE(requested.getSize() == byDefault.getSize());
+    // only the blocks are allocated, no separate position planes
+    REQUIRE(requested.getMemoryBits() == requested.getSize());
+
+    // the base class still refuses the layout
+    REQUIRE_THROWS_AS(BloomFilter(1000, 0.01, 8, options), std::invalid_argument);
+}
+
+TEST_CASE("Blocked Position Tracking", "[blocked_bloom]") {
+    BlockedBloomFilter bf(1000, 0.01, 10);
+
+    SECTION("Basic position storage and retrieval") {
+        REQUIRE_FALSE(bf.mightContain("ATCG"));
+        REQUIRE(bf.add("ATCG", 42, 0));
+        REQUIRE(bf.mightContain("ATCG"));
+        REQUIRE(bf.getPosition("ATCG", 0) == 42);
+    }
+
+    SECTION("Conflicting position is rejected") {
+        REQUIRE(bf.add("ATCG", 42, 0));
+        REQUIRE(bf.add("ATCG", 42, 0));
+        REQUIRE_FALSE(bf.add("ATCG", 43, 0));
+        REQUIRE(bf.getPosition("ATCG", 0) == 42);
+    }
+
+    SECTION("Position bit boundary tests") {
+        REQUIRE(bf.add("test1", 1023, 0));
+        REQUIRE(bf.getPosition("test1", 0) == 1023);
+        REQUIRE_FALSE(bf.add("test2", 1024, 0));
+    }
+
+    SECTION("Accepted k-mers decode and FPR stays close to target") {
+        std::vector<bool> accepted(1000);
+        for (std::size_t i = 0; i < 1000; i++) {
+            accepted[i] = bf.add("element" + std::to_string(i), i, 0);
+        }
+        for (std::size_t i = 0; i < 1000; i++) {
+            if (accepted[i]) {
+                REQUIRE(bf.getPosition("element" + std::to_string(i), 0) == i);
+            }
+        }
+
+        std::size_t falsePositives = 0;
+        for (std::size_t i = 0; i < 10000; i++) {
+            if (bf.mightContain("test" + std::to_string(i))) falsePositives++;
+        }
+        REQUIRE(static_cast<double>(falsePositives) / 10000 < 0.01 * 2);
+    }
+}
+
 // ------------------ Predetermined Bloom Filter ------------------ //
 TEST_CASE("Basic Testing", "[pre_bloom]") {
     PredeterminedHashBloomFilter bf(1000, 0.01, 10, 6);
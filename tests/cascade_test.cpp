@@ -0,0 +1,377 @@
+#include <catch2/catch_all.hpp>
+#include "bloomFilterCascade.h"
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> randomKmers(std::size_t count, std::size_t k, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> kmers(count, std::string(k, 'A'));
+    for (auto& kmer : kmers) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+    }
+    return kmers;
+}
+
+// Every k-mer must decode to its original position, shadowed ones included.
+void requireOriginalPositions(const BloomFilterCascade& cascade, const std::vector<std::string>& kmers) {
+    REQUIRE(cascade.isRouted());
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(cascade.lookup(kmers[i]) == i);
+    }
+}
+}
+
+TEST_CASE("Cascade keeps original positions across rounds", "[cascade]") {
+    auto kmers = randomKmers(3000, 31, 1);
+
+    for (FilterKind kind : { FilterKind::Standard, FilterKind::Partitioned,
+        FilterKind::Predetermined, FilterKind::Blocked }) {
+        CascadeConfig config;
+        config.kind = kind;
+        config.falsePositiveRate = 0.001;
+        config.numHash = 12;
+        config.positionBits = 12;
+        config.seed = 42;
+
+        BloomFilterCascade cascade(config);
+        cascade.build(kmers);
+
+        REQUIRE(cascade.numRounds() > 1);
+        const auto& stats = cascade.getRoundStats();
+        std::size_t inserted = 0;
+        for (std::size_t r = 0; r < stats.size(); r++) {
+            REQUIRE(stats[r].round == r);
+            REQUIRE(stats[r].inserted > 0);
+            if (r > 0) REQUIRE(stats[r].attempted == stats[r - 1].attempted - stats[r - 1].inserted);
+            inserted += stats[r].inserted;
+        }
+        REQUIRE(inserted == kmers.size());
+
+        requireOriginalPositions(cascade, kmers);
+    }
+}
+
+TEST_CASE("Repeated k-mers keep their first position", "[cascade]") {
+    auto distinct = randomKmers(1000, 31, 21);
+    std::string polyA(31, 'A');
+    std::string polyT(31, 'T');
+
+    for (bool canonical : { false, true }) {
+        for (bool routed : { false, true }) {
+            CascadeConfig config;
+            config.positionBits = 12;
+            config.canonical = canonical;
+            config.routed = routed;
+
+            BloomFilterCascade plain(config);
+            plain.build(distinct);
+
+            // 63 more copies of poly-A than maxRounds leaves room for, on both
+            // strands in canonical mode, plus copies of the distinct k-mers
+            std::vector<std::string> kmers = distinct;
+            for (int copy = 0; copy < 63; copy++) kmers.push_back(copy % 2 && canonical ? polyT : polyA);
+            for (std::size_t i = 0; i < 200; i++) kmers.push_back(distinct[i]);
+            BloomFilterCascade cascade(config);
+            cascade.build(kmers);
+
+            REQUIRE(cascade.numRounds() <= plain.numRounds() + 1);
+            std::size_t inserted = 0;
+            for (const auto& round : cascade.getRoundStats()) inserted += round.inserted;
+            REQUIRE(inserted == distinct.size() + 1);
+            if (routed) {
+                for (std::size_t i = 0; i < distinct.size(); i++) REQUIRE(cascade.lookup(distinct[i]) == i);
+                REQUIRE(cascade.lookup(polyA) == distinct.size());
+            }
+            if (canonical && routed) {
+                REQUIRE(cascade.lookupStranded(polyT).position == distinct.size());
+                REQUIRE(cascade.lookupStranded(polyT).reverse);
+            }
+        }
+    }
+}
+
+TEST_CASE("Cascade stats dump every round", "[cascade][stats]") {
+    auto kmers = randomKmers(3000, 31, 8);
+    CascadeConfig config;
+    config.falsePositiveRate = 0.001;
+    config.numHash = 12;
+    config.positionBits = 12;
+    BloomFilterCascade cascade(config);
+    cascade.build(kmers);
+
+    std::ostringstream json;
+    cascade.dumpStats(json);
+    std::string dumped = json.str();
+    REQUIRE(dumped.find("\"numKmers\":3000,") != std::string::npos);
+    for (std::size_t r = 0; r < cascade.numRounds(); r++) {
+        REQUIRE(dumped.find("{\"round\":" + std::to_string(r) + ",") != std::string::npos);
+        // a round's filter saw exactly the k-mers the round attempted
+        FilterStats stats = cascade.getRound(r).getStats();
+        if (STATS_ENABLED) {
+            REQUIRE(stats.adds == cascade.getRoundStats()[r].attempted);
+            REQUIRE(stats.accepted == cascade.getRoundStats()[r].inserted);
+        }
+    }
+    REQUIRE(dumped.back() == '}');
+}
+
+TEST_CASE("Cascade batch lookup matches single lookup", "[cascade][batch]") {
+    auto kmers = randomKmers(2000, 31, 2);
+    auto absent = randomKmers(500, 31, 3);
+
+    CascadeConfig config;
+    config.positionBits = 11;
+    BloomFilterCascade cascade(config);
+    cascade.build(kmers);
+
+    std::vector<std::string> queries = kmers;
+    queries.insert(queries.end(), absent.begin(), absent.end());
+    std::vector<uint64_t> positions(queries.size());
+    cascade.lookupBatch(queries, positions);
+
+    for (std::size_t j = 0; j < queries.size(); j++) {
+        REQUIRE(positions[j] == cascade.lookup(queries[j]));
+    }
+}
+
+TEST_CASE("Cascade rejects positions that cannot be encoded", "[cascade]") {
+    CascadeConfig config;
+    config.positionBits = 4;
+    BloomFilterCascade cascade(config);
+
+    std::vector<std::string> kmers = { "ACGT", "TTTT" };
+    REQUIRE_THROWS_AS(cascade.build(kmers, { 3, 16 }), std::invalid_argument);
+    REQUIRE_THROWS_AS(cascade.build(kmers, { 3 }), std::invalid_argument);
+    REQUIRE(cascade.lookup("ACGT") == BloomFilterCascade::NOT_FOUND);
+}
+
+TEST_CASE("Adaptive sizing shrinks later rounds", "[cascade][sizing]") {
+    auto kmers = randomKmers(4000, 31, 4);
+
+    CascadeConfig config;
+    config.kind = FilterKind::Predetermined;
+    config.numHash = 12;
+    config.positionBits = 12;
+
+    config.sizing.mode = CascadeSizingPolicy::Mode::Fixed;
+    BloomFilterCascade fixed(config);
+    fixed.build(kmers);
+
+    config.sizing.mode = CascadeSizingPolicy::Mode::Adaptive;
+    config.sizing.laterRoundNumHash = 8;
+    BloomFilterCascade adaptive(config);
+    adaptive.build(kmers);
+
+    const auto& stats = adaptive.getRoundStats();
+    REQUIRE(stats.size() > 1);
+    REQUIRE(stats[0].sizedFor == kmers.size());
+    REQUIRE(stats[0].numHash == 12);
+    for (std::size_t r = 1; r < stats.size(); r++) {
+        REQUIRE(stats[r].sizedFor == std::max(stats[r].attempted, config.sizing.minElements));
+        REQUIRE(stats[r].numHash == 8);
+        REQUIRE(stats[r].memoryBits < stats[0].memoryBits);
+    }
+    for (const auto& round : fixed.getRoundStats()) {
+        REQUIRE(round.sizedFor == kmers.size());
+    }
+
+    REQUIRE(adaptive.getBitsPerKmer() < fixed.getBitsPerKmer());
+    REQUIRE(adaptive.getBitsPerKmer() == static_cast<double>(adaptive.getMemoryBits()) / kmers.size());
+    requireOriginalPositions(adaptive, kmers);
+}
+
+TEST_CASE("Sizing load factor must be positive", "[cascade][sizing]") {
+    CascadeConfig config;
+    config.sizing.loadFactor = 0.0;
+    REQUIRE_THROWS_AS(BloomFilterCascade(config), std::invalid_argument);
+}
+
+TEST_CASE("Canonical cascade answers for both strands", "[cascade][canonical]") {
+    auto kmers = randomKmers(2000, 31, 5);
+
+    CascadeConfig config;
+    config.positionBits = 11;
+    config.canonical = true;
+    BloomFilterCascade cascade(config);
+    cascade.build(kmers);
+    REQUIRE(cascade.getRound(0).getPositionBits() == 12);
+
+    std::vector<std::string> reverse;
+    for (const auto& kmer : kmers) {
+        std::string rc(kmer.rbegin(), kmer.rend());
+        for (auto& base : rc) {
+            base = base == 'A' ? 'T' : base == 'C' ? 'G' : base == 'G' ? 'C' : 'A';
+        }
+        reverse.push_back(rc);
+    }
+    std::vector<uint64_t> batch(reverse.size());
+    cascade.lookupBatch(reverse, batch);
+
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        StrandedPosition forward = cascade.lookupStranded(kmers[i]);
+        StrandedPosition opposite = cascade.lookupStranded(reverse[i]);
+        REQUIRE(forward.position == i);
+        REQUIRE_FALSE(forward.reverse);
+        REQUIRE(opposite.position == i);
+        REQUIRE(opposite.reverse);
+        REQUIRE(cascade.lookup(reverse[i]) == i);
+        REQUIRE(batch[i] == i);
+    }
+}
+
+TEST_CASE("Threaded cascade builds match single-threaded builds", "[cascade][parallel]") {
+    auto kmers = randomKmers(5000, 31, 6);
+
+    for (FilterKind kind : { FilterKind::Standard, FilterKind::Partitioned, FilterKind::Blocked }) {
+        CascadeConfig config;
+        config.kind = kind;
+        config.numHash = 8;
+        config.positionBits = 13;
+        config.seed = 17;
+        BloomFilterCascade single(config);
+        single.build(kmers);
+
+        for (unsigned threads : { 2u, 4u }) {
+            config.numThreads = threads;
+            BloomFilterCascade threaded(config);
+            threaded.build(kmers);
+
+            REQUIRE(threaded.numRounds() == single.numRounds());
+            for (std::size_t r = 0; r < single.numRounds(); r++) {
+                REQUIRE(threaded.getRoundStats()[r].inserted == single.getRoundStats()[r].inserted);
+                REQUIRE(threaded.getRoundStats()[r].shadowed == single.getRoundStats()[r].shadowed);
+            }
+            for (std::size_t i = 0; i < kmers.size(); i++) {
+                REQUIRE(threaded.lookup(kmers[i]) == single.lookup(kmers[i]));
+            }
+            requireOriginalPositions(threaded, kmers);
+        }
+    }
+}
+
+TEST_CASE("Routed cascade sends lookups to the owning round", "[cascade][router]") {
+    auto kmers = randomKmers(4000, 31, 7);
+    auto absent = randomKmers(4000, 31, 8);
+
+    CascadeConfig config;
+    config.kind = FilterKind::Standard;
+    config.positionBits = 12;
+    config.seed = 3;
+    config.routed = false;
+    BloomFilterCascade plain(config);
+    plain.build(kmers);
+    REQUIRE_FALSE(plain.isRouted());
+    config.routed = true;
+    BloomFilterCascade routed(config);
+    routed.build(kmers);
+
+    REQUIRE(routed.isRouted());
+    REQUIRE_FALSE(plain.isRouted());
+    REQUIRE(routed.numRounds() == plain.numRounds());
+    REQUIRE(routed.getRouterBits() > 0);
+    REQUIRE(routed.getMemoryBits() == plain.getMemoryBits() + routed.getRouterBits());
+
+    // no earlier round is consulted, so shadowed k-mers decode as well
+    std::vector<uint64_t> batch(kmers.size());
+    routed.lookupBatch(kmers, batch);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(routed.lookup(kmers[i]) == i);
+        REQUIRE(batch[i] == i);
+        REQUIRE(routed.mightContain(kmers[i]));
+    }
+
+    std::size_t plainHits = 0, routedHits = 0;
+    std::vector<uint64_t> absentBatch(absent.size());
+    routed.lookupBatch(absent, absentBatch);
+    for (std::size_t j = 0; j < absent.size(); j++) {
+        plainHits += plain.lookup(absent[j]) != BloomFilterCascade::NOT_FOUND;
+        uint64_t position = routed.lookup(absent[j]);
+        REQUIRE(absentBatch[j] == position);
+        REQUIRE(routed.mightContain(absent[j]) == (position != BloomFilterCascade::NOT_FOUND));
+        routedHits += position != BloomFilterCascade::NOT_FOUND;
+    }
+    REQUIRE(routedHits <= plainHits);
+}
+
+TEST_CASE("Router keeps the first round of repeated canonical keys", "[cascade][router][canonical]") {
+    // both strands of every k-mer: each canonical key is built twice
+    auto forward = randomKmers(1500, 31, 9);
+    std::vector<std::string> kmers = forward;
+    for (const auto& kmer : forward) {
+        std::string rc(kmer.rbegin(), kmer.rend());
+        for (auto& base : rc) {
+            base = base == 'A' ? 'T' : base == 'C' ? 'G' : base == 'G' ? 'C' : 'A';
+        }
+        kmers.push_back(rc);
+    }
+
+    CascadeConfig config;
+    config.positionBits = 12;
+    config.canonical = true;
+    BloomFilterCascade plain(config);
+    plain.build(kmers);
+    config.routed = true;
+    BloomFilterCascade routed(config);
+    routed.build(kmers);
+
+    REQUIRE(routed.numRounds() > 1);
+    for (const auto& kmer : kmers) {
+        StrandedPosition expected = plain.lookupStranded(kmer);
+        StrandedPosition actual = routed.lookupStranded(kmer);
+        REQUIRE(actual.position == expected.position);
+        REQUIRE(actual.reverse == expected.reverse);
+    }
+}
+
+TEST_CASE("Check bits let lookups pass rounds that garble a k-mer", "[cascade][check]") {
+    auto kmers = randomKmers(5000, 31, 21);
+    auto absent = randomKmers(5000, 31, 22);
+
+    CascadeConfig config;
+    config.falsePositiveRate = 0.05;
+    config.positionBits = 13;
+    // without a router, so lookups walk the rounds
+    config.routed = false;
+    BloomFilterCascade plain(config);
+    plain.build(kmers);
+    config.options.checkBits = 10;
+    BloomFilterCascade checked(config);
+    checked.build(kmers);
+    REQUIRE(checked.getRound(0).getCheckBits() == 10);
+
+    std::size_t plainWrong = 0;
+    std::size_t checkedWrong = 0;
+    std::vector<uint64_t> batch(kmers.size());
+    checked.lookupBatch(kmers, batch);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        plainWrong += plain.lookup(kmers[i]) != i;
+        uint64_t position = checked.lookup(kmers[i]);
+        REQUIRE(batch[i] == position);
+        checkedWrong += position != i;
+    }
+    std::size_t shadowed = 0;
+    for (const auto& round : checked.getRoundStats()) shadowed += round.shadowed;
+    REQUIRE(plainWrong > 0);
+    REQUIRE(checkedWrong <= shadowed);
+    REQUIRE(checkedWrong * 10 < plainWrong);
+
+    std::size_t plainClaimed = 0;
+    std::size_t checkedClaimed = 0;
+    std::vector<uint64_t> absentBatch(absent.size());
+    checked.lookupBatch(absent, absentBatch);
+    for (std::size_t i = 0; i < absent.size(); i++) {
+        plainClaimed += plain.lookup(absent[i]) != BloomFilterCascade::NOT_FOUND;
+        uint64_t position = checked.lookup(absent[i]);
+        REQUIRE(absentBatch[i] == position);
+        REQUIRE(position != BloomFilter::AMBIGUOUS);
+        checkedClaimed += position != BloomFilterCascade::NOT_FOUND;
+    }
+    REQUIRE(checkedClaimed * 10 < plainClaimed);
+
+    config.options.checkBits = 52;
+    REQUIRE_THROWS_AS(BloomFilterCascade(config), std::invalid_argument);
+}
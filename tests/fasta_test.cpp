@@ -0,0 +1,128 @@
+#include <catch2/catch_all.hpp>
+#include "fastaReader.h"
+#include "rollingHash.h"
+#include "bloomfilter.h"
+#include "partitionedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::string writeFasta(const std::string& name, const std::string& contents) {
+    std::string path = (std::filesystem::temp_directory_path() / ("kmer_encoding_" + name)).string();
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    return path;
+}
+}
+
+TEST_CASE("Rolling hash matches hashing each k-mer directly", "[fasta][rolling]") {
+    std::mt19937_64 rng(5);
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::string sequence(500, 'A');
+    for (auto& base : sequence) base = bases[rng() & 3];
+
+    for (unsigned k : { 1u, 21u, 31u, 37u, 64u }) {
+        RollingKmerHasher hasher(k);
+        for (std::size_t i = 0; i < sequence.size(); i++) {
+            bool full = hasher.push(encodeBase(sequence[i]));
+            REQUIRE(full == (i + 1 >= k));
+            if (full) {
+                std::string kmer = sequence.substr(i + 1 - k, k);
+                REQUIRE(hasher.getHash() == RollingKmerHasher::hashOf(kmer));
+                uint128 packed = 0;
+                for (char base : kmer) packed = (packed << 2) | encodeBase(base);
+                REQUIRE(hasher.getPacked() == packed);
+            }
+        }
+    }
+    REQUIRE_THROWS_AS(RollingKmerHasher(65), std::invalid_argument);
+}
+
+TEST_CASE("FastaReader streams k-mers with their coordinates", "[fasta]") {
+    // two wrapped records, lowercase bases and an N that breaks the window
+    std::string path = writeFasta("reader.fa",
+        ">chr1 first record\nACGTAC\ngtNACG\nTTGA\n"
+        ">chr2\r\nGGGCCCAAAT\r\n");
+    std::string chr1 = "ACGTACGTNACGTTGA";
+    std::string chr2 = "GGGCCCAAAT";
+
+    // small buffer so refills land inside lines and headers
+    FastaReader reader(path, 7);
+    const unsigned k = 5;
+    std::vector<KmerOccurrence> occurrences;
+    uint64_t produced = reader.forEachKmer(k, [&](const KmerOccurrence& kmer) {
+        occurrences.push_back(kmer);
+        });
+
+    const auto& records = reader.getRecords();
+    REQUIRE(records.size() == 2);
+    REQUIRE(records[0].name == "chr1");
+    REQUIRE(records[0].length == chr1.size());
+    REQUIRE(records[1].name == "chr2");
+    REQUIRE(records[1].start == chr1.size());
+    REQUIRE(reader.getTotalLength() == chr1.size() + chr2.size());
+
+    std::vector<std::pair<std::size_t, std::string>> expected;
+    for (std::size_t r = 0; r < 2; r++) {
+        const std::string& sequence = r == 0 ? chr1 : chr2;
+        for (std::size_t i = 0; i + k <= sequence.size(); i++) {
+            std::string kmer = sequence.substr(i, k);
+            if (kmer.find('N') == std::string::npos) expected.emplace_back(r, kmer);
+        }
+    }
+    REQUIRE(produced == expected.size());
+    REQUIRE(occurrences.size() == expected.size());
+
+    for (std::size_t j = 0; j < occurrences.size(); j++) {
+        const auto& occurrence = occurrences[j];
+        const std::string& sequence = occurrence.record == 0 ? chr1 : chr2;
+        REQUIRE(occurrence.record == expected[j].first);
+        REQUIRE(sequence.substr(occurrence.offset, k) == expected[j].second);
+        REQUIRE(occurrence.coordinate == records[occurrence.record].start + occurrence.offset);
+        REQUIRE(occurrence.hash == RollingKmerHasher::hashOf(expected[j].second));
+    }
+
+    // a second scan with another k starts from the beginning again
+    REQUIRE(reader.forEachKmer(16, [](const KmerOccurrence&) {}) == 0);
+    REQUIRE(reader.forEachKmer(10, [](const KmerOccurrence&) {}) == 1);
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Pre-hashed k-mers round-trip through every filter", "[fasta][bloom]") {
+    std::mt19937_64 rng(6);
+    std::vector<uint64_t> hashes(2000);
+    for (auto& hash : hashes) hash = rng();
+
+    std::vector<std::unique_ptr<BloomFilter>> filters;
+    filters.push_back(std::make_unique<BloomFilter>(hashes.size(), 0.001, 11));
+    filters.push_back(std::make_unique<BloomFilter>(hashes.size(), 0.001, 11,
+        BloomFilterOptions{ HashScheme::DoubleHashing, SlotLayout::Interleaved, true }));
+    filters.push_back(std::make_unique<PartitionedBloomFilter>(hashes.size(), 0.001, 11));
+    filters.push_back(std::make_unique<BlockedBloomFilter>(hashes.size(), 0.001, 11));
+
+    for (auto& filter : filters) {
+        std::size_t accepted = 0;
+        std::vector<bool> added(hashes.size());
+        for (std::size_t i = 0; i < hashes.size(); i++) {
+            added[i] = filter->addHashed(hashes[i], i, 3);
+            accepted += added[i];
+        }
+        // colliding items are rejected as with string keys
+        REQUIRE(accepted > hashes.size() / 4);
+        for (std::size_t i = 0; i < hashes.size(); i++) {
+            if (!added[i]) continue;
+            REQUIRE(filter->mightContainHashed(hashes[i], 3));
+            REQUIRE(filter->getPositionHashed(hashes[i], 3) == i);
+        }
+
+        std::size_t falsePositives = 0;
+        for (int j = 0; j < 2000; j++) {
+            falsePositives += filter->mightContainHashed(rng(), 3);
+        }
+        REQUIRE(falsePositives < 40);
+    }
+}
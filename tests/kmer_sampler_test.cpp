@@ -0,0 +1,225 @@
+#include <catch2/catch_all.hpp>
+#include "kmerSampler.h"
+#include "fastaReader.h"
+#include "packedKmer.h"
+#include "readMapper.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+std::string randomSequence(std::size_t length, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::string sequence(length, 'A');
+    for (auto& base : sequence) base = bases[rng() & 3];
+    return sequence;
+}
+
+std::string reverseComplement(const std::string& sequence) {
+    std::string rc(sequence.rbegin(), sequence.rend());
+    for (auto& base : rc) base = "TGCA"[encodeBase(base)];
+    return rc;
+}
+
+SamplingConfig minimizerConfig(unsigned w) {
+    SamplingConfig config;
+    config.scheme = SamplingScheme::Minimizer;
+    config.w = w;
+    return config;
+}
+
+SamplingConfig syncmerConfig(SamplingScheme scheme, unsigned s, unsigned t = 0) {
+    SamplingConfig config;
+    config.scheme = scheme;
+    config.s = s;
+    config.t = t;
+    return config;
+}
+
+std::vector<std::size_t> sampledOffsets(KmerSampler& sampler, const std::string& sequence) {
+    std::vector<std::size_t> offsets;
+    sampler.forEachSampled(sequence, [&](std::size_t offset) { offsets.push_back(offset); });
+    return offsets;
+}
+}
+
+TEST_CASE("Minimizers are the smallest k-mer of every window", "[sampling]") {
+    const unsigned k = 21;
+    std::string sequence = randomSequence(5000, 1);
+
+    for (unsigned w : { 1u, 5u, 10u, 24u }) {
+        KmerSampler sampler(k, minimizerConfig(w));
+        auto offsets = sampledOffsets(sampler, sequence);
+
+        std::set<std::size_t> expected;
+        std::size_t count = sequence.size() - k + 1;
+        std::vector<uint64_t> order(count);
+        for (std::size_t i = 0; i < count; i++) order[i] = mix64(RollingKmerHasher::hashOf(sequence.substr(i, k)));
+        for (std::size_t start = 0; start + w <= count; start++) {
+            expected.insert(std::min_element(order.begin() + start, order.begin() + start + w) - order.begin());
+        }
+        REQUIRE(std::vector<std::size_t>(expected.begin(), expected.end()) == offsets);
+
+        const auto& stats = sampler.getStats();
+        REQUIRE(stats.kmers == count);
+        REQUIRE(stats.sampled == offsets.size());
+        REQUIRE(stats.bases == sequence.size());
+        if (w > 1) {
+            REQUIRE(stats.density() > 0.85 * 2.0 / (w + 1));
+            REQUIRE(stats.density() < 1.15 * 2.0 / (w + 1));
+        }
+    }
+}
+
+TEST_CASE("Syncmers are decided by the k-mer alone", "[sampling]") {
+    const unsigned k = 31;
+    std::string sequence = randomSequence(8000, 2);
+
+    for (auto scheme : { SamplingScheme::OpenSyncmer, SamplingScheme::ClosedSyncmer }) {
+        SamplingConfig config = syncmerConfig(scheme, 15, 8);
+        KmerSampler sampler(k, config);
+        auto offsets = sampledOffsets(sampler, sequence);
+        std::set<std::size_t> sampled(offsets.begin(), offsets.end());
+
+        KmerSampler single(k, config);
+        for (std::size_t i = 0; i + k <= sequence.size(); i++) {
+            bool alone = !sampledOffsets(single, sequence.substr(i, k)).empty();
+            REQUIRE(alone == sampled.contains(i));
+        }
+
+        double expected = (scheme == SamplingScheme::OpenSyncmer ? 1.0 : 2.0) / (k - config.s + 1);
+        REQUIRE(sampler.getStats().density() > 0.8 * expected);
+        REQUIRE(sampler.getStats().density() < 1.2 * expected);
+    }
+
+    REQUIRE_THROWS_AS(KmerSampler(k, syncmerConfig(SamplingScheme::ClosedSyncmer, 31)),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(KmerSampler(k, syncmerConfig(SamplingScheme::OpenSyncmer, 11, 21)),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(KmerSampler(k, minimizerConfig(0)),
+        std::invalid_argument);
+}
+
+TEST_CASE("Canonical sampling picks the same k-mers on both strands", "[sampling]") {
+    const unsigned k = 25;
+    std::string sequence = randomSequence(3000, 3);
+    std::string rc = reverseComplement(sequence);
+
+    for (auto scheme : { SamplingScheme::Minimizer, SamplingScheme::ClosedSyncmer }) {
+        SamplingConfig config;
+        config.scheme = scheme;
+        config.w = 8;
+        config.s = 9;
+        config.canonical = true;
+        KmerSampler sampler(k, config);
+        auto forward = sampledOffsets(sampler, sequence);
+        std::vector<std::size_t> mirrored;
+        for (std::size_t offset : sampledOffsets(sampler, rc)) mirrored.push_back(sequence.size() - k - offset);
+        std::sort(mirrored.begin(), mirrored.end());
+        REQUIRE(forward == mirrored);
+    }
+}
+
+TEST_CASE("Sampling splits runs at N and keeps short runs", "[sampling]") {
+    const unsigned k = 11;
+    std::string left = randomSequence(200, 4);
+    std::string right = randomSequence(15, 5);
+    KmerSampler sampler(k, minimizerConfig(10));
+    auto offsets = sampledOffsets(sampler, left + "N" + right);
+
+    KmerSampler alone(k, minimizerConfig(10));
+    auto expected = sampledOffsets(alone, left);
+    // the 5 k-mers after the N never fill a window, but their minimum is kept
+    auto tail = sampledOffsets(alone, right);
+    REQUIRE(tail.size() == 1);
+    expected.push_back(left.size() + 1 + tail[0]);
+    REQUIRE(offsets == expected);
+    REQUIRE(sampler.getStats().bases == left.size() + right.size());
+}
+
+TEST_CASE("FASTA k-mers are sampled per run", "[sampling][fasta]") {
+    const unsigned k = 21;
+    std::string chr1 = randomSequence(3000, 6);
+    std::string chr2 = randomSequence(1000, 7);
+    chr1[1500] = 'N';
+    std::string path = (std::filesystem::temp_directory_path() / "kmer_encoding_sampled.fa").string();
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << ">chr1\n";
+        for (std::size_t i = 0; i < chr1.size(); i += 60) out << chr1.substr(i, 60) << "\n";
+        out << ">chr2\n" << chr2 << "\n";
+    }
+
+    SamplingConfig config = minimizerConfig(12);
+    FastaReader reader(path, 100);
+    KmerSampler sampler(k, config);
+    std::vector<uint64_t> coordinates;
+    uint64_t produced = reader.forEachSampledKmer(sampler, [&](const KmerOccurrence& kmer) {
+        REQUIRE(kmer.coordinate == reader.getRecords()[kmer.record].start + kmer.offset);
+        coordinates.push_back(kmer.coordinate);
+        });
+    REQUIRE(produced == coordinates.size());
+
+    KmerSampler direct(k, config);
+    std::vector<uint64_t> expected;
+    for (std::size_t offset : sampledOffsets(direct, chr1)) expected.push_back(offset);
+    for (std::size_t offset : sampledOffsets(direct, chr2)) expected.push_back(chr1.size() + offset);
+    REQUIRE(coordinates == expected);
+    REQUIRE(sampler.getStats().sampled == produced);
+    REQUIRE(sampler.getStats().bases == chr1.size() - 1 + chr2.size());
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Reads map against a minimizer-sampled index", "[sampling][mapper]") {
+    const unsigned k = 31;
+    std::string reference = randomSequence(50000, 8);
+    SamplingConfig sampling = minimizerConfig(10);
+
+    KmerSampler sampler(k, sampling);
+    std::vector<std::string> kmers;
+    std::vector<uint64_t> positions;
+    sampler.forEachSampled(reference, [&](std::size_t offset) {
+        kmers.push_back(reference.substr(offset, k));
+        positions.push_back(offset);
+        });
+    REQUIRE(kmers.size() < (reference.size() - k + 1) / 4);
+
+    CascadeConfig cascadeConfig;
+    cascadeConfig.falsePositiveRate = 0.01;
+    cascadeConfig.positionBits = 16;
+    cascadeConfig.routed = true;
+    BloomFilterCascade cascade(cascadeConfig);
+    cascade.build(kmers, positions);
+    REQUIRE(sampler.getStats().bitsPerBase(cascade.getMemoryBits())
+        < static_cast<double>(cascade.getMemoryBits()) / kmers.size() / 4);
+
+    std::mt19937_64 rng(9);
+    std::vector<std::string> reads;
+    std::vector<uint64_t> starts;
+    for (int i = 0; i < 300; i++) {
+        uint64_t start = rng() % (reference.size() - 150);
+        std::string read = reference.substr(start, 150);
+        if (rng() % 50 == 0) read[rng() % 150] = 'A';
+        reads.push_back(i % 2 ? reverseComplement(read) : read);
+        starts.push_back(start);
+    }
+
+    MapperConfig config;
+    config.k = k;
+    config.numThreads = 2;
+    config.sampling = sampling;
+    ReadMapper mapper(cascade, config);
+    auto placements = mapper.mapReads(reads);
+    std::size_t correct = 0;
+    for (std::size_t i = 0; i < reads.size(); i++) {
+        correct += placements[i].position == starts[i] && placements[i].reverse == (i % 2 == 1);
+        // about 2 / (w + 1) of the read's 120 k-mers are looked up
+        REQUIRE(placements[i].kmers < 40);
+    }
+    REQUIRE(correct >= reads.size() * 97 / 100);
+}
@@ -0,0 +1,128 @@
+#include <catch2/catch_all.hpp>
+#include "mphPositionIndex.h"
+#include <filesystem>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> distinctKmers(std::size_t count, std::size_t k, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::set<std::string> seen;
+    std::vector<std::string> kmers;
+    std::string kmer(k, 'A');
+    while (kmers.size() < count) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+        if (seen.insert(kmer).second) kmers.push_back(kmer);
+    }
+    return kmers;
+}
+}
+
+TEST_CASE("MPH index returns every original position", "[mph]") {
+    auto kmers = distinctKmers(5000, 31, 21);
+
+    MphConfig config;
+    SECTION("Single function") {}
+    SECTION("Partitioned, multi-threaded") {
+        config.partitioned = true;
+        config.avgPartitionSize = 1000;
+        config.numThreads = 4;
+    }
+    SECTION("External memory") {
+        config.externalMemory = true;
+        config.tmpDir = std::filesystem::temp_directory_path().string();
+    }
+
+    MphPositionIndex index(config);
+    index.build(kmers);
+    REQUIRE(index.size() == kmers.size());
+    REQUIRE(index.getPositionBits() == 13);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(index.lookup(kmers[i]) == i);
+    }
+
+    std::vector<uint64_t> positions(kmers.size());
+    index.lookupBatch(kmers, positions);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(positions[i] == i);
+    }
+    REQUIRE(index.getMemoryBits() > index.getFunctionBits());
+}
+
+TEST_CASE("MPH fingerprints reject absent k-mers", "[mph]") {
+    auto kmers = distinctKmers(4000, 31, 22);
+    std::vector<std::string> present(kmers.begin(), kmers.begin() + 3000);
+    std::vector<std::string> absent(kmers.begin() + 3000, kmers.end());
+
+    MphConfig config;
+    config.fingerprintBits = 12;
+    MphPositionIndex index(config);
+    index.build(present);
+
+    std::size_t falsePositives = 0;
+    for (const auto& kmer : absent) {
+        if (index.mightContain(kmer)) falsePositives++;
+    }
+    // expected about 1000 / 4096
+    REQUIRE(falsePositives < 10);
+    for (std::size_t i = 0; i < present.size(); i++) {
+        REQUIRE(index.lookup(present[i]) == i);
+    }
+
+    MphConfig bare;
+    MphPositionIndex withoutFingerprints(bare);
+    withoutFingerprints.build(present);
+    REQUIRE(withoutFingerprints.getMemoryBits() < index.getMemoryBits());
+}
+
+TEST_CASE("MPH entries wider than a byte-aligned load decode", "[mph]") {
+    auto kmers = distinctKmers(2000, 31, 23);
+    std::mt19937_64 rng(24);
+    std::vector<uint64_t> positions(kmers.size());
+    for (auto& position : positions) position = rng() >> 23;
+
+    // 61-bit entries straddle word boundaries at every bit offset
+    MphConfig config;
+    config.positionBits = 41;
+    config.fingerprintBits = 20;
+    MphPositionIndex index(config);
+    index.build(kmers, positions);
+    std::vector<uint64_t> batch(kmers.size());
+    index.lookupBatch(kmers, batch);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(index.lookup(kmers[i]) == positions[i]);
+        REQUIRE(batch[i] == positions[i]);
+    }
+
+    config.positionBits = 44;
+    MphPositionIndex full(config);
+    full.build(kmers, positions);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(full.lookup(kmers[i]) == positions[i]);
+    }
+}
+
+TEST_CASE("MPH index validates positions", "[mph]") {
+    MphConfig config;
+    config.positionBits = 4;
+    MphPositionIndex index(config);
+
+    std::vector<std::string> kmers = { "ACGT", "TTTT" };
+    REQUIRE_THROWS_AS(index.build(kmers, { 3, 16 }), std::invalid_argument);
+    REQUIRE_THROWS_AS(index.build(kmers, { 3 }), std::invalid_argument);
+    REQUIRE(index.lookup("ACGT") == MphPositionIndex::NOT_FOUND);
+
+    config.fingerprintBits = 61;
+    REQUIRE_THROWS_AS(MphPositionIndex(config), std::invalid_argument);
+
+    // the automatic width is held to 63 bits like an explicit one
+    MphPositionIndex automatic{ MphConfig{} };
+    REQUIRE_THROWS_AS(automatic.build(kmers, { 3, 1ULL << 63 }), std::invalid_argument);
+    automatic.build(kmers, { 3, (1ULL << 63) - 1 });
+    REQUIRE(automatic.getPositionBits() == 63);
+    REQUIRE(automatic.lookup("TTTT") == (1ULL << 63) - 1);
+    REQUIRE(automatic.lookup("ACGT") == 3);
+}
@@ -0,0 +1,222 @@
+#include <catch2/catch_all.hpp>
+#include "packedKmer.h"
+#include "bloomfilter.h"
+#include "partitionedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include "fastaReader.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+template <unsigned K>
+std::vector<PackedKmer<K>> randomPackedKmers(std::size_t count, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::set<std::string> seen;
+    std::vector<PackedKmer<K>> kmers;
+    std::string kmer(K, 'A');
+    while (kmers.size() < count) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+        if (seen.insert(kmer).second) kmers.push_back(PackedKmer<K>::fromString(kmer));
+    }
+    return kmers;
+}
+
+template <unsigned K>
+void requirePackedRoundTrip(BloomFilter& filter, std::size_t count) {
+    auto kmers = randomPackedKmers<K>(count, K);
+
+    std::vector<bool> added(kmers.size());
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        added[i] = filter.add(kmers[i], i, 9);
+    }
+
+    std::vector<uint64_t> positions(kmers.size());
+    filter.getPositionBatch<K>(kmers, positions, 9);
+    std::vector<uint8_t> present(kmers.size());
+    filter.mightContainBatch<K>(kmers, present, 9);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(positions[i] == filter.getPosition(kmers[i], 9));
+        REQUIRE(static_cast<bool>(present[i]) == filter.mightContain(kmers[i], 9));
+        if (!added[i]) continue;
+        REQUIRE(filter.mightContain(kmers[i], 9));
+        REQUIRE(positions[i] == i);
+    }
+}
+}
+
+TEST_CASE("128-bit k-mer words carry across their two halves", "[packed]") {
+    const uint128 one = 1;
+    REQUIRE(static_cast<uint64_t>((one << 100) >> 100) == 1);
+    REQUIRE(static_cast<uint64_t>((one << 64) >> 64) == 1);
+    REQUIRE(static_cast<uint64_t>(one << 64) == 0);
+    REQUIRE(static_cast<uint64_t>((one << 70) >> 64) == 64);
+    REQUIRE(static_cast<uint64_t>(((one << 63) << 1) >> 1) == 1ULL << 63);
+
+    uint128 lowMask = (one << 64) - 1;
+    REQUIRE(static_cast<uint64_t>(lowMask) == ~0ULL);
+    REQUIRE(static_cast<uint64_t>(lowMask >> 64) == 0);
+    REQUIRE(static_cast<uint64_t>((lowMask + 1) >> 64) == 1);
+    REQUIRE(static_cast<uint64_t>(~uint128(0) >> 64) == ~0ULL);
+    REQUIRE(((~lowMask) | lowMask) == ~uint128(0));
+    REQUIRE(((~lowMask) & lowMask) == 0);
+
+    // ordered by the high word first
+    REQUIRE(lowMask < (one << 64));
+    REQUIRE_FALSE((one << 64) < lowMask);
+    REQUIRE((one << 127) > (one << 126));
+
+    REQUIRE(mulHigh64(~0ULL, ~0ULL) == ~0ULL - 1);
+    REQUIRE(mulHigh64(1ULL << 40, 1ULL << 30) == 1ULL << 6);
+    REQUIRE(byteSwap64(0x0102030405060708ULL) == 0x0807060504030201ULL);
+}
+
+TEST_CASE("PackedKmer packs and unpacks 2-bit bases", "[packed]") {
+    auto kmer31 = PackedKmer<31>::fromString("ACGTACGTACGTACGTACGTACGTACGTACG");
+    REQUIRE(kmer31.toString() == "ACGTACGTACGTACGTACGTACGTACGTACG");
+    REQUIRE(PackedKmer<4>::fromString("acgt").bits == 0b00011011);
+
+    std::string long37 = "TTTCTCTCAACTCAACAAAATGATTGGGCGACACGGG";
+    REQUIRE(PackedKmer<37>::fromString(long37).toString() == long37);
+    std::string full64(64, 'T');
+    REQUIRE(PackedKmer<64>::fromString(full64).bits == PackedKmer<64>::MASK);
+    REQUIRE(PackedKmer<32>::fromString(std::string(32, 'T')).bits == ~0ULL);
+
+    REQUIRE_THROWS_AS(PackedKmer<4>::fromString("ACG"), std::invalid_argument);
+    REQUIRE_THROWS_AS(PackedKmer<4>::fromString("ACNT"), std::invalid_argument);
+
+    // equal bits at different k must not hash alike
+    REQUIRE(PackedKmer<3>::fromString("AAA").hash() != PackedKmer<4>::fromString("AAAA").hash());
+}
+
+TEST_CASE("PackedKmer matches the rolling window of a FASTA scan", "[packed][fasta]") {
+    std::string sequence = "ACGTTGCAAGGCTTACGATCGATCGGATCCATGCAAATTTGGGCCCATATAGCGC";
+    std::string path = (std::filesystem::temp_directory_path() / "kmer_encoding_packed.fa").string();
+    {
+        std::ofstream out(path);
+        out << ">seq\n" << sequence << "\n";
+    }
+
+    FastaReader reader(path);
+    reader.forEachKmer(37, [&](const KmerOccurrence& occurrence) {
+        auto kmer = PackedKmer<37>::fromPacked(occurrence.packed);
+        REQUIRE(kmer.toString() == sequence.substr(occurrence.offset, 37));
+        });
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Filters accept packed k-mer keys", "[packed][bloom]") {
+    SECTION("Standard filter, k = 31") {
+        BloomFilter filter(2000, 0.001, 11);
+        requirePackedRoundTrip<31>(filter, 2000);
+    }
+    SECTION("Partitioned filter, k = 37") {
+        PartitionedBloomFilter filter(2000, 0.001, 11);
+        requirePackedRoundTrip<37>(filter, 2000);
+    }
+    SECTION("Blocked filter, k = 64") {
+        BlockedBloomFilter filter(2000, 0.001, 11);
+        requirePackedRoundTrip<64>(filter, 2000);
+    }
+}
+
+namespace {
+std::string reverseComplementOf(const std::string& kmer) {
+    std::string rc(kmer.rbegin(), kmer.rend());
+    for (auto& base : rc) {
+        base = base == 'A' ? 'T' : base == 'C' ? 'G' : base == 'G' ? 'C' : 'A';
+    }
+    return rc;
+}
+
+template <unsigned K>
+void requireReverseComplements(std::mt19937_64& rng) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::string kmer(K, 'A');
+    for (int trial = 0; trial < 200; trial++) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+        auto packed = PackedKmer<K>::fromString(kmer);
+        std::string rc = reverseComplementOf(kmer);
+        REQUIRE(packed.reverseComplement().toString() == rc);
+
+        bool reversed;
+        REQUIRE(packed.canonical(reversed).toString() == std::min(kmer, rc));
+        REQUIRE(reversed == (rc < kmer));
+        bool stringReversed;
+        REQUIRE(canonicalKmer(kmer, stringReversed) == std::min(kmer, rc));
+        REQUIRE(stringReversed == reversed);
+    }
+}
+}
+
+TEST_CASE("Reverse complement of packed k-mers", "[packed][canonical]") {
+    std::mt19937_64 rng(8);
+    requireReverseComplements<1>(rng);
+    requireReverseComplements<5>(rng);
+    requireReverseComplements<31>(rng);
+    requireReverseComplements<32>(rng);
+    requireReverseComplements<33>(rng);
+    requireReverseComplements<37>(rng);
+    requireReverseComplements<64>(rng);
+
+    auto kmers = randomPackedKmers<31>(100, 3);
+    auto expected = kmers;
+    std::vector<uint8_t> reversed(kmers.size());
+    canonicalize(std::span<PackedKmer<31>>(kmers), std::span<uint8_t>(reversed));
+    for (std::size_t j = 0; j < kmers.size(); j++) {
+        bool flag;
+        REQUIRE(kmers[j] == expected[j].canonical(flag));
+        REQUIRE(static_cast<bool>(reversed[j]) == flag);
+    }
+}
+
+TEST_CASE("Rolling hasher tracks the reverse strand", "[packed][canonical][rolling]") {
+    std::mt19937_64 rng(9);
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::string sequence(300, 'A');
+    for (auto& base : sequence) base = bases[rng() & 3];
+
+    RollingKmerHasher hasher(31);
+    for (std::size_t i = 0; i < sequence.size(); i++) {
+        if (!hasher.push(encodeBase(sequence[i]))) continue;
+        std::string kmer = sequence.substr(i + 1 - 31, 31);
+        std::string rc = reverseComplementOf(kmer);
+        REQUIRE(hasher.getReverseHash() == RollingKmerHasher::hashOf(rc));
+        REQUIRE(PackedKmer<31>::fromPacked(hasher.getReversePacked()).toString() == rc);
+        REQUIRE(hasher.isReverseCanonical() == (rc < kmer));
+        REQUIRE(hasher.getCanonicalHash() == RollingKmerHasher::hashOf(std::min(kmer, rc)));
+    }
+}
+
+TEST_CASE("Canonical mode finds k-mers from either strand", "[packed][canonical][bloom]") {
+    auto kmers = randomPackedKmers<31>(2000, 10);
+    BloomFilter filter(kmers.size(), 0.001, 12);
+
+    std::vector<bool> added(kmers.size());
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        added[i] = filter.addCanonical(kmers[i], i, 4);
+    }
+    REQUIRE_FALSE(filter.addCanonical(kmers[0], 1 << 11, 4));
+
+    std::vector<PackedKmer<31>> reverse(kmers.size());
+    for (std::size_t i = 0; i < kmers.size(); i++) reverse[i] = kmers[i].reverseComplement();
+    std::vector<StrandedPosition> batch(kmers.size());
+    filter.getCanonicalPositionBatch<31>(reverse, batch, 4);
+
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        if (!added[i]) continue;
+        StrandedPosition forward = filter.getCanonicalPosition(kmers[i], 4);
+        REQUIRE(forward.position == i);
+        REQUIRE_FALSE(forward.reverse);
+
+        StrandedPosition opposite = filter.getCanonicalPosition(reverse[i], 4);
+        REQUIRE(opposite.position == i);
+        REQUIRE(opposite.reverse);
+        REQUIRE(batch[i].position == i);
+        REQUIRE(batch[i].reverse);
+    }
+}
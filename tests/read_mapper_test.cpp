@@ -0,0 +1,278 @@
+#include <catch2/catch_all.hpp>
+#include "readMapper.h"
+#include "partitionedBloomFilter.h"
+#include "workStealingPool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr unsigned K = 31;
+
+std::string randomSequence(std::size_t length, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::string sequence(length, 'A');
+    for (auto& base : sequence) base = bases[rng() & 3];
+    return sequence;
+}
+
+std::string reverseComplement(const std::string& sequence) {
+    std::string rc(sequence.rbegin(), sequence.rend());
+    for (auto& base : rc) {
+        switch (base) {
+        case 'A': base = 'T'; break;
+        case 'C': base = 'G'; break;
+        case 'G': base = 'C'; break;
+        case 'T': base = 'A'; break;
+        default: break;
+        }
+    }
+    return rc;
+}
+
+struct SampledRead {
+    std::string sequence;
+    uint64_t start;
+    bool reverse;
+};
+
+// Reads drawn from reference with substitutions at errorRate, every other
+// one from the reverse strand.
+std::vector<SampledRead> sampleReads(const std::string& reference, std::size_t count, std::size_t length,
+    double errorRate, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+    std::vector<SampledRead> reads;
+    for (std::size_t i = 0; i < count; i++) {
+        uint64_t start = rng() % (reference.size() - length + 1);
+        std::string sequence = reference.substr(start, length);
+        for (auto& base : sequence) {
+            if (coin(rng) < errorRate) base = bases[rng() & 3];
+        }
+        bool reverse = i % 2 == 1;
+        reads.push_back({ reverse ? reverseComplement(sequence) : sequence, start, reverse });
+    }
+    return reads;
+}
+
+std::vector<std::string> referenceKmers(const std::string& reference) {
+    std::vector<std::string> kmers;
+    for (std::size_t i = 0; i + K <= reference.size(); i++) kmers.push_back(reference.substr(i, K));
+    return kmers;
+}
+
+std::vector<std::string> sequencesOf(const std::vector<SampledRead>& reads) {
+    std::vector<std::string> sequences;
+    for (const auto& read : reads) sequences.push_back(read.sequence);
+    return sequences;
+}
+
+std::size_t correctlyPlaced(const std::vector<SampledRead>& reads, const std::vector<ReadPlacement>& placements) {
+    std::size_t correct = 0;
+    for (std::size_t i = 0; i < reads.size(); i++) {
+        if (placements[i].position == reads[i].start && placements[i].reverse == reads[i].reverse) correct++;
+    }
+    return correct;
+}
+}
+
+TEST_CASE("Work-stealing pool runs every task once", "[mapper][pool]") {
+    for (unsigned threads : { 1u, 2u, 4u }) {
+        WorkStealingPool pool(threads);
+        REQUIRE(pool.size() == threads);
+        for (std::size_t tasks : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 3 }, std::size_t{ 1000 } }) {
+            std::vector<std::atomic<int>> runs(tasks);
+            std::atomic<bool> workerInRange{ true };
+            pool.run(tasks, [&](std::size_t task, unsigned worker) {
+                if (worker >= threads) workerInRange = false;
+                // uneven tasks, so the later ranges get stolen from
+                if (task % 97 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+                runs[task]++;
+                });
+            REQUIRE(workerInRange);
+            for (const auto& count : runs) REQUIRE(count == 1);
+        }
+    }
+
+    SECTION("The first exception reaches the caller") {
+        WorkStealingPool pool(3);
+        REQUIRE_THROWS_AS(pool.run(100, [](std::size_t task, unsigned) {
+            if (task == 42) throw std::runtime_error("task failed");
+            }), std::runtime_error);
+        // and the pool still works afterwards
+        std::atomic<std::size_t> done{ 0 };
+        pool.run(10, [&](std::size_t, unsigned) { done++; });
+        REQUIRE(done == 10);
+    }
+}
+
+TEST_CASE("FASTQ records stream in order", "[mapper][fastq]") {
+    std::string path = (std::filesystem::temp_directory_path() / "kmer_encoding_reads.fq").string();
+    {
+        std::ofstream out(path);
+        out << "@read1 extra words\nACGT\n+\nIIII\n\n@read2\r\nGG\r\n+read2\r\n!!\r\n";
+    }
+    FastqReader reader(path);
+    std::vector<FastqRecord> batch;
+    REQUIRE(reader.readBatch(batch, 10) == 2);
+    REQUIRE(batch[0].name == "read1");
+    REQUIRE(batch[0].sequence == "ACGT");
+    REQUIRE(batch[1].name == "read2");
+    REQUIRE(batch[1].sequence == "GG");
+    REQUIRE(batch[1].quality == "!!");
+    REQUIRE(reader.readBatch(batch, 10) == 0);
+
+    {
+        std::ofstream out(path);
+        out << "@read1\nACGT\n+\nIII\n";
+    }
+    FastqReader truncated(path);
+    FastqRecord record;
+    REQUIRE_THROWS_AS(truncated.next(record), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Reads are placed by k-mer votes", "[mapper]") {
+    std::string reference = randomSequence(20000, 7);
+    auto kmers = referenceKmers(reference);
+    auto reads = sampleReads(reference, 400, 100, 0.01, 8);
+    auto sequences = sequencesOf(reads);
+
+    MapperConfig config;
+    config.k = K;
+    config.numThreads = 3;
+    config.readsPerTask = 16;
+
+    SECTION("Cascade, both strands looked up") {
+        CascadeConfig cascadeConfig;
+        cascadeConfig.falsePositiveRate = 0.01;
+        cascadeConfig.positionBits = 16;
+        BloomFilterCascade cascade(cascadeConfig);
+        cascade.build(kmers);
+
+        ReadMapper mapper(cascade, config);
+        auto placements = mapper.mapReads(sequences);
+        REQUIRE(correctlyPlaced(reads, placements) >= reads.size() * 95 / 100);
+        for (const auto& placement : placements) {
+            REQUIRE(placement.kmers == 100 - K + 1);
+            if (placement.mapped()) REQUIRE(placement.votes >= config.minVotes);
+            REQUIRE(placement.confidence >= 0.0);
+            REQUIRE(placement.confidence <= 1.0);
+        }
+
+        // the placements do not depend on the thread count
+        config.numThreads = 1;
+        config.readsPerTask = 1000;
+        ReadMapper single(cascade, config);
+        auto again = single.mapReads(sequences);
+        for (std::size_t i = 0; i < reads.size(); i++) {
+            REQUIRE(again[i].position == placements[i].position);
+            REQUIRE(again[i].votes == placements[i].votes);
+        }
+    }
+
+    SECTION("Canonical cascade reports the strand itself") {
+        CascadeConfig cascadeConfig;
+        cascadeConfig.falsePositiveRate = 0.01;
+        cascadeConfig.positionBits = 16;
+        cascadeConfig.canonical = true;
+        BloomFilterCascade cascade(cascadeConfig);
+        cascade.build(kmers);
+
+        ReadMapper mapper(cascade, config);
+        REQUIRE(correctlyPlaced(reads, mapper.mapReads(sequences)) >= reads.size() * 95 / 100);
+    }
+
+    SECTION("A single filter, sampled k-mers") {
+        PartitionedBloomFilter filter(kmers.size(), 0.001, 16);
+        for (std::size_t i = 0; i < kmers.size(); i++) filter.add(kmers[i], i, 3);
+
+        config.kmerStride = 4;
+        ReadMapper mapper(filter, config, 3);
+        auto placements = mapper.mapReads(sequences);
+        // a lone filter keeps no k-mer that conflicted on insertion
+        REQUIRE(correctlyPlaced(reads, placements) >= reads.size() * 85 / 100);
+        REQUIRE(placements[0].kmers == (100 - K) / 4 + 1 + ((100 - K) % 4 != 0));
+    }
+
+    SECTION("Minimizer-sharded cascade") {
+        ShardedBuildConfig shardedConfig;
+        shardedConfig.cascade.falsePositiveRate = 0.01;
+        shardedConfig.cascade.positionBits = 16;
+        shardedConfig.cascade.routed = true;
+        shardedConfig.routing.mode = ShardRoutingPolicy::Mode::Minimizer;
+        shardedConfig.shardBytes = 8 * 1024;
+        std::vector<uint64_t> positions(kmers.size());
+        for (std::size_t i = 0; i < positions.size(); i++) positions[i] = i;
+        ShardedCascade index = ShardedCascade::build(kmers, positions, shardedConfig);
+        REQUIRE(index.numShards() > 1);
+
+        ReadMapper mapper(index, config);
+        REQUIRE(correctlyPlaced(reads, mapper.mapReads(sequences)) >= reads.size() * 95 / 100);
+    }
+
+    SECTION("Random reads stay unmapped") {
+        CascadeConfig cascadeConfig;
+        cascadeConfig.falsePositiveRate = 0.01;
+        cascadeConfig.positionBits = 16;
+        BloomFilterCascade cascade(cascadeConfig);
+        cascade.build(kmers);
+        ReadMapper mapper(cascade, config);
+        std::vector<std::string> noise;
+        for (uint64_t i = 0; i < 100; i++) noise.push_back(randomSequence(100, 1000 + i));
+        std::size_t mapped = 0;
+        for (const auto& placement : mapper.mapReads(noise)) mapped += placement.mapped();
+        REQUIRE(mapped < 10);
+    }
+}
+
+TEST_CASE("FASTQ files are mapped in file order", "[mapper][fastq]") {
+    std::string reference = randomSequence(20000, 9);
+    auto reads = sampleReads(reference, 300, 120, 0.01, 10);
+    // one read with Ns, one shorter than k
+    reads[5].sequence.replace(40, 3, "NNN");
+    reads[6].sequence = "ACGT";
+
+    std::string path = (std::filesystem::temp_directory_path() / "kmer_encoding_map.fq").string();
+    {
+        std::ofstream out(path);
+        for (std::size_t i = 0; i < reads.size(); i++) {
+            out << "@r" << i << "\n" << reads[i].sequence << "\n+\n" << std::string(reads[i].sequence.size(), 'I') << "\n";
+        }
+    }
+
+    CascadeConfig cascadeConfig;
+    cascadeConfig.falsePositiveRate = 0.01;
+    cascadeConfig.positionBits = 16;
+    BloomFilterCascade cascade(cascadeConfig);
+    cascade.build(referenceKmers(reference));
+
+    MapperConfig config;
+    config.numThreads = 2;
+    config.readsPerChunk = 64;
+    ReadMapper mapper(cascade, config);
+    auto expected = mapper.mapReads(sequencesOf(reads));
+
+    std::size_t seen = 0;
+    uint64_t total = mapper.mapFastq(path, [&](const FastqRecord& record, const ReadPlacement& placement) {
+        REQUIRE(record.name == "r" + std::to_string(seen));
+        REQUIRE(placement.position == expected[seen].position);
+        REQUIRE(placement.kmers == expected[seen].kmers);
+        seen++;
+        });
+    REQUIRE(total == reads.size());
+    REQUIRE(seen == reads.size());
+    REQUIRE(expected[5].kmers == 120 - K + 1 - (K + 2));
+    REQUIRE(expected[5].position == reads[5].start);
+    REQUIRE(expected[6].kmers == 0);
+    REQUIRE_FALSE(expected[6].mapped());
+    std::remove(path.c_str());
+}
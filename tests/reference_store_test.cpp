@@ -0,0 +1,278 @@
+#include <catch2/catch_all.hpp>
+#include "packedReferenceStore.h"
+#include "bloomFilterCascade.h"
+#include "fastaReader.h"
+#include "partitionedBloomFilter.h"
+#include "readMapper.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::string randomSequence(std::size_t length, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::string sequence(length, 'A');
+    for (auto& base : sequence) base = bases[rng() & 3];
+    return sequence;
+}
+
+std::string reverseComplement(const std::string& sequence) {
+    std::string rc(sequence.rbegin(), sequence.rend());
+    for (auto& base : rc) base = "TGCA"[encodeBase(base)];
+    return rc;
+}
+
+template <unsigned K>
+void requireMatchesStrings(const PackedReferenceStore& store, const std::string& sequence, std::mt19937_64& rng) {
+    for (int trial = 0; trial < 300; trial++) {
+        uint64_t position = rng() % (sequence.size() - K + 1);
+        std::string kmer = sequence.substr(position, K);
+        std::string rc = reverseComplement(kmer);
+        auto packed = PackedKmer<K>::fromString(kmer);
+        if constexpr (K <= 32) REQUIRE(store.extract(position, K) == packed.bits);
+        REQUIRE(store.toString(position, K) == kmer);
+
+        REQUIRE(store.matches(position, kmer));
+        REQUIRE(store.matches(position, rc, true));
+        REQUIRE(store.matches(position, packed));
+        REQUIRE(store.matches(position, PackedKmer<K>::fromString(rc), true));
+
+        // one changed base anywhere in the k-mer is caught
+        std::string changed = kmer;
+        std::size_t j = rng() % K;
+        changed[j] = "CGTA"[encodeBase(changed[j])];
+        REQUIRE_FALSE(store.matches(position, changed));
+        REQUIRE_FALSE(store.matches(position, PackedKmer<K>::fromString(changed)));
+        REQUIRE_FALSE(store.matches(position, reverseComplement(changed), true));
+    }
+    REQUIRE_FALSE(store.matches(sequence.size() - K + 1, sequence.substr(0, K)));
+    REQUIRE_FALSE(store.matches(BloomFilter::NOT_FOUND, sequence.substr(0, K)));
+}
+}
+
+TEST_CASE("Packed reference windows match the sequence", "[reference]") {
+    std::string sequence = randomSequence(5000, 1);
+    PackedReferenceStore store(sequence);
+    REQUIRE(store.size() == sequence.size());
+    REQUIRE(store.getMemoryBits() <= 2 * sequence.size() + 128);
+
+    std::mt19937_64 rng(2);
+    requireMatchesStrings<1>(store, sequence, rng);
+    requireMatchesStrings<21>(store, sequence, rng);
+    requireMatchesStrings<31>(store, sequence, rng);
+    requireMatchesStrings<32>(store, sequence, rng);
+    requireMatchesStrings<33>(store, sequence, rng);
+    requireMatchesStrings<37>(store, sequence, rng);
+    requireMatchesStrings<64>(store, sequence, rng);
+
+    // the last window, which ends in the last word
+    std::string tail = sequence.substr(sequence.size() - 64);
+    REQUIRE(store.matches(sequence.size() - 64, tail));
+    REQUIRE(store.matches(sequence.size() - 64, PackedKmer<64>::fromString(tail)));
+}
+
+TEST_CASE("Windows at the end of a partly filled word stay in bounds", "[reference]") {
+    // lengths around word boundaries, so the last window ends inside the
+    // last, partly filled word
+    for (std::size_t length : { 1, 5, 31, 32, 33, 63, 64, 65, 100 }) {
+        std::string sequence = randomSequence(length, 20 + length);
+        PackedReferenceStore store(sequence);
+        REQUIRE(store.toString(0, length) == sequence);
+        for (std::size_t count = 1; count <= std::min<std::size_t>(length, 32); count++) {
+            std::size_t position = length - count;
+            REQUIRE(store.toString(position, count) == sequence.substr(position, count));
+            REQUIRE(store.matches(position, sequence.substr(position, count)));
+        }
+    }
+    PackedReferenceStore store;
+    store.append("ACGTA");
+    REQUIRE(store.toString(0, 5) == "ACGTA");
+    REQUIRE(store.matches(2, PackedKmer<3>::fromString("GTA")));
+}
+
+TEST_CASE("Windows overlapping non-ACGT bases never match", "[reference]") {
+    const std::size_t k = 11;
+    std::string sequence = randomSequence(300, 3);
+    sequence[100] = 'N';
+    sequence.replace(200, 40, std::string(40, 'N'));
+    PackedReferenceStore store;
+    store.append(sequence.substr(0, 150));
+    store.append(sequence.substr(150));
+    REQUIRE(store.size() == sequence.size());
+    REQUIRE(store.toString(0, sequence.size()) == sequence);
+
+    for (std::size_t position = 0; position + k <= sequence.size(); position++) {
+        bool clean = sequence.substr(position, k).find('N') == std::string::npos;
+        REQUIRE(store.isValid(position, k) == clean);
+        std::string kmer = sequence.substr(position, k);
+        for (auto& base : kmer) if (base == 'N') base = 'A';
+        REQUIRE(store.matches(position, kmer) == clean);
+    }
+    REQUIRE_FALSE(store.matches(0, std::string(k - 1, 'A') + "N"));
+}
+
+TEST_CASE("Reference store loads FASTA coordinates", "[reference][fasta]") {
+    std::string chr1 = randomSequence(1000, 4);
+    std::string chr2 = randomSequence(500, 5);
+    chr1[10] = 'N';
+    chr2[499] = 'n';
+    std::string path = (std::filesystem::temp_directory_path() / "kmer_encoding_reference.fa").string();
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << ">chr1\n";
+        for (std::size_t i = 0; i < chr1.size(); i += 60) out << chr1.substr(i, 60) << "\n";
+        out << ">chr2\n" << chr2 << "\n";
+    }
+
+    auto store = PackedReferenceStore::fromFasta(path);
+    std::string expected = chr1 + chr2;
+    expected[expected.size() - 1] = 'N';
+    REQUIRE(store.size() == expected.size());
+    REQUIRE(store.toString(0, store.size()) == expected);
+
+    FastaReader reader(path);
+    reader.forEachKmer(21, [&](const KmerOccurrence& kmer) {
+        REQUIRE(store.matches(kmer.coordinate, PackedKmer<21>::fromPacked(kmer.packed)));
+        });
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Verified filter lookups reject wrong positions", "[reference][bloom]") {
+    const std::size_t k = 31;
+    std::string sequence = randomSequence(20000, 6);
+    PackedReferenceStore reference(sequence);
+    std::size_t count = sequence.size() - k + 1;
+
+    // a loose filter, so colliding slots garble some positions
+    PartitionedBloomFilter filter(count, 0.05, 15);
+    std::vector<std::string> kmers;
+    std::vector<uint8_t> added(count);
+    for (std::size_t i = 0; i < count; i++) {
+        kmers.push_back(sequence.substr(i, k));
+        added[i] = filter.add(kmers[i], i);
+    }
+
+    std::size_t wrong = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        uint64_t verified = filter.getVerifiedPosition(kmers[i], reference);
+        if (filter.getPosition(kmers[i]) != i) wrong++;
+        REQUIRE((verified == i || verified == BloomFilter::NOT_FOUND));
+        if (added[i]) REQUIRE(verified == i);
+    }
+    REQUIRE(wrong > 0);
+
+    std::size_t claimed = 0;
+    std::string absent = randomSequence(k * 2000, 7);
+    for (std::size_t i = 0; i + k <= absent.size(); i += k) {
+        std::string kmer = absent.substr(i, k);
+        claimed += filter.getPosition(kmer) != BloomFilter::NOT_FOUND;
+        REQUIRE(filter.getVerifiedPosition(kmer, reference) == BloomFilter::NOT_FOUND);
+    }
+    REQUIRE(claimed > 0);
+}
+
+TEST_CASE("Verified canonical lookups check the hit's strand", "[reference][canonical]") {
+    const unsigned K = 31;
+    std::string sequence = randomSequence(5000, 8);
+    PackedReferenceStore reference(sequence);
+    std::size_t count = sequence.size() - K + 1;
+
+    PartitionedBloomFilter filter(count, 0.001, 14);
+    std::vector<uint8_t> added(count);
+    for (std::size_t i = 0; i < count; i++) {
+        added[i] = filter.addCanonical(PackedKmer<K>::fromString(sequence.substr(i, K)), i);
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+        std::string kmer = sequence.substr(i, K);
+        StrandedPosition forward = filter.getVerifiedCanonicalPosition(PackedKmer<K>::fromString(kmer), reference);
+        StrandedPosition opposite = filter.getVerifiedCanonicalPosition(
+            PackedKmer<K>::fromString(reverseComplement(kmer)), reference);
+        REQUIRE((forward.position == i || forward.position == BloomFilter::NOT_FOUND));
+        if (!added[i]) continue;
+        REQUIRE(forward.position == i);
+        REQUIRE_FALSE(forward.reverse);
+        REQUIRE(opposite.position == i);
+        REQUIRE(opposite.reverse);
+    }
+}
+
+TEST_CASE("Verified cascade lookups see past shadowing rounds", "[reference][cascade]") {
+    const std::size_t k = 31;
+    std::string sequence = randomSequence(20000, 9);
+    PackedReferenceStore reference(sequence);
+    std::vector<std::string> kmers;
+    for (std::size_t i = 0; i + k <= sequence.size(); i++) kmers.push_back(sequence.substr(i, k));
+
+    for (bool canonical : { false, true }) {
+        for (bool routed : { false, true }) {
+            CascadeConfig config;
+            config.falsePositiveRate = 0.05;
+            config.positionBits = 15;
+            config.canonical = canonical;
+            config.routed = routed;
+            BloomFilterCascade cascade(config);
+            cascade.build(kmers);
+
+            std::size_t shadowed = 0;
+            for (const auto& round : cascade.getRoundStats()) shadowed += round.shadowed;
+            if (!routed) REQUIRE(shadowed > 0);
+
+            std::size_t wrong = 0;
+            for (std::size_t i = 0; i < kmers.size(); i++) {
+                wrong += cascade.lookup(kmers[i]) != i;
+                REQUIRE(cascade.lookupVerified(kmers[i], reference) == i);
+                if (canonical) {
+                    StrandedPosition opposite = cascade.lookupStrandedVerified(reverseComplement(kmers[i]), reference);
+                    REQUIRE(opposite.position == i);
+                    REQUIRE(opposite.reverse);
+                }
+            }
+            if (!routed) REQUIRE(wrong > 0);
+            REQUIRE(cascade.lookupVerified(randomSequence(k, 10), reference) == BloomFilter::NOT_FOUND);
+        }
+    }
+}
+
+TEST_CASE("Mapper drops hits the reference does not confirm", "[reference][mapper]") {
+    const std::size_t k = 31;
+    std::string sequence = randomSequence(50000, 11);
+    PackedReferenceStore reference(sequence);
+    std::size_t count = sequence.size() - k + 1;
+
+    PartitionedBloomFilter filter(count, 0.05, 16);
+    for (std::size_t i = 0; i < count; i++) filter.add(sequence.substr(i, k), i);
+
+    std::mt19937_64 rng(12);
+    std::vector<std::string> reads;
+    std::vector<uint64_t> starts;
+    for (int i = 0; i < 200; i++) {
+        uint64_t start = rng() % (sequence.size() - 100);
+        std::string read = sequence.substr(start, 100);
+        reads.push_back(i % 2 ? reverseComplement(read) : read);
+        starts.push_back(start);
+    }
+
+    MapperConfig config;
+    config.k = k;
+    config.numThreads = 2;
+    ReadMapper plain(filter, config);
+    config.reference = &reference;
+    ReadMapper verified(filter, config);
+    auto unchecked = plain.mapReads(reads);
+    auto placements = verified.mapReads(reads);
+
+    std::size_t plainVotes = 0;
+    for (std::size_t i = 0; i < reads.size(); i++) {
+        REQUIRE(placements[i].position == starts[i]);
+        REQUIRE(placements[i].reverse == (i % 2 == 1));
+        // every vote left is for the true diagonal
+        REQUIRE(placements[i].confidence == static_cast<double>(placements[i].votes) / placements[i].kmers);
+        REQUIRE(placements[i].votes <= unchecked[i].votes);
+        plainVotes += unchecked[i].kmers - unchecked[i].votes;
+    }
+    REQUIRE(plainVotes > 0);
+}
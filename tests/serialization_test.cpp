@@ -0,0 +1,284 @@
+#include <catch2/catch_all.hpp>
+#include "filterSerialization.h"
+#include "partitionedBloomFilter.h"
+#include "predeterminedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> randomKmers(std::size_t count, std::size_t k, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> kmers(count, std::string(k, 'A'));
+    for (auto& kmer : kmers) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+    }
+    return kmers;
+}
+
+std::string tempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("kmer_encoding_" + name)).string();
+}
+
+void requireSameAnswers(const BloomFilter& expected, const BloomFilter& actual,
+    const std::vector<std::string>& queries, int seed) {
+    REQUIRE(actual.getSize() == expected.getSize());
+    REQUIRE(actual.numHashCount == expected.numHashCount);
+    REQUIRE(actual.getMemoryBits() == expected.getMemoryBits());
+    for (const auto& query : queries) {
+        REQUIRE(actual.mightContain(query, seed) == expected.mightContain(query, seed));
+        REQUIRE(actual.getPosition(query, seed) == expected.getPosition(query, seed));
+    }
+}
+
+template <typename T>
+void patchFile(const std::string& path, std::streamoff offset, T value) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+}
+
+TEST_CASE("Filters round-trip through save, load and map", "[serialization]") {
+    auto kmers = randomKmers(1500, 31, 11);
+    auto absent = randomKmers(500, 31, 12);
+    std::vector<std::string> queries = kmers;
+    queries.insert(queries.end(), absent.begin(), absent.end());
+    const int seed = 7;
+
+    std::vector<std::unique_ptr<BloomFilter>> filters;
+    filters.push_back(std::make_unique<BloomFilter>(kmers.size(), 0.01, 11));
+    filters.push_back(std::make_unique<BloomFilter>(kmers.size(), 0.01, 11,
+        BloomFilterOptions{ HashScheme::EnhancedDoubleHashing, SlotLayout::Interleaved }));
+    filters.push_back(std::make_unique<PartitionedBloomFilter>(kmers.size(), 0.01, 11, 9));
+    filters.push_back(std::make_unique<PredeterminedHashBloomFilter>(kmers.size(), 0.01, 10, 11));
+    filters.push_back(std::make_unique<BlockedBloomFilter>(kmers.size(), 0.01, 11));
+    BloomFilterOptions fastRange;
+    fastRange.rangeReduction = RangeReduction::FastRange;
+    filters.push_back(std::make_unique<BloomFilter>(kmers.size(), 0.01, 11, fastRange));
+    BloomFilterOptions powerOfTwo;
+    powerOfTwo.rangeReduction = RangeReduction::PowerOfTwo;
+    filters.push_back(std::make_unique<PartitionedBloomFilter>(kmers.size(), 0.01, 11, 9, powerOfTwo));
+    BloomFilterOptions checked;
+    checked.checkBits = 6;
+    filters.push_back(std::make_unique<BloomFilter>(kmers.size(), 0.05, 11, checked));
+
+    std::string path = tempPath("filter.bin");
+    for (auto& filter : filters) {
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            filter->add(kmers[i], i, seed);
+        }
+        FilterSerializer::saveFilter(*filter, path, seed);
+
+        SECTION("Loaded copy answers like the original") {
+            StoredFilter loaded = FilterSerializer::loadFilter(path);
+            REQUIRE(loaded.seed == seed);
+            REQUIRE_FALSE(loaded.filter->isReadOnly());
+            REQUIRE(loaded.filter->getParameters().kind == filter->getParameters().kind);
+            REQUIRE(loaded.filter->getSlotLayout() == filter->getSlotLayout());
+            REQUIRE(loaded.filter->getRangeReduction() == filter->getRangeReduction());
+            REQUIRE(loaded.filter->getCheckBits() == filter->getCheckBits());
+            requireSameAnswers(*filter, *loaded.filter, queries, seed);
+        }
+
+        SECTION("Mapped filter answers like the original and is read-only") {
+            StoredFilter mapped = FilterSerializer::mapFilter(path);
+            REQUIRE(mapped.filter->isReadOnly());
+            requireSameAnswers(*filter, *mapped.filter, queries, seed);
+            REQUIRE_THROWS_AS(mapped.filter->add(absent[0], 1, seed), std::logic_error);
+            REQUIRE_THROWS_AS(mapped.filter->addPresence(absent[0], seed), std::logic_error);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Cascades round-trip through save, load and map", "[serialization][cascade]") {
+    auto kmers = randomKmers(3000, 31, 13);
+    auto absent = randomKmers(300, 31, 14);
+
+    CascadeConfig config;
+    config.kind = FilterKind::Predetermined;
+    config.numHash = 12;
+    config.positionBits = 12;
+    config.seed = 5;
+    BloomFilterCascade cascade(config);
+    cascade.build(kmers);
+
+    std::string path = tempPath("cascade.bin");
+    FilterSerializer::saveCascade(cascade, path);
+
+    for (bool mapped : { false, true }) {
+        BloomFilterCascade restored = mapped
+            ? FilterSerializer::mapCascade(path)
+            : FilterSerializer::loadCascade(path);
+
+        REQUIRE(restored.numRounds() == cascade.numRounds());
+        REQUIRE(restored.getMemoryBits() == cascade.getMemoryBits());
+        REQUIRE(restored.getBitsPerKmer() == cascade.getBitsPerKmer());
+        REQUIRE(restored.getConfig().seed == config.seed);
+        for (std::size_t r = 0; r < cascade.numRounds(); r++) {
+            REQUIRE(restored.getRoundStats()[r].inserted == cascade.getRoundStats()[r].inserted);
+            REQUIRE(restored.getRound(r).isReadOnly() == mapped);
+        }
+        for (const auto& kmer : kmers) {
+            REQUIRE(restored.lookup(kmer) == cascade.lookup(kmer));
+        }
+        for (const auto& kmer : absent) {
+            REQUIRE(restored.lookup(kmer) == cascade.lookup(kmer));
+        }
+    }
+
+    // check bits survive even without a round to read them from
+    config.options.checkBits = 9;
+    BloomFilterCascade empty(config);
+    empty.build(std::vector<std::string>{});
+    REQUIRE(empty.numRounds() == 0);
+    FilterSerializer::saveCascade(empty, path);
+    REQUIRE(FilterSerializer::loadCascade(path).getConfig().options.checkBits == 9);
+    REQUIRE(FilterSerializer::mapCascade(path).getConfig().options.checkBits == 9);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Loading rejects files that are not filters", "[serialization]") {
+    std::string path = tempPath("garbage.bin");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << std::string(256, 'x');
+    }
+    REQUIRE_THROWS_AS(FilterSerializer::loadFilter(path), std::runtime_error);
+    REQUIRE_THROWS_AS(FilterSerializer::mapCascade(path), std::runtime_error);
+
+    BloomFilter filter(100, 0.01, 4);
+    FilterSerializer::saveFilter(filter, path);
+    REQUIRE_THROWS_AS(FilterSerializer::loadCascade(path), std::runtime_error);
+    std::filesystem::resize_file(path, 100);
+    REQUIRE_THROWS_AS(FilterSerializer::loadFilter(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Loading rejects header fields it does not understand", "[serialization]") {
+    std::string path = tempPath("header.bin");
+    BloomFilter filter(100, 0.01, 4);
+
+    // byte offsets into the 128-byte filter header
+    auto requirePatchRejected = [&](std::streamoff offset, uint32_t value) {
+        FilterSerializer::saveFilter(filter, path);
+        REQUIRE_NOTHROW(FilterSerializer::loadFilter(path));
+        patchFile(path, offset, value);
+        REQUIRE_THROWS_AS(FilterSerializer::loadFilter(path), std::runtime_error);
+        REQUIRE_THROWS_AS(FilterSerializer::mapFilter(path), std::runtime_error);
+    };
+    requirePatchRejected(8, 1);      // version 1 predates range reduction
+    requirePatchRejected(104, 3);    // rangeReduction
+    requirePatchRejected(8, 2);      // version 2 predates check bits
+    requirePatchRejected(108, 61);   // checkBits past 64 - positionBits
+    requirePatchRejected(124, 1);    // reserved
+    requirePatchRejected(128 + 16, 1);  // the presence array's reserved bytes
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Loading rejects arrays that do not match the filter geometry", "[serialization]") {
+    std::string path = tempPath("geometry.bin");
+    std::vector<std::unique_ptr<BloomFilter>> filters;
+    filters.push_back(std::make_unique<BloomFilter>(1000, 0.01, 11));
+    filters.push_back(std::make_unique<BloomFilter>(1000, 0.01, 11,
+        BloomFilterOptions{ HashScheme::DoubleHashing, SlotLayout::Interleaved }));
+    filters.push_back(std::make_unique<PartitionedBloomFilter>(1000, 0.01, 11, 9));
+    filters.push_back(std::make_unique<BlockedBloomFilter>(1000, 0.01, 11));
+    filters.push_back(std::make_unique<PredeterminedHashBloomFilter>(1000, 0.01, 7, 11));
+
+    for (const auto& filter : filters) {
+        // byte offsets into the filter header, then the presence array's
+        // header right after it
+        auto requirePatchRejected = [&](std::streamoff offset, uint64_t value) {
+            FilterSerializer::saveFilter(*filter, path);
+            REQUIRE_NOTHROW(FilterSerializer::mapFilter(path));
+            patchFile(path, offset, value);
+            REQUIRE_THROWS_AS(FilterSerializer::loadFilter(path), std::runtime_error);
+            REQUIRE_THROWS_AS(FilterSerializer::mapFilter(path), std::runtime_error);
+        };
+        FilterParameters params = filter->getParameters();
+        requirePatchRejected(24, params.bitArraySize * 2);     // bitArraySize
+        requirePatchRejected(40, params.chunkCount + 1);       // chunkCount
+        requirePatchRejected(48, params.positionBits + 8);     // positionBits
+        requirePatchRejected(96, params.chunkCount + 3);       // numArrays
+        requirePatchRejected(128, params.bitArraySize + 4096); // numBits
+        requirePatchRejected(136, uint64_t(1) << 60);          // numWords
+        if (params.kind == FilterKind::Partitioned || params.kind == FilterKind::Predetermined) {
+            requirePatchRejected(56, 0);                           // partitionSize
+            requirePatchRejected(56, params.bitArraySize);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Loading rejects cascade headers out of range", "[serialization][cascade]") {
+    auto kmers = randomKmers(2000, 31, 17);
+    CascadeConfig config;
+    config.positionBits = 12;
+    BloomFilterCascade cascade(config);
+    cascade.build(kmers);
+    std::string path = tempPath("cascade_header.bin");
+
+    // byte offsets into the 128-byte cascade header
+    auto requirePatchRejected = [&](std::streamoff offset, auto value) {
+        FilterSerializer::saveCascade(cascade, path);
+        REQUIRE_NOTHROW(FilterSerializer::loadCascade(path));
+        patchFile(path, offset, value);
+        REQUIRE_THROWS_AS(FilterSerializer::loadCascade(path), std::runtime_error);
+        REQUIRE_THROWS_AS(FilterSerializer::mapCascade(path), std::runtime_error);
+    };
+    requirePatchRejected(12, uint32_t{ 9 });       // kind
+    requirePatchRejected(12, uint32_t{ 0 });       // a kind the rounds do not have
+    requirePatchRejected(24, int64_t{ -1 });       // numHash
+    requirePatchRejected(32, int64_t{ 0 });        // positionBits
+    requirePatchRejected(32, int64_t{ 64 });
+    requirePatchRejected(32, int64_t{ 13 });       // wider than the rounds' positions
+    requirePatchRejected(48, uint64_t{ 0 });       // maxRounds
+    requirePatchRejected(56, uint32_t{ 7 });       // hashScheme
+    requirePatchRejected(60, uint32_t{ 7 });       // slotLayout
+    requirePatchRejected(72, uint32_t{ 2 });       // sizingMode
+    requirePatchRejected(80, -1.0);                // loadFactor
+    requirePatchRejected(122, uint16_t{ 40 });     // routerFingerprintBits
+    requirePatchRejected(124, uint32_t{ 60 });     // checkBits past 64 - positionBits
+    requirePatchRejected(124, uint32_t{ 1 });      // check bits the rounds do not have
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Routed cascades keep their router on disk", "[serialization][cascade][router]") {
+    auto kmers = randomKmers(3000, 31, 15);
+    auto absent = randomKmers(300, 31, 16);
+
+    CascadeConfig config;
+    config.positionBits = 12;
+    config.routed = true;
+    config.routerFingerprintBits = 10;
+    BloomFilterCascade cascade(config);
+    cascade.build(kmers);
+
+    std::string path = tempPath("routed.bin");
+    FilterSerializer::saveCascade(cascade, path);
+
+    for (bool mapped : { false, true }) {
+        BloomFilterCascade restored = mapped
+            ? FilterSerializer::mapCascade(path)
+            : FilterSerializer::loadCascade(path);
+
+        REQUIRE(restored.isRouted());
+        REQUIRE(restored.getConfig().routerFingerprintBits == 10);
+        REQUIRE(restored.getRouterBits() == cascade.getRouterBits());
+        REQUIRE(restored.getMemoryBits() == cascade.getMemoryBits());
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            REQUIRE(restored.lookup(kmers[i]) == i);
+        }
+        for (const auto& kmer : absent) {
+            REQUIRE(restored.lookup(kmer) == cascade.lookup(kmer));
+        }
+    }
+    std::remove(path.c_str());
+}
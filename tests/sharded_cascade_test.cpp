@@ -0,0 +1,264 @@
+#include <catch2/catch_all.hpp>
+#include "shardedCascade.h"
+#include "filterSerialization.h"
+#include "packedKmer.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> randomKmers(std::size_t count, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> kmers(count, std::string(31, 'A'));
+    for (auto& kmer : kmers) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+    }
+    return kmers;
+}
+
+std::string tempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("kmer_encoding_" + name)).string();
+}
+
+ExternalBuildConfig smallBudget(bool canonical) {
+    ExternalBuildConfig config;
+    config.cascade.kind = FilterKind::Partitioned;
+    config.cascade.falsePositiveRate = 0.01;
+    config.cascade.positionBits = 16;
+    config.cascade.canonical = canonical;
+    // routed shards decode every built k-mer, shadowed ones included
+    config.cascade.routed = true;
+    config.numBuckets = 64;
+    config.tmpDir = std::filesystem::temp_directory_path().string();
+    // a few hundred KB per shard, so 20000 k-mers need several shards
+    config.ramBytes = 600000;
+    return config;
+}
+
+void requireAllFound(const ShardedCascade& index, const std::vector<std::string>& kmers) {
+    std::vector<uint64_t> batch(kmers.size());
+    index.lookupBatch(kmers, batch);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(index.lookup(kmers[i]) == i);
+        REQUIRE(batch[i] == i);
+        REQUIRE(index.mightContain(kmers[i]));
+    }
+}
+}
+
+TEST_CASE("External builds shard the input to fit the memory budget", "[sharded][cascade]") {
+    auto kmers = randomKmers(20000, 31);
+    std::string path = tempPath("sharded.kcs");
+    ExternalBuildConfig config = smallBudget(false);
+
+    ExternalCascadeBuilder builder(config, path);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        builder.add(kmers[i], i);
+    }
+    builder.finish();
+    REQUIRE(builder.numKmers() == kmers.size());
+
+    const auto& stats = builder.getShardStats();
+    REQUIRE(stats.size() > 1);
+    std::size_t covered = 0;
+    std::size_t total = 0;
+    for (const auto& shard : stats) {
+        REQUIRE(shard.firstBucket == covered);
+        REQUIRE(shard.estimatedBytes <= config.ramBytes);
+        covered += shard.numBuckets;
+        total += shard.numKmers;
+    }
+    REQUIRE(covered == config.numBuckets);
+    REQUIRE(total == kmers.size());
+
+    ShardedCascade loaded = FilterSerializer::loadShardedCascade(path);
+    ShardedCascade mapped = FilterSerializer::mapShardedCascade(path);
+    REQUIRE(loaded.numShards() == stats.size());
+    REQUIRE(loaded.numBuckets() == config.numBuckets);
+    REQUIRE(loaded.numKmers() == kmers.size());
+    REQUIRE(mapped.getMemoryBits() == loaded.getMemoryBits());
+    for (std::size_t s = 0; s < stats.size(); s++) {
+        REQUIRE(loaded.getShard(s).numRounds() == stats[s].numRounds);
+        REQUIRE(loaded.getShard(s).getMemoryBits() == stats[s].memoryBits);
+    }
+
+    requireAllFound(loaded, kmers);
+    requireAllFound(mapped, kmers);
+
+    SECTION("A k-mer is only ever asked of its own shard") {
+        for (std::size_t i = 0; i < 200; i++) {
+            std::size_t shard = loaded.shardOf(kmers[i]);
+            REQUIRE(loaded.getShard(shard).lookup(kmers[i]) == i);
+        }
+    }
+    SECTION("Absent k-mers mostly miss") {
+        auto absent = randomKmers(5000, 32);
+        std::size_t hits = 0;
+        for (const auto& kmer : absent) {
+            if (loaded.lookup(kmer) != ShardedCascade::NOT_FOUND) hits++;
+        }
+        REQUIRE(hits < absent.size() / 10);
+    }
+    SECTION("Saving the loaded index writes the same file") {
+        std::string copy = tempPath("sharded_copy.kcs");
+        FilterSerializer::saveShardedCascade(loaded, copy);
+        REQUIRE(std::filesystem::file_size(copy) == std::filesystem::file_size(path));
+        requireAllFound(FilterSerializer::loadShardedCascade(copy), kmers);
+        std::remove(copy.c_str());
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Canonical sharded cascades find either strand", "[sharded][cascade][canonical]") {
+    auto kmers = randomKmers(5000, 33);
+    std::string path = tempPath("sharded_canonical.kcs");
+
+    ExternalCascadeBuilder builder(smallBudget(true), path);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        builder.add(kmers[i], i);
+    }
+    builder.finish();
+
+    ShardedCascade index = FilterSerializer::loadShardedCascade(path);
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        std::string rc = PackedKmer<31>::fromString(kmers[i]).reverseComplement().toString();
+        REQUIRE(index.shardOf(rc) == index.shardOf(kmers[i]));
+        StrandedPosition forward = index.lookupStranded(kmers[i]);
+        StrandedPosition reverse = index.lookupStranded(rc);
+        REQUIRE(forward.position == i);
+        REQUIRE_FALSE(forward.reverse);
+        REQUIRE(reverse.position == i);
+        REQUIRE(reverse.reverse);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("External builds stream k-mer files", "[sharded][cascade]") {
+    auto kmers = randomKmers(3000, 34);
+    std::string input = tempPath("sharded_input.txt");
+    {
+        std::ofstream out(input);
+        for (const auto& kmer : kmers) out << kmer << "\n\n";
+    }
+    std::string path = tempPath("sharded_lines.kcs");
+
+    ExternalCascadeBuilder builder(smallBudget(false), path);
+    REQUIRE(builder.addLines(input, 0) == kmers.size());
+    builder.finish();
+    requireAllFound(FilterSerializer::loadShardedCascade(path), kmers);
+    REQUIRE_THROWS_AS(builder.add(kmers[0], 0), std::logic_error);
+
+    std::remove(input.c_str());
+    std::remove(path.c_str());
+}
+
+TEST_CASE("External builds reject what they cannot hold", "[sharded][cascade]") {
+    std::string path = tempPath("sharded_reject.kcs");
+    ExternalBuildConfig config = smallBudget(false);
+
+    SECTION("Positions wider than positionBits") {
+        ExternalCascadeBuilder builder(config, path);
+        REQUIRE_THROWS_AS(builder.add("ACGT", 1 << 16), std::invalid_argument);
+    }
+    SECTION("A bucket larger than the budget") {
+        config.numBuckets = 1;
+        config.ramBytes = 100000;
+        ExternalCascadeBuilder builder(config, path);
+        auto kmers = randomKmers(5000, 35);
+        for (std::size_t i = 0; i < kmers.size(); i++) builder.add(kmers[i], i);
+        REQUIRE_THROWS_AS(builder.finish(), std::runtime_error);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Minimizer routing keeps overlapping k-mers together", "[sharded][cascade][minimizer]") {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(36);
+    std::string sequence(20000, 'A');
+    for (auto& base : sequence) base = bases[rng() & 3];
+    std::vector<std::string> kmers;
+    for (std::size_t i = 0; i + 31 <= sequence.size(); i++) kmers.push_back(sequence.substr(i, 31));
+
+    ShardRoutingPolicy minimizer{ ShardRoutingPolicy::Mode::Minimizer, 15 };
+    const std::size_t numBuckets = 64;
+    std::size_t changes = 0;
+    std::size_t hashChanges = 0;
+    for (std::size_t i = 1; i < kmers.size(); i++) {
+        changes += ShardedCascade::bucketOf(kmers[i], false, numBuckets, minimizer)
+            != ShardedCascade::bucketOf(kmers[i - 1], false, numBuckets, minimizer);
+        hashChanges += ShardedCascade::bucketOf(kmers[i], false, numBuckets)
+            != ShardedCascade::bucketOf(kmers[i - 1], false, numBuckets);
+    }
+    // about 2 / (k - m + 2) of the steps move to a new minimizer
+    REQUIRE(changes < kmers.size() / 6);
+    REQUIRE(hashChanges > kmers.size() * 9 / 10);
+
+    // canonical m-mers route both strands alike; k-mers with an N fall back
+    for (std::size_t i = 0; i < 1000; i++) {
+        std::string rc = PackedKmer<31>::fromString(kmers[i]).reverseComplement().toString();
+        REQUIRE(ShardedCascade::bucketOf(rc, true, numBuckets, minimizer)
+            == ShardedCascade::bucketOf(kmers[i], true, numBuckets, minimizer));
+    }
+    std::string withN = kmers[0];
+    withN[10] = 'N';
+    REQUIRE(ShardedCascade::bucketOf(withN, false, numBuckets, minimizer)
+        == ShardedCascade::bucketOf(withN, false, numBuckets));
+}
+
+TEST_CASE("In-memory sharded builds", "[sharded][cascade][minimizer]") {
+    auto kmers = randomKmers(20000, 37);
+    std::vector<uint64_t> positions(kmers.size());
+    for (std::size_t i = 0; i < positions.size(); i++) positions[i] = i;
+
+    ShardedBuildConfig config;
+    config.cascade = smallBudget(false).cascade;
+    config.routing = { ShardRoutingPolicy::Mode::Minimizer, 13 };
+    config.shardBytes = 16 * 1024;
+    config.numThreads = 3;
+    ShardedCascade index = ShardedCascade::build(kmers, positions, config);
+    REQUIRE(index.numShards() > 4);
+    REQUIRE(index.numShards() == index.numBuckets());
+    REQUIRE(index.getRouting().mode == ShardRoutingPolicy::Mode::Minimizer);
+    REQUIRE(index.numKmers() == kmers.size());
+    requireAllFound(index, kmers);
+
+    // shards are built one per thread, so the thread count does not matter
+    config.numThreads = 1;
+    ShardedCascade single = ShardedCascade::build(kmers, positions, config);
+    REQUIRE(single.getMemoryBits() == index.getMemoryBits());
+
+    SECTION("Routing survives serialization") {
+        std::string path = tempPath("sharded_minimizer.kcs");
+        FilterSerializer::saveShardedCascade(index, path);
+        ShardedCascade loaded = FilterSerializer::mapShardedCascade(path);
+        REQUIRE(loaded.getRouting().mode == ShardRoutingPolicy::Mode::Minimizer);
+        REQUIRE(loaded.getRouting().minimizerLength == 13);
+        requireAllFound(loaded, kmers);
+        std::remove(path.c_str());
+    }
+
+    SECTION("External builds route the same way") {
+        std::string path = tempPath("sharded_minimizer_external.kcs");
+        ExternalBuildConfig external = smallBudget(false);
+        external.routing = config.routing;
+        ExternalCascadeBuilder builder(external, path);
+        for (std::size_t i = 0; i < kmers.size(); i++) builder.add(kmers[i], i);
+        builder.finish();
+        ShardedCascade loaded = FilterSerializer::loadShardedCascade(path);
+        REQUIRE(loaded.getRouting().minimizerLength == 13);
+        requireAllFound(loaded, kmers);
+        std::remove(path.c_str());
+    }
+
+    SECTION("Bad configs") {
+        config.routing.minimizerLength = 33;
+        REQUIRE_THROWS_AS(ShardedCascade::build(kmers, positions, config), std::invalid_argument);
+        config.routing.minimizerLength = 13;
+        positions.pop_back();
+        REQUIRE_THROWS_AS(ShardedCascade::build(kmers, positions, config), std::invalid_argument);
+    }
+}
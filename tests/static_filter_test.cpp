@@ -0,0 +1,102 @@
+#include <catch2/catch_all.hpp>
+#include "staticBloomFilter.h"
+#include "bloomfilter.h"
+#include "partitionedBloomFilter.h"
+#include "blockedBloomFilter.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> randomKmers(std::size_t count, uint64_t seed) {
+    static const char bases[] = { 'A', 'C', 'G', 'T' };
+    std::mt19937_64 rng(seed);
+    std::vector<std::string> kmers(count, std::string(31, 'A'));
+    for (auto& kmer : kmers) {
+        for (auto& base : kmer) base = bases[rng() & 3];
+    }
+    return kmers;
+}
+
+bool sameBits(const PackedBitset& a, const PackedBitset& b) {
+    if (a.size() != b.size()) return false;
+    std::size_t words = (a.size() + PackedBitset::WORD_BITS - 1) / PackedBitset::WORD_BITS;
+    return std::equal(a.data(), a.data() + words, b.data());
+}
+
+// Adds the same items to both filters and requires identical accept
+// decisions, bits and answers.
+template <typename Static>
+void requireSameAsDynamic(Static& fixed, BloomFilter& dynamic, const std::vector<std::string>& kmers) {
+    REQUIRE(fixed.getSize() == dynamic.getSize());
+    for (std::size_t i = 0; i < kmers.size(); i++) {
+        REQUIRE(fixed.add(kmers[i], i, 2) == dynamic.add(kmers[i], i, 2));
+    }
+    REQUIRE(sameBits(fixed.getBitArray(), dynamic.getBitArray()));
+
+    auto queries = randomKmers(1000, 99);
+    queries.insert(queries.end(), kmers.begin(), kmers.end());
+    std::vector<uint64_t> batch(queries.size());
+    fixed.getPositionBatch(queries, batch, 2);
+    for (std::size_t j = 0; j < queries.size(); j++) {
+        REQUIRE(fixed.getPosition(queries[j], 2) == dynamic.getPosition(queries[j], 2));
+        REQUIRE(fixed.mightContain(queries[j], 2) == dynamic.mightContain(queries[j], 2));
+        REQUIRE(batch[j] == fixed.getPosition(queries[j], 2));
+    }
+}
+}
+
+TEST_CASE("Static filters match their runtime counterparts", "[static][bloom]") {
+    // an optimal hash count of 7 at 1% FPR, matching NumHash below
+    auto kmers = randomKmers(3000, 4);
+    BloomFilterOptions options{ HashScheme::DoubleHashing, SlotLayout::Interleaved };
+
+    SECTION("Plain layout") {
+        for (auto reduction : { RangeReduction::Modulo, RangeReduction::FastRange, RangeReduction::PowerOfTwo }) {
+            options.rangeReduction = reduction;
+            StaticBloomFilter<PlainLayout, 7, 20> fixed(kmers.size(), 0.01, reduction);
+            BloomFilter dynamic(kmers.size(), 0.01, 20, options);
+            REQUIRE(dynamic.numHashCount == 7);
+            requireSameAsDynamic(fixed, dynamic, kmers);
+        }
+    }
+    SECTION("Partitioned layout") {
+        for (auto reduction : { RangeReduction::Modulo, RangeReduction::PowerOfTwo }) {
+            options.rangeReduction = reduction;
+            StaticBloomFilter<PartitionedLayout, 10, 24> fixed(kmers.size(), 0.01, reduction);
+            PartitionedBloomFilter dynamic(kmers.size(), 0.01, 24, 10, options);
+            requireSameAsDynamic(fixed, dynamic, kmers);
+        }
+    }
+    SECTION("Blocked layout") {
+        StaticBloomFilter<BlockedLayout, 7, 16> fixed(kmers.size(), 0.01);
+        BlockedBloomFilter dynamic(kmers.size(), 0.01, 16);
+        requireSameAsDynamic(fixed, dynamic, kmers);
+    }
+    SECTION("Self-collision rejection") {
+        options.rejectSelfCollisions = true;
+        StaticBloomFilter<PlainLayout, 7, 32> fixed(kmers.size(), 0.01, RangeReduction::Modulo, true);
+        BloomFilter dynamic(kmers.size(), 0.01, 32, options);
+        requireSameAsDynamic(fixed, dynamic, kmers);
+    }
+}
+
+TEST_CASE("Static filters are selected at runtime", "[static]") {
+    REQUIRE(hasStaticFilter(FilterKind::Blocked, 10, 32));
+    REQUIRE_FALSE(hasStaticFilter(FilterKind::Standard, 8, 32));
+    REQUIRE_FALSE(hasStaticFilter(FilterKind::Predetermined, 7, 16));
+    REQUIRE_THROWS_AS(makeStaticFilter(FilterKind::Partitioned, 7, 20, 100, 0.01), std::invalid_argument);
+
+    auto kmers = randomKmers(500, 5);
+    AnyStaticFilter any = makeStaticFilter(FilterKind::Partitioned, 7, 16, kmers.size(), 0.01);
+    REQUIRE(std::holds_alternative<StaticBloomFilter<PartitionedLayout, 7, 16>>(any));
+    std::visit([&](auto& filter) {
+        std::vector<bool> added(kmers.size());
+        for (std::size_t i = 0; i < kmers.size(); i++) added[i] = filter.add(kmers[i], i);
+        for (std::size_t i = 0; i < kmers.size(); i++) {
+            if (added[i]) REQUIRE(filter.getPosition(kmers[i]) == i);
+        }
+        REQUIRE_FALSE(filter.add(kmers[0], 1 << 16));
+        }, any);
+}